@@ -1,15 +1,35 @@
 #include <chrono>
+#include <algorithm>
 #include <hyperliquid/command.h>
+#include <hyperliquid/mempool.h>
 #include <hyperliquid/order_book.h>
 #include <hyperliquid/price_levels_array.h>
+#include <hyperliquid/price_levels_avl.h>
+#include <hyperliquid/price_levels_sorted.h>
+#include <hyperliquid/spsc_queue.h>
 #include <hyperliquid/timestamp.h>
 #include <hyperliquid/types.h>
+#include <hyperliquid/wait_strategy.h>
 #include <iomanip>
 #include <iostream>
+#include <memory>
 #include <random>
+#include <span>
+#include <thread>
+#include <vector>
+#if defined(__linux__)
+#include <ctime>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 
 using namespace hyperliquid;
 
+// Keeps benchmark loop results observable so they are not optimized away
+volatile uint64_t g_bench_sink = 0;
+
 void benchmark_throughput() {
   std::cout << "\n========================================\n";
   std::cout << "  MATCHING ENGINE THROUGHPUT BENCHMARK\n";
@@ -23,8 +43,9 @@ void benchmark_throughput() {
             << std::setprecision(2) << (1.0 / tsc_to_ns) << " GHz\n";
 
   PriceBand band(50000, 60000, 1);
-  OrderBook<PriceLevelsArray> book(1, PriceLevelsArray(band),
-                                   PriceLevelsArray(band));
+  // Events are discarded at compile time so only matching is measured
+  OrderBook<PriceLevelsArray, NullSink> book(1, PriceLevelsArray(band),
+                                             PriceLevelsArray(band));
 
   constexpr size_t NUM_ORDERS = 1'000'000;
   std::mt19937_64 rng(42);
@@ -132,7 +153,591 @@ void benchmark_throughput() {
   std::cout << "========================================\n\n";
 }
 
+void benchmark_sparse_book() {
+  std::cout << "\n========================================\n";
+  std::cout << "  SPARSE BOOK NEXT-LEVEL BENCHMARK\n";
+  std::cout << "========================================\n\n";
+
+  // Wide band with resting asks far apart: every sweep that empties the top
+  // level must locate the next one across a large gap
+  PriceBand band(1, 50'000'000, 1);
+  constexpr size_t NUM_LEVELS = 2'000;
+  constexpr Tick GAPS[] = {16, 1'000, 20'000};
+
+  std::cout << std::left << std::setw(12) << "Gap (ticks)" << std::right
+            << std::setw(18) << "Linear (ns/op)" << std::setw(18)
+            << "Bitmap (ns/op)" << std::setw(18) << "Sweep (ns/level)"
+            << "\n";
+
+  for (Tick gap : GAPS) {
+    PriceLevelsArray asks(band);
+    std::vector<OrderNode> nodes(NUM_LEVELS);
+    for (size_t i = 0; i < NUM_LEVELS; ++i) {
+      nodes[i] = OrderNode(i + 1, 1, 10, 0, 0);
+      asks.enqueue(1000 + static_cast<Tick>(i) * gap, &nodes[i]);
+    }
+
+    // Baseline: tick-by-tick has_level() scan (the pre-bitmap refresh path)
+    uint64_t sink = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (size_t i = 0; i + 1 < NUM_LEVELS; ++i) {
+      Tick px = 1000 + static_cast<Tick>(i) * gap + 1;
+      while (!asks.has_level(px))
+        ++px;
+      sink += static_cast<uint64_t>(px);
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    for (size_t i = 0; i + 1 < NUM_LEVELS; ++i)
+      sink += static_cast<uint64_t>(
+          asks.find_next_ask(1000 + static_cast<Tick>(i) * gap));
+    auto t2 = std::chrono::steady_clock::now();
+
+    // End to end: market orders that each empty the best level
+    OrderBook<PriceLevelsArray> book(1, PriceLevelsArray(band),
+                                     PriceLevelsArray(band));
+    OrderCommand cmd{};
+    cmd.type = CommandType::NewOrder;
+    cmd.user_id = 1;
+    cmd.qty = 10;
+    cmd.side = Side::Ask;
+    cmd.order_type = OrderType::Limit;
+    cmd.tif = TimeInForce::GTC;
+    cmd.flags = 0;
+    cmd.recv_ts = 0;
+    for (size_t i = 0; i < NUM_LEVELS; ++i) {
+      cmd.order_id = i + 1;
+      cmd.price_ticks = 1000 + static_cast<Tick>(i) * gap;
+      book.submit_limit(cmd);
+    }
+    cmd.side = Side::Bid;
+    cmd.order_type = OrderType::Market;
+    cmd.user_id = 2;
+    auto t3 = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < NUM_LEVELS; ++i) {
+      cmd.order_id = NUM_LEVELS + i + 1;
+      book.submit_market(cmd);
+    }
+    auto t4 = std::chrono::steady_clock::now();
+
+    auto ns = [](auto a, auto b, size_t n) {
+      return std::chrono::duration<double, std::nano>(b - a).count() /
+             static_cast<double>(n);
+    };
+    std::cout << std::left << std::setw(12) << gap << std::right
+              << std::fixed << std::setprecision(1) << std::setw(18)
+              << ns(t0, t1, NUM_LEVELS - 1) << std::setw(18)
+              << ns(t1, t2, NUM_LEVELS - 1) << std::setw(18)
+              << ns(t3, t4, NUM_LEVELS) << "\n";
+    g_bench_sink = sink;
+  }
+}
+
+// Mixed add/cancel/market workload; returns ns per command
+template <typename Impl>
+double run_level_workload(Impl bids, Impl asks,
+                          const std::vector<OrderCommand> &cmds) {
+  OrderBook<Impl, NullSink> book(1, std::move(bids), std::move(asks));
+  auto start = std::chrono::steady_clock::now();
+  for (const auto &cmd : cmds) {
+    if (cmd.type == CommandType::CancelOrder)
+      book.cancel(cmd.order_id);
+    else if (cmd.order_type == OrderType::Market)
+      book.submit_market(cmd);
+    else
+      book.submit_limit(cmd);
+  }
+  auto end = std::chrono::steady_clock::now();
+  g_bench_sink = static_cast<uint64_t>(book.best_bid());
+  return std::chrono::duration<double, std::nano>(end - start).count() /
+         static_cast<double>(cmds.size());
+}
+
+void benchmark_level_containers() {
+  std::cout << "\n========================================\n";
+  std::cout << "  PRICE LEVEL CONTAINER BENCHMARK\n";
+  std::cout << "========================================\n\n";
+
+  // Orders rest on a grid of `gap` ticks around the mid; larger gaps mean
+  // a sparser book for the array-based containers
+  constexpr size_t NUM_CMDS = 300'000;
+  constexpr Tick MID = 1'000'000;
+  constexpr Tick LEVELS_PER_SIDE = 400;
+  constexpr Tick GAPS[] = {1, 10, 100, 1'000};
+
+  std::cout << std::left << std::setw(12) << "Gap (ticks)" << std::right
+            << std::setw(16) << "Array (ns/op)" << std::setw(16)
+            << "AVL (ns/op)" << std::setw(16) << "Sorted (ns/op)" << "\n";
+
+  for (Tick gap : GAPS) {
+    std::mt19937_64 rng(42);
+    std::vector<OrderCommand> cmds;
+    cmds.reserve(NUM_CMDS);
+    for (size_t i = 0; i < NUM_CMDS; ++i) {
+      OrderCommand cmd{};
+      cmd.order_id = i + 1;
+      cmd.user_id = static_cast<UserId>(i % 1000 + 1);
+      cmd.symbol_id = 1;
+      cmd.recv_ts = i;
+      cmd.tif = TimeInForce::GTC;
+      cmd.side = (rng() & 1) ? Side::Bid : Side::Ask;
+      uint64_t action = rng() % 10;
+      if (action < 6 || i < 1000) {
+        cmd.type = CommandType::NewOrder;
+        cmd.order_type = OrderType::Limit;
+        Tick level = 1 + static_cast<Tick>(rng() % LEVELS_PER_SIDE);
+        cmd.price_ticks =
+            (cmd.side == Side::Bid) ? MID - level * gap : MID + level * gap;
+        cmd.qty = static_cast<Quantity>(rng() % 50 + 1);
+      } else if (action < 9) {
+        cmd.type = CommandType::CancelOrder;
+        cmd.order_id = rng() % i + 1;
+      } else {
+        cmd.type = CommandType::NewOrder;
+        cmd.order_type = OrderType::Market;
+        cmd.qty = static_cast<Quantity>(rng() % 200 + 1);
+      }
+      cmds.push_back(cmd);
+    }
+
+    PriceBand band(MID - (LEVELS_PER_SIDE + 1) * gap,
+                   MID + (LEVELS_PER_SIDE + 1) * gap, 1);
+    double array_ns = run_level_workload(PriceLevelsArray(band),
+                                         PriceLevelsArray(band), cmds);
+    double avl_ns =
+        run_level_workload(PriceLevelsAVL(), PriceLevelsAVL(), cmds);
+    double sorted_ns =
+        run_level_workload(PriceLevelsSorted(), PriceLevelsSorted(), cmds);
+
+    std::cout << std::left << std::setw(12) << gap << std::right
+              << std::fixed << std::setprecision(1) << std::setw(16)
+              << array_ns << std::setw(16) << avl_ns << std::setw(16)
+              << sorted_ns << "\n";
+  }
+}
+
+// Hardware cache-miss counters via perf_event_open. Falls back to
+// reporting n/a when the kernel or container does not allow it.
+class CacheCounters {
+public:
+  CacheCounters() {
+#if defined(__linux__)
+    l1_fd_ = open_counter(PERF_COUNT_HW_CACHE_L1D);
+    ll_fd_ = open_counter(PERF_COUNT_HW_CACHE_LL);
+#endif
+  }
+
+  ~CacheCounters() {
+#if defined(__linux__)
+    if (l1_fd_ >= 0)
+      close(l1_fd_);
+    if (ll_fd_ >= 0)
+      close(ll_fd_);
+#endif
+  }
+
+  bool available() const { return l1_fd_ >= 0 && ll_fd_ >= 0; }
+
+  void start() {
+#if defined(__linux__)
+    for (int fd : {l1_fd_, ll_fd_}) {
+      if (fd >= 0) {
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+      }
+    }
+#endif
+  }
+
+  void stop() {
+#if defined(__linux__)
+    l1_misses_ = read_counter(l1_fd_);
+    ll_misses_ = read_counter(ll_fd_);
+#endif
+  }
+
+  uint64_t l1_misses() const { return l1_misses_; }
+  uint64_t ll_misses() const { return ll_misses_; }
+
+private:
+#if defined(__linux__)
+  static int open_counter(uint64_t cache) {
+    perf_event_attr attr{};
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HW_CACHE;
+    attr.config = cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                  (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+  }
+
+  static uint64_t read_counter(int fd) {
+    uint64_t value = 0;
+    if (fd >= 0) {
+      ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+      if (read(fd, &value, sizeof(value)) != sizeof(value))
+        value = 0;
+    }
+    return value;
+  }
+#endif
+
+  int l1_fd_{-1};
+  int ll_fd_{-1};
+  uint64_t l1_misses_{0};
+  uint64_t ll_misses_{0};
+};
+
+// Node layout before the hot/cold split, kept for comparison
+struct LegacyOrderNode {
+  OrderId id;
+  UserId user;
+  Quantity qty;
+  Timestamp ts;
+  uint32_t flags;
+  Quantity display_qty;
+  Quantity hidden_qty;
+  Timestamp expiry_ts;
+  Tick stop_price;
+  LegacyOrderNode *prev;
+  LegacyOrderNode *next;
+  uint8_t alloc_kind;
+};
+
+// Walk a FIFO of pooled nodes linked in shuffled order (a slab after churn),
+// reading what the match loop reads; returns ns per node
+template <typename Node>
+double walk_fifo(size_t n, CacheCounters &counters, double &l1, double &ll) {
+  SlabPool<Node> pool(1);
+  std::vector<Node *> nodes(n);
+  for (auto &node : nodes) {
+    node = pool.alloc();
+    *node = Node{};
+    node->qty = 1;
+  }
+  std::mt19937_64 rng(3);
+  std::shuffle(nodes.begin(), nodes.end(), rng);
+  for (size_t i = 0; i + 1 < n; ++i)
+    nodes[i]->next = nodes[i + 1];
+  nodes[n - 1]->next = nullptr;
+
+  uint64_t sum = 0;
+  counters.start();
+  auto start = std::chrono::steady_clock::now();
+  for (Node *node = nodes[0]; node; node = node->next) {
+    if (node->next)
+      __builtin_prefetch(node->next, 0, 1);
+    sum += node->id + node->user + static_cast<uint64_t>(node->qty);
+  }
+  auto end = std::chrono::steady_clock::now();
+  counters.stop();
+  g_bench_sink = sum;
+
+  l1 = static_cast<double>(counters.l1_misses()) / static_cast<double>(n);
+  ll = static_cast<double>(counters.ll_misses()) / static_cast<double>(n);
+  return std::chrono::duration<double, std::nano>(end - start).count() /
+         static_cast<double>(n);
+}
+
+// Build a deep ask book and sweep it with market buys; prints ns per fill
+void sweep_deep_book(bool per_maker, CacheCounters &counters) {
+  constexpr size_t NUM_LEVELS = 200;
+  constexpr size_t ORDERS_PER_LEVEL = 5'000;
+  PriceBand band(1000, 1000 + NUM_LEVELS, 1);
+  OrderBook<PriceLevelsArray, NullSink> book(1, PriceLevelsArray(band),
+                                             PriceLevelsArray(band));
+  std::mt19937_64 rng(9);
+  OrderCommand cmd{};
+  cmd.type = CommandType::NewOrder;
+  cmd.side = Side::Ask;
+  cmd.order_type = OrderType::Limit;
+  cmd.tif = TimeInForce::GTC;
+  OrderId next_id = 1;
+  // Interleave levels so each FIFO is scattered across the slab
+  for (size_t k = 0; k < ORDERS_PER_LEVEL; ++k) {
+    for (size_t lvl = 0; lvl < NUM_LEVELS; ++lvl) {
+      cmd.order_id = next_id++;
+      cmd.user_id = static_cast<UserId>(rng() % 1000 + 1);
+      cmd.price_ticks = 1000 + static_cast<Tick>(lvl);
+      cmd.qty = static_cast<Quantity>(rng() % 10 + 1);
+      book.submit_limit(cmd);
+    }
+  }
+
+  cmd.side = Side::Bid;
+  cmd.order_type = OrderType::Market;
+  cmd.user_id = 0;
+  cmd.qty = 50'000;
+  cmd.flags = per_maker ? OrderFlags::STP : OrderFlags::NONE;
+  size_t fills = NUM_LEVELS * ORDERS_PER_LEVEL;
+  counters.start();
+  auto start = std::chrono::steady_clock::now();
+  while (!book.empty(Side::Ask)) {
+    cmd.order_id = next_id++;
+    book.submit_market(cmd);
+  }
+  auto end = std::chrono::steady_clock::now();
+  counters.stop();
+  double ns = std::chrono::duration<double, std::nano>(end - start).count() /
+              static_cast<double>(fills);
+  std::cout << "Sweep " << fills << " resting orders ("
+            << (per_maker ? "per maker" : "whole levels") << "): "
+            << std::fixed << std::setprecision(2) << ns << " ns/fill, "
+            << static_cast<double>(counters.l1_misses()) /
+                   static_cast<double>(fills)
+            << " L1D / "
+            << static_cast<double>(counters.ll_misses()) /
+                   static_cast<double>(fills)
+            << " LL misses per fill\n";
+}
+
+void benchmark_deep_sweep() {
+  std::cout << "\n========================================\n";
+  std::cout << "  DEEP BOOK SWEEP / NODE LAYOUT\n";
+  std::cout << "========================================\n\n";
+
+  CacheCounters counters;
+  if (!counters.available())
+    std::cout << "(hardware cache counters unavailable, misses show 0)\n\n";
+
+  constexpr size_t NUM_NODES = 2'000'000;
+  double l1 = 0, ll = 0;
+  std::cout << std::left << std::setw(22) << "FIFO walk" << std::right
+            << std::setw(8) << "bytes" << std::setw(12) << "ns/node"
+            << std::setw(14) << "L1D miss/node" << std::setw(14)
+            << "LL miss/node" << "\n";
+  double legacy_ns = walk_fifo<LegacyOrderNode>(NUM_NODES, counters, l1, ll);
+  std::cout << std::left << std::setw(22) << "legacy node" << std::right
+            << std::setw(8) << sizeof(LegacyOrderNode) << std::fixed
+            << std::setprecision(2) << std::setw(12) << legacy_ns
+            << std::setw(14) << l1 << std::setw(14) << ll << "\n";
+  double hot_ns = walk_fifo<OrderNode>(NUM_NODES, counters, l1, ll);
+  std::cout << std::left << std::setw(22) << "hot node" << std::right
+            << std::setw(8) << sizeof(OrderNode) << std::setw(12) << hot_ns
+            << std::setw(14) << l1 << std::setw(14) << ll << "\n";
+
+  // End to end: market orders sweeping a deep book level by level, taking
+  // whole levels at once vs maker by maker (STP on forces the latter)
+  std::cout << "\n";
+  for (bool per_maker : {false, true})
+    sweep_deep_book(per_maker, counters);
+}
+
+// Counts what a publisher would receive, so book updates are not free
+struct CountingSink {
+  static constexpr bool wants_trades() noexcept { return true; }
+  static constexpr bool wants_book_updates() noexcept { return true; }
+  static constexpr bool wants_orders() noexcept { return false; }
+  static constexpr bool wants_depth() noexcept { return false; }
+  void on_trade(const TradeEvent &t) noexcept { trades += t.qty; }
+  void on_book_update(const BookUpdate &) noexcept { ++book_updates; }
+  void on_order(const OrderEvent &) noexcept {}
+  void on_depth(const DepthUpdate &) noexcept {}
+  uint64_t trades{0};
+  uint64_t book_updates{0};
+};
+
+void benchmark_batch_submit() {
+  std::cout << "\n========================================\n";
+  std::cout << "  BATCHED COMMAND SUBMISSION\n";
+  std::cout << "========================================\n\n";
+
+  constexpr size_t NUM_ORDERS = 1'000'000;
+  PriceBand band(50000, 60000, 1);
+  std::mt19937_64 rng(42);
+  std::uniform_int_distribution<Tick> price_dist(54900, 55100);
+  std::uniform_int_distribution<Quantity> qty_dist(1, 100);
+  std::vector<OrderCommand> orders(NUM_ORDERS);
+  for (size_t i = 0; i < NUM_ORDERS; ++i) {
+    OrderCommand &cmd = orders[i];
+    cmd.type = (i % 4 == 3) ? CommandType::CancelOrder : CommandType::NewOrder;
+    cmd.order_id = (i % 4 == 3) ? i - 2 : i + 1;
+    cmd.symbol_id = 1;
+    cmd.user_id = (i % 1000) + 1;
+    cmd.price_ticks = price_dist(rng);
+    cmd.qty = qty_dist(rng);
+    cmd.side = (i % 2 == 0) ? Side::Bid : Side::Ask;
+    cmd.order_type = OrderType::Limit;
+    cmd.tif = TimeInForce::GTC;
+  }
+
+  std::cout << std::left << std::setw(14) << "Batch size" << std::right
+            << std::setw(16) << "msgs/sec" << std::setw(16) << "book updates"
+            << "\n";
+  for (size_t batch : {size_t{1}, size_t{8}, size_t{64}}) {
+    OrderBook<PriceLevelsArray, CountingSink> book(1, PriceLevelsArray(band),
+                                                   PriceLevelsArray(band));
+    auto start = std::chrono::steady_clock::now();
+    if (batch == 1) {
+      for (const auto &cmd : orders)
+        book.execute(cmd);
+    } else {
+      std::span<const OrderCommand> all(orders);
+      for (size_t i = 0; i < NUM_ORDERS; i += batch)
+        book.submit_batch(all.subspan(i, std::min(batch, NUM_ORDERS - i)));
+    }
+    double secs = std::chrono::duration<double>(
+                      std::chrono::steady_clock::now() - start)
+                      .count();
+    g_bench_sink = g_bench_sink + book.sink().trades;
+    std::cout << std::left << std::setw(14) << batch << std::right
+              << std::setw(16) << std::fixed << std::setprecision(0)
+              << NUM_ORDERS / secs << std::setw(16)
+              << book.sink().book_updates << "\n";
+  }
+}
+
+void benchmark_queue_batching() {
+  std::cout << "\n========================================\n";
+  std::cout << "  CROSS-THREAD QUEUE BATCHING\n";
+  std::cout << "========================================\n\n";
+
+  // one producer and one consumer thread move NUM_ITEMS through an
+  // SPSCQueue, one element or one batch per queue call. batches publish
+  // each index once and re-read the other side's only when the cached one
+  // says full or empty. threads are left where the scheduler puts them.
+  constexpr uint64_t NUM_ITEMS = 2'000'000;
+
+  std::cout << std::left << std::setw(14) << "Batch size" << std::right
+            << std::setw(16) << "M items/sec" << "\n";
+  for (size_t batch : {size_t{1}, size_t{8}, size_t{64}}) {
+    auto queue = std::make_unique<SPSCQueue<uint64_t, 4096>>();
+    uint64_t sum = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    std::thread producer([&] {
+      std::vector<uint64_t> buf(batch);
+      for (uint64_t i = 0; i < NUM_ITEMS;) {
+        size_t n = std::min<uint64_t>(batch, NUM_ITEMS - i);
+        for (size_t k = 0; k < n; ++k)
+          buf[k] = i + k;
+        std::span<const uint64_t> pending(buf.data(), n);
+        while (!pending.empty()) {
+          size_t pushed = batch == 1 ? (queue->push(pending[0]) ? 1 : 0)
+                                     : queue->push_n(pending);
+          pending = pending.subspan(pushed);
+          if (pushed == 0)
+            std::this_thread::yield();
+        }
+        i += n;
+      }
+    });
+    std::thread consumer([&] {
+      uint64_t received = 0;
+      auto add = [&](uint64_t v) {
+        sum += v;
+        ++received;
+      };
+      while (received < NUM_ITEMS) {
+        size_t n;
+        if (batch == 1) {
+          uint64_t v;
+          n = queue->pop(v) ? 1 : 0;
+          if (n)
+            add(v);
+        } else {
+          n = queue->consume(add, batch);
+        }
+        if (n == 0)
+          std::this_thread::yield();
+      }
+    });
+    producer.join();
+    consumer.join();
+    double secs = std::chrono::duration<double>(
+                      std::chrono::steady_clock::now() - start)
+                      .count();
+    g_bench_sink = g_bench_sink + sum;
+    std::cout << std::left << std::setw(14) << batch << std::right
+              << std::setw(16) << std::fixed << std::setprecision(1)
+              << NUM_ITEMS / secs / 1e6 << "\n";
+  }
+}
+
+// consumer cpu time of the calling thread, 0 where there is no thread clock
+static double thread_cpu_secs() {
+#if defined(__linux__)
+  timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+#else
+  return 0;
+#endif
+}
+
+void benchmark_wait_strategies() {
+  std::cout << "\n========================================\n";
+  std::cout << "  IDLE WAIT STRATEGIES\n";
+  std::cout << "========================================\n\n";
+
+  // a producer sends timestamped pings at a low rate, so the consumer is
+  // idle between them: wake-up latency is the send-to-receive gap, cpu burn
+  // the consumer's cpu time over the wall time of the run
+  constexpr size_t PINGS = 2000;
+  constexpr auto PERIOD = std::chrono::microseconds(50);
+
+  std::cout << std::left << std::setw(10) << "Mode" << std::right
+            << std::setw(14) << "avg wake ns" << std::setw(14) << "p99 wake ns"
+            << std::setw(12) << "cpu burn" << std::setw(10) << "parks"
+            << "\n";
+  for (WaitMode mode : {WaitMode::Spin, WaitMode::Yield, WaitMode::Backoff,
+                        WaitMode::Park}) {
+    SPSCQueue<uint64_t, 1024> queue;
+    Doorbell bell;
+    std::vector<uint64_t> lat;
+    lat.reserve(PINGS);
+    double cpu = 0;
+    uint64_t parks = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    std::thread consumer([&] {
+      WaitStrategy wait(mode, &bell);
+      double cpu_start = thread_cpu_secs();
+      uint64_t stamp;
+      while (lat.size() < PINGS) {
+        if (!queue.pop(stamp)) {
+          wait.idle([&] { return !queue.empty(); });
+          continue;
+        }
+        wait.reset();
+        lat.push_back(TimestampUtil::now_ns() - stamp);
+      }
+      cpu = thread_cpu_secs() - cpu_start;
+      parks = wait.parks();
+    });
+    auto next = start;
+    for (size_t i = 0; i < PINGS; ++i) {
+      next += PERIOD;
+      std::this_thread::sleep_until(next);
+      while (!queue.push(TimestampUtil::now_ns()))
+        cpu_relax();
+      bell.ring();
+    }
+    consumer.join();
+    double wall = std::chrono::duration<double>(
+                      std::chrono::steady_clock::now() - start)
+                      .count();
+
+    uint64_t sum = 0;
+    for (uint64_t ns : lat)
+      sum += ns;
+    std::sort(lat.begin(), lat.end());
+    std::cout << std::left << std::setw(10) << to_string(mode) << std::right
+              << std::setw(14) << sum / PINGS << std::setw(14)
+              << lat[PINGS * 99 / 100] << std::setw(11) << std::fixed
+              << std::setprecision(1) << 100.0 * cpu / wall << "%"
+              << std::setw(10) << parks << "\n";
+  }
+}
+
 int main() {
   benchmark_throughput();
+  benchmark_sparse_book();
+  benchmark_level_containers();
+  benchmark_deep_sweep();
+  benchmark_batch_submit();
+  benchmark_queue_batching();
+  benchmark_wait_strategies();
   return 0;
 }
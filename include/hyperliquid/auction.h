@@ -0,0 +1,77 @@
+#pragma once
+
+#include "command.h"
+#include "types.h"
+#include <cstddef>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace hyperliquid {
+
+// inclusive prefix sum of n quantities, in place
+// the avx2 path scans four lanes per step with two shift-and-add rounds and
+// carries the running total from block to block; the tail and targets
+// without avx2 take the scalar loop
+inline void prefix_sum(Quantity *q, size_t n) {
+  size_t i = 0;
+  Quantity carry = 0;
+#if defined(__AVX2__)
+  static_assert(sizeof(Quantity) == 8, "four 64-bit lanes per vector");
+  const __m256i zero = _mm256_setzero_si256();
+  __m256i run = zero;
+  for (; i + 4 <= n; i += 4) {
+    __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(q + i));
+    // [a b c d] + [0 a b c], then + [0 0 a a+b]
+    __m256i t = _mm256_permute4x64_epi64(x, _MM_SHUFFLE(2, 1, 0, 0));
+    x = _mm256_add_epi64(x, _mm256_blend_epi32(t, zero, 0x03));
+    t = _mm256_permute4x64_epi64(x, _MM_SHUFFLE(1, 0, 0, 0));
+    x = _mm256_add_epi64(x, _mm256_blend_epi32(t, zero, 0x0F));
+    x = _mm256_add_epi64(x, run);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(q + i), x);
+    run = _mm256_permute4x64_epi64(x, _MM_SHUFFLE(3, 3, 3, 3));
+  }
+  if (i > 0)
+    carry = q[i - 1];
+#endif
+  for (; i < n; ++i) {
+    carry += q[i];
+    q[i] = carry;
+  }
+}
+
+// clearing price of a call auction over n candidate prices, ascending
+// bid_qty[i] and ask_qty[i] hold the qty resting at px[i] on each side; only
+// prices between the best ask and the best bid can clear, and outside them
+// no bid sits above or ask below, so these arrays are the whole crossed
+// region. both are overwritten with prefix sums. the price maximises matched
+// volume, then minimises the imbalance, then is the lowest such price.
+inline AuctionResult find_clearing_price(const Tick *px, Quantity *bid_qty,
+                                         Quantity *ask_qty, size_t n) {
+  AuctionResult best;
+  if (n == 0)
+    return best;
+  prefix_sum(bid_qty, n);
+  prefix_sum(ask_qty, n);
+  Quantity bid_total = bid_qty[n - 1];
+  Quantity bids_below = 0;
+  Quantity best_gap = 0;
+  for (size_t i = 0; i < n; ++i) {
+    // buyers willing at px[i] bid at or above it, sellers at or below
+    Quantity demand = bid_total - bids_below;
+    Quantity supply = ask_qty[i];
+    Quantity volume = demand < supply ? demand : supply;
+    Quantity gap = demand > supply ? demand - supply : supply - demand;
+    if (volume > best.volume || (volume == best.volume && volume > 0 &&
+                                 gap < best_gap)) {
+      best.price = px[i];
+      best.volume = volume;
+      best.imbalance = demand - supply;
+      best_gap = gap;
+    }
+    bids_below = bid_qty[i];
+  }
+  return best;
+}
+
+} // namespace hyperliquid
@@ -0,0 +1,219 @@
+#pragma once
+
+#include "wait_strategy.h"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <type_traits>
+
+namespace hyperliquid {
+
+// single-producer, multi-consumer broadcast ring, size must be power of 2
+// every event is written once and each consumer walks the same slots with
+// its own cursor. the producer never overwrites a slot a required consumer
+// has not read yet: it caches the slowest required cursor and only rescans
+// them when the ring looks full. lossy consumers (ui feeds and the like) do
+// not hold the producer back; they copy each event out and check the slot
+// sequence afterwards, skipping ahead when they were lapped.
+// subscribe every consumer before the producer starts.
+template <typename T, size_t N> class BroadcastRing {
+  static_assert((N & (N - 1)) == 0, "size must be power of 2");
+  static_assert(std::is_trivially_copyable<T>::value,
+                "T must be trivially copyable");
+
+public:
+  static constexpr size_t MAX_CONSUMERS = 16;
+
+  BroadcastRing() = default;
+
+  BroadcastRing(const BroadcastRing &) = delete;
+  BroadcastRing &operator=(const BroadcastRing &) = delete;
+  BroadcastRing(BroadcastRing &&) = delete;
+  BroadcastRing &operator=(BroadcastRing &&) = delete;
+
+  // cursor of one consumer, used by one thread
+  class Reader {
+  public:
+    Reader() = default;
+
+    bool lossy() const noexcept { return lossy_; }
+    // events lost to being lapped, always 0 for required consumers
+    uint64_t skipped() const noexcept { return skipped_; }
+    uint64_t position() const noexcept { return next_; }
+
+    bool empty() const noexcept {
+      return next_ == ring_->published_.load(std::memory_order_acquire);
+    }
+
+    // call fn(const T &) on up to max events, then release them with one
+    // cursor update. required consumers read the slots in place; lossy
+    // ones read a validated copy. fn must not touch the ring.
+    template <typename Fn> size_t consume(Fn &&fn, size_t max) {
+      if (lossy_) {
+        size_t n = 0;
+        T item;
+        while (n < max && pop(item)) {
+          fn(item);
+          ++n;
+        }
+        return n;
+      }
+      size_t avail = cached_published_ - next_;
+      if (avail < max) {
+        cached_published_ = ring_->published_.load(std::memory_order_acquire);
+        avail = cached_published_ - next_;
+      }
+      const size_t n = std::min<size_t>(avail, max);
+      for (size_t i = 0; i < n; ++i)
+        fn(ring_->slots_[(next_ + i) & MASK].value);
+      if (n > 0) {
+        next_ += n;
+        cursor_->store(next_, std::memory_order_release);
+      }
+      return n;
+    }
+
+    bool pop(T &item) noexcept {
+      if (!lossy_) {
+        return consume([&item](const T &v) { item = v; }, 1) == 1;
+      }
+      while (true) {
+        if (next_ == cached_published_) {
+          cached_published_ = ring_->published_.load(std::memory_order_acquire);
+          if (next_ == cached_published_)
+            return false;
+        }
+        // lapped: the oldest event still in the ring is published - N
+        if (cached_published_ - next_ > N)
+          skip_to(cached_published_ - N);
+        const Slot &slot = ring_->slots_[next_ & MASK];
+        uint64_t seq = slot.seq.load(std::memory_order_acquire);
+        if (seq == done(next_)) {
+          item = slot.value;
+          std::atomic_thread_fence(std::memory_order_acquire);
+          if (slot.seq.load(std::memory_order_relaxed) == seq) {
+            ++next_;
+            return true;
+          }
+        }
+        // overwritten while we looked: move past what the producer may be
+        // writing now
+        cached_published_ = ring_->published_.load(std::memory_order_acquire);
+        skip_to(std::max(next_ + 1, cached_published_ + 1 - N));
+      }
+    }
+
+  private:
+    friend class BroadcastRing;
+
+    void skip_to(uint64_t seq) noexcept {
+      skipped_ += seq - next_;
+      next_ = seq;
+    }
+
+    BroadcastRing *ring_{nullptr};
+    std::atomic<uint64_t> *cursor_{nullptr}; // required consumers only
+    uint64_t next_{0};                       // next sequence to read
+    uint64_t cached_published_{0};
+    uint64_t skipped_{0};
+    bool lossy_{false};
+  };
+
+  // add a consumer that starts at the next event published. a required
+  // consumer gates the producer, at most MAX_CONSUMERS of them.
+  Reader subscribe(bool lossy = false) {
+    Reader r;
+    r.ring_ = this;
+    r.lossy_ = lossy;
+    r.next_ = r.cached_published_ = head_;
+    if (!lossy) {
+      assert(num_required_ < MAX_CONSUMERS);
+      r.cursor_ = &cursors_[num_required_++].value;
+      r.cursor_->store(head_, std::memory_order_relaxed);
+    }
+    return r;
+  }
+
+  bool push(const T &item) noexcept {
+    if (head_ - cached_gate_ >= N) {
+      // looks full, re-read the required consumers' cursors
+      cached_gate_ = slowest_cursor();
+      if (head_ - cached_gate_ >= N)
+        return false;
+    }
+    write(head_, item);
+    ++head_;
+    published_.store(head_, std::memory_order_release);
+    return true;
+  }
+
+  // push as many of items as fit, publishing the cursor once
+  // returns the number pushed, 0 when full
+  size_t push_n(std::span<const T> items) noexcept {
+    size_t free = N - (head_ - cached_gate_);
+    if (free < items.size()) {
+      cached_gate_ = slowest_cursor();
+      free = N - (head_ - cached_gate_);
+    }
+    const size_t n = std::min(free, items.size());
+    for (size_t i = 0; i < n; ++i)
+      write(head_ + i, items[i]);
+    if (n > 0) {
+      head_ += n;
+      published_.store(head_, std::memory_order_release);
+    }
+    return n;
+  }
+
+  // events published so far
+  uint64_t published() const noexcept {
+    return published_.load(std::memory_order_acquire);
+  }
+
+  static constexpr size_t capacity() noexcept { return N; }
+
+private:
+  static constexpr uint64_t MASK = N - 1;
+
+  // slot sequence: odd while event s is written, done(s) once it is
+  static constexpr uint64_t writing(uint64_t s) noexcept { return 2 * s + 1; }
+  static constexpr uint64_t done(uint64_t s) noexcept { return 2 * s + 2; }
+
+  struct Slot {
+    std::atomic<uint64_t> seq{0};
+    T value;
+  };
+
+  struct alignas(64) PaddedCursor {
+    std::atomic<uint64_t> value{0};
+  };
+
+  void write(uint64_t s, const T &item) noexcept {
+    Slot &slot = slots_[s & MASK];
+    slot.seq.store(writing(s), std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.value = item;
+    slot.seq.store(done(s), std::memory_order_release);
+  }
+
+  // oldest sequence a required consumer still needs, head_ if none
+  uint64_t slowest_cursor() const noexcept {
+    uint64_t min = head_;
+    for (size_t i = 0; i < num_required_; ++i)
+      min = std::min(min, cursors_[i].value.load(std::memory_order_acquire));
+    return min;
+  }
+
+  // producer side
+  alignas(64) std::atomic<uint64_t> published_{0};
+  uint64_t head_{0};        // next sequence to write
+  uint64_t cached_gate_{0}; // slowest required cursor, as last read
+  size_t num_required_{0};
+  PaddedCursor cursors_[MAX_CONSUMERS];
+  alignas(64) Slot slots_[N];
+};
+
+} // namespace hyperliquid
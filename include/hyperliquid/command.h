@@ -7,9 +7,20 @@ namespace hyperliquid {
 enum class CommandType : uint8_t {
   NewOrder = 0,
   CancelOrder = 1,
-  ModifyOrder = 2
+  ModifyOrder = 2,
+  MassCancel = 3, // all resting orders of user_id, see MassCancelFlags
+  EndOfStream = 4 // control: nothing follows on this queue, see StreamEnd
 };
 
+// filters of a MassCancel command, in OrderCommand::flags
+// BY_SIDE keeps the cancel to orders on cmd.side, BY_PRICE to orders priced
+// in [cmd.price_ticks, cmd.stop_price]
+namespace MassCancelFlags {
+constexpr uint32_t ALL = 0;
+constexpr uint32_t BY_SIDE = 1 << 0;
+constexpr uint32_t BY_PRICE = 1 << 1;
+} // namespace MassCancelFlags
+
 struct OrderCommand {
   CommandType type;
   Timestamp recv_ts;
@@ -30,6 +41,26 @@ struct OrderCommand {
   OrderCommand() = default;
 };
 
+// order filter of a mass cancel, built from a MassCancel command
+struct MassCancelFilter {
+  bool by_side{false};
+  Side side{Side::Bid};
+  bool by_price{false};
+  Tick min_px{0};
+  Tick max_px{0};
+
+  MassCancelFilter() = default;
+  explicit MassCancelFilter(const OrderCommand &cmd)
+      : by_side((cmd.flags & MassCancelFlags::BY_SIDE) != 0), side(cmd.side),
+        by_price((cmd.flags & MassCancelFlags::BY_PRICE) != 0),
+        min_px(cmd.price_ticks), max_px(cmd.stop_price) {}
+
+  bool matches(Side s, Tick px) const noexcept {
+    return (!by_side || s == side) &&
+           (!by_price || (px >= min_px && px <= max_px));
+  }
+};
+
 struct TradeEvent {
   Timestamp ts;
   OrderId taker_id;
@@ -45,6 +76,40 @@ struct TradeEvent {
         price_ticks(px), qty(q) {}
 };
 
+// book update emission counters of an order book
+struct BookUpdateStats {
+  uint64_t requested{0}; // commands that could have moved the top of book
+  uint64_t published{0}; // book updates actually emitted
+
+  uint64_t suppressed() const noexcept { return requested - published; }
+};
+
+// l3 order-by-order event, enough to rebuild the full book downstream
+// Added: order rests with qty. Reduced: qty cancelled from a resting order.
+// Executed: qty filled against a resting order, which leaves the book once
+// its remaining qty reaches zero. Deleted: order removed with qty remaining.
+// Replaced: resting order moved to price with qty, at the back of the queue.
+enum class OrderEventKind : uint8_t {
+  Added = 0,
+  Reduced = 1,
+  Executed = 2,
+  Deleted = 3,
+  Replaced = 4
+};
+
+struct OrderEvent {
+  Timestamp ts;
+  SeqNo seq; // per-book sequence number, gapless across l3 events
+  OrderId order_id;
+  SymbolId symbol_id;
+  Side side;
+  OrderEventKind kind;
+  Tick price_ticks;
+  Quantity qty;
+
+  OrderEvent() = default;
+};
+
 struct BookUpdate {
   Timestamp ts;
   SymbolId symbol_id;
@@ -56,6 +121,52 @@ struct BookUpdate {
   BookUpdate() = default;
 };
 
+// aggregated price level of an l2 depth view
+struct DepthLevel {
+  Tick price_ticks;
+  Quantity qty;
+  uint32_t count; // resting orders
+};
+
+// change to one level of the top-n depth view; qty 0 means the level left
+// the view, either because it emptied or because a better level pushed it out
+struct DepthUpdate {
+  Timestamp ts;
+  SymbolId symbol_id;
+  Side side;
+  Tick price_ticks;
+  Quantity qty;
+  uint32_t count;
+
+  DepthUpdate() = default;
+};
+
+// last event of an engine, published once its input reached EndOfStream
+struct StreamEnd {
+  Timestamp ts;
+  uint32_t engine_id;
+  uint64_t commands; // commands the engine processed, over all its books
+
+  StreamEnd() = default;
+};
+
+// outcome of a dry-run match, see OrderBook::preview_match
+struct MatchPreview {
+  Quantity filled{0};        // qty that would trade
+  Quantity stp_cancelled{0}; // taker qty self-trade prevention would remove
+  int64_t notional{0};       // sum of fill qty * price in ticks
+  Tick last_px{0};           // worst price traded
+  uint32_t makers{0};        // resting orders traded against
+  bool exact{true}; // false if iceberg refills could trade beyond this
+};
+
+// outcome of a call auction uncross, see OrderBook::uncross
+struct AuctionResult {
+  Tick price{0};         // clearing price, 0 if the book does not cross
+  Quantity volume{0};    // qty matched at the clearing price
+  Quantity imbalance{0}; // demand minus supply left at the clearing price
+};
+
 struct ExecResult {
   Quantity filled{0};
   Quantity remaining{0};
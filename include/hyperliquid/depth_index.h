@@ -0,0 +1,80 @@
+#pragma once
+
+#include "types.h"
+#include <cstddef>
+#include <vector>
+
+namespace hyperliquid {
+
+/// Fenwick tree over per-level quantity and notional (qty * price) for a
+/// dense index range. Prefix sums and cumulative-depth searches are O(log N).
+class DepthIndex {
+public:
+  DepthIndex() = default;
+
+  explicit DepthIndex(size_t size)
+      : qty_(size + 1, 0), notional_(size + 1, 0) {
+    top_bit_ = 1;
+    while (top_bit_ <= size)
+      top_bit_ <<= 1;
+    top_bit_ >>= 1;
+  }
+
+  bool enabled() const noexcept { return !qty_.empty(); }
+  size_t size() const noexcept { return qty_.empty() ? 0 : qty_.size() - 1; }
+
+  Quantity total_qty() const noexcept { return total_qty_; }
+  int64_t total_notional() const noexcept { return total_notional_; }
+
+  /// Add dq at index i, which trades at price px
+  void add(size_t i, Quantity dq, Tick px) noexcept {
+    int64_t dn = dq * px;
+    total_qty_ += dq;
+    total_notional_ += dn;
+    for (size_t k = i + 1; k < qty_.size(); k += k & (~k + 1)) {
+      qty_[k] += dq;
+      notional_[k] += dn;
+    }
+  }
+
+  /// Sum of quantity over [0, i]
+  Quantity prefix_qty(size_t i) const noexcept {
+    Quantity sum = 0;
+    for (size_t k = i + 1; k > 0; k &= k - 1)
+      sum += qty_[k];
+    return sum;
+  }
+
+  /// Sum of notional over [0, i]
+  int64_t prefix_notional(size_t i) const noexcept {
+    int64_t sum = 0;
+    for (size_t k = i + 1; k > 0; k &= k - 1)
+      sum += notional_[k];
+    return sum;
+  }
+
+  /// Number of leading indexes whose cumulative quantity stays below target
+  /// (inclusive=false) or at most target (inclusive=true)
+  size_t count_prefix(Quantity target, bool inclusive) const noexcept {
+    size_t pos = 0;
+    Quantity rem = target;
+    for (size_t step = top_bit_; step > 0; step >>= 1) {
+      size_t next = pos + step;
+      if (next < qty_.size() &&
+          (inclusive ? qty_[next] <= rem : qty_[next] < rem)) {
+        pos = next;
+        rem -= qty_[next];
+      }
+    }
+    return pos;
+  }
+
+private:
+  std::vector<Quantity> qty_;
+  std::vector<int64_t> notional_;
+  size_t top_bit_{0};
+  Quantity total_qty_{0};
+  int64_t total_notional_{0};
+};
+
+} // namespace hyperliquid
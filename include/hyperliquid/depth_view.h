@@ -0,0 +1,102 @@
+#pragma once
+
+#include "command.h"
+#include "types.h"
+#include <algorithm>
+#include <cstddef>
+
+namespace hyperliquid {
+
+// incrementally maintained top-n aggregated levels for one side
+// levels are kept best-first. the view always holds min(depth, levels on the
+// side), so a level outside it can change without affecting the view, and
+// when a visible level empties the next one is pulled in from the book.
+class DepthView {
+public:
+  static constexpr size_t MAX_DEPTH = 20;
+
+  explicit DepthView(Side side, size_t depth = 0)
+      : side_(side), depth_(std::min(depth, MAX_DEPTH)) {}
+
+  Side side() const noexcept { return side_; }
+  size_t depth() const noexcept { return depth_; }
+  size_t size() const noexcept { return size_; }
+  bool enabled() const noexcept { return depth_ > 0; }
+  const DepthLevel &operator[](size_t i) const { return levels_[i]; }
+
+  /// Change the visible depth; the view is emptied and must be refilled
+  void reset(size_t depth) {
+    depth_ = std::min(depth, MAX_DEPTH);
+    size_ = 0;
+  }
+
+  /// The level at px now holds qty in count orders (qty 0: level gone).
+  /// next(worst) returns the next level beyond price worst, price set to
+  /// the side's empty sentinel if there is none. changed(level) is called
+  /// for every visible level that changed, with qty 0 when it left the view.
+  template <typename NextFn, typename ChangedFn>
+  void update(Tick px, Quantity qty, uint32_t count, NextFn &&next,
+              ChangedFn &&changed) {
+    size_t i = 0;
+    while (i < size_ && better(levels_[i].price_ticks, px))
+      ++i;
+    bool found = i < size_ && levels_[i].price_ticks == px;
+
+    if (found) {
+      if (qty > 0) {
+        levels_[i].qty = qty;
+        levels_[i].count = count;
+        changed(levels_[i]);
+        return;
+      }
+      bool was_full = size_ == depth_;
+      std::move(levels_ + i + 1, levels_ + size_, levels_ + i);
+      --size_;
+      changed(DepthLevel{px, 0, 0});
+      // a full view may have hidden levels behind it
+      if (was_full) {
+        Tick worst = size_ ? levels_[size_ - 1].price_ticks : px;
+        DepthLevel lvl = next(worst);
+        if (lvl.price_ticks != empty_price()) {
+          levels_[size_++] = lvl;
+          changed(lvl);
+        }
+      }
+      return;
+    }
+
+    if (qty == 0 || i >= depth_)
+      return; // not visible
+    if (size_ == depth_) {
+      --size_;
+      changed(DepthLevel{levels_[size_].price_ticks, 0, 0});
+    }
+    std::move_backward(levels_ + i, levels_ + size_, levels_ + size_ + 1);
+    levels_[i] = DepthLevel{px, qty, count};
+    ++size_;
+    changed(levels_[i]);
+  }
+
+  /// Copy up to max visible levels, best first
+  size_t snapshot(DepthLevel *out, size_t max) const {
+    size_t n = std::min(max, size_);
+    std::copy(levels_, levels_ + n, out);
+    return n;
+  }
+
+private:
+  bool better(Tick a, Tick b) const {
+    return side_ == Side::Bid ? a > b : a < b;
+  }
+
+  Tick empty_price() const {
+    return side_ == Side::Bid ? Sentinel::EMPTY_BID : Sentinel::EMPTY_ASK;
+  }
+
+  Side side_;
+  size_t depth_;
+  size_t size_{0};
+  DepthLevel levels_[MAX_DEPTH];
+};
+
+} // namespace hyperliquid
@@ -5,18 +5,30 @@
 
 namespace hyperliquid {
 
-enum class EventType : uint8_t { Trade = 0, BookUpdate = 1 };
+enum class EventType : uint8_t {
+  Trade = 0,
+  BookUpdate = 1,
+  Order = 2,
+  Depth = 3,
+  EndOfStream = 4
+};
 
 struct AnyEvent {
   EventType type;
   union {
     TradeEvent trade;
     BookUpdate book_update;
+    OrderEvent order;
+    DepthUpdate depth;
+    StreamEnd end;
   };
 
   AnyEvent() {}
   AnyEvent(const TradeEvent &t) : type(EventType::Trade), trade(t) {}
   AnyEvent(const BookUpdate &b) : type(EventType::BookUpdate), book_update(b) {}
+  AnyEvent(const OrderEvent &o) : type(EventType::Order), order(o) {}
+  AnyEvent(const DepthUpdate &d) : type(EventType::Depth), depth(d) {}
+  AnyEvent(const StreamEnd &e) : type(EventType::EndOfStream), end(e) {}
 };
 
 } // namespace hyperliquid
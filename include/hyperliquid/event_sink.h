@@ -0,0 +1,105 @@
+#pragma once
+
+#include "command.h"
+#include "event.h"
+#include "wait_strategy.h"
+#include <chrono>
+#include <functional>
+#include <utility>
+
+namespace hyperliquid {
+
+// event sink policies for OrderBook
+// a sink is a template parameter of the book, so emission is a direct call
+// the compiler can inline into the match loop. the wants_*() checks gate
+// building each event; sinks that always or never want an event kind return
+// a constant and the check folds away.
+
+// discards everything, for benchmarks and backtests
+struct NullSink {
+  static constexpr bool wants_trades() noexcept { return false; }
+  static constexpr bool wants_book_updates() noexcept { return false; }
+  static constexpr bool wants_orders() noexcept { return false; }
+  static constexpr bool wants_depth() noexcept { return false; }
+  void on_trade(const TradeEvent &) noexcept {}
+  void on_book_update(const BookUpdate &) noexcept {}
+  void on_order(const OrderEvent &) noexcept {}
+  void on_depth(const DepthUpdate &) noexcept {}
+};
+
+// forwards to std::function callbacks, for tools and tests
+class CallbackSink {
+public:
+  bool wants_trades() const noexcept { return static_cast<bool>(on_trade_); }
+  bool wants_book_updates() const noexcept {
+    return static_cast<bool>(on_book_update_);
+  }
+  bool wants_orders() const noexcept { return static_cast<bool>(on_order_); }
+  bool wants_depth() const noexcept { return static_cast<bool>(on_depth_); }
+
+  void on_trade(const TradeEvent &trade) { on_trade_(trade); }
+  void on_book_update(const BookUpdate &update) { on_book_update_(update); }
+  void on_order(const OrderEvent &order) { on_order_(order); }
+  void on_depth(const DepthUpdate &depth) { on_depth_(depth); }
+
+  void set_on_trade(std::function<void(const TradeEvent &)> cb) {
+    on_trade_ = std::move(cb);
+  }
+  void set_on_book_update(std::function<void(const BookUpdate &)> cb) {
+    on_book_update_ = std::move(cb);
+  }
+  void set_on_order(std::function<void(const OrderEvent &)> cb) {
+    on_order_ = std::move(cb);
+  }
+  void set_on_depth(std::function<void(const DepthUpdate &)> cb) {
+    on_depth_ = std::move(cb);
+  }
+
+private:
+  std::function<void(const TradeEvent &)> on_trade_;
+  std::function<void(const BookUpdate &)> on_book_update_;
+  std::function<void(const OrderEvent &)> on_order_;
+  std::function<void(const DepthUpdate &)> on_depth_;
+};
+
+// pushes events into an spsc queue of AnyEvent, waiting per the wait mode
+// while it is full. l3 order events are opt-in as they multiply the queue
+// traffic; depth updates only flow when the book maintains a depth view
+template <typename Queue> class QueueSink {
+public:
+  explicit QueueSink(Queue *queue = nullptr, bool order_events = false,
+                     WaitMode wait = WaitMode::Yield)
+      : queue_(queue), order_events_(order_events),
+        wait_(wait, nullptr, std::chrono::microseconds(50)) {}
+
+  static constexpr bool wants_trades() noexcept { return true; }
+  static constexpr bool wants_book_updates() noexcept { return true; }
+  bool wants_orders() const noexcept { return order_events_; }
+  static constexpr bool wants_depth() noexcept { return true; }
+
+  void on_trade(const TradeEvent &trade) { push(AnyEvent(trade)); }
+  void on_book_update(const BookUpdate &update) { push(AnyEvent(update)); }
+  void on_order(const OrderEvent &order) { push(AnyEvent(order)); }
+  void on_depth(const DepthUpdate &depth) { push(AnyEvent(depth)); }
+  // marks the end of this queue for the consumer, nothing may follow
+  void on_stream_end(const StreamEnd &end) { push(AnyEvent(end)); }
+
+  // time spent waiting on a full queue
+  uint64_t stall_ns() const noexcept { return wait_.idle_ns(); }
+
+private:
+  void push(const AnyEvent &evt) {
+    if (queue_->push(evt))
+      return;
+    // back-pressure: nobody signals free space, so parks time out
+    while (!queue_->push(evt))
+      wait_.idle();
+    wait_.reset();
+  }
+
+  Queue *queue_;
+  bool order_events_;
+  WaitStrategy wait_;
+};
+
+} // namespace hyperliquid
@@ -3,6 +3,8 @@
 #include "command.h"
 #include "spsc_queue.h"
 #include "types.h"
+#include "wait_strategy.h"
+#include <span>
 #include <string>
 #include <vector>
 
@@ -12,18 +14,50 @@ class FeedHandler {
 public:
   struct Config {
     std::string input_file;
-    std::vector<SPSCQueue<OrderCommand, 65536> *>
-        param_queues; // Queues indexed by symbol_id
+    // Queues indexed by symbol_id; symbols matched on the same engine share
+    // its queue
+    std::vector<SPSCQueue<OrderCommand, 65536> *> param_queues;
+    // Rung after each push to the queue of the same index, to wake engines
+    // that park (optional)
+    std::vector<Doorbell *> bells;
+    // Every engine input with its bell, to end each with EndOfStream also
+    // when no symbol maps to it (optional next to param_queues)
+    std::vector<SPSCQueue<OrderCommand, 65536> *> engine_queues;
+    std::vector<Doorbell *> engine_bells;
+    WaitMode wait{WaitMode::Yield}; // while a queue is full
   };
 
   explicit FeedHandler(const Config &config);
 
-  // identifying the main loop
+  // identifying the main loop; replays the file, then ends every queue
+  // with an EndOfStream command
   void run();
 
+  // valid after run() returned
+  const StageStats &stats() const { return stats_; }
+
+  // commands per symbol_id below symbols in an input file, the observed
+  // load to spread symbols over engines by; empty if it cannot be read
+  static std::vector<uint64_t> symbol_load(const std::string &path,
+                                           size_t symbols);
+
 private:
+  // push the commands of the input file, returns how many were pushed
+  uint64_t replay();
+  void end_stream();
+  void push_all(SPSCQueue<OrderCommand, 65536> *queue, Doorbell *bell,
+                std::span<const OrderCommand> pending);
+
+  // Commands for one queue handed over in a single push_n
+  static constexpr size_t MAX_RUN = 256;
+
   std::string input_path_;
   std::vector<SPSCQueue<OrderCommand, 65536> *> queues_;
+  std::vector<Doorbell *> bells_;
+  std::vector<SPSCQueue<OrderCommand, 65536> *> engine_queues_;
+  std::vector<Doorbell *> engine_bells_;
+  WaitStrategy wait_;
+  StageStats stats_;
 };
 
 } // namespace hyperliquid
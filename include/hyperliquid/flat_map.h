@@ -70,13 +70,9 @@ public:
           Entry &probe_entry = entries_[probe_idx];
           size_t desired_idx = hash(probe_entry.key) & buf_mask;
 
-          // Check if probe_entry belongs between idx (now empty) and probe_idx
-          // Handles wrapping around buffer end
+          // The entry may fill the hole at idx unless its desired slot
+          // lies cyclically in (idx, probe_idx], i.e. after the hole
           bool wrapped = probe_idx < idx;
-          // bool desired_wrapped = (desired_idx < idx);
-          // (desired_idx <= probe_idx) ||
-          //    (desired_idx >
-          //     idx); // if desired_idx is "before" probe_idx logically
 
           bool can_move;
           if (!wrapped) {
@@ -84,13 +80,9 @@ public:
             // Move if desired hash is <= idx OR > probe_idx
             can_move = (desired_idx <= idx) || (desired_idx > probe_idx);
           } else {
-            // Wrapped case: probe_idx < idx
-            // Move if desired index is in the "gap" [desired ... idx ... probe]
-            // Logic: desired <= idx results in move?
-            // It's tricky. Let's rely on standard logic:
-            // if desired <= idx it belongs earlier.
-            // if desired > probe_idx it belongs earlier (wrapped).
-            can_move = (desired_idx <= idx) || (desired_idx > probe_idx);
+            // Wrapped case: probe_idx < idx, (idx, probe_idx] wraps past
+            // the end, so only desired slots in (probe_idx, idx] may move
+            can_move = (desired_idx <= idx) && (desired_idx > probe_idx);
           }
 
           if (can_move) {
@@ -118,14 +110,8 @@ private:
     std::vector<Entry> old_entries = std::move(entries_);
 
     capacity_ = new_cap;
-    entries_.resize(capacity_);
     // Init with EmptyKey
-    if (EmptyKey != 0) {
-      for (auto &e : entries_)
-        e.key = EmptyKey;
-    } else {
-      std::memset(entries_.data(), 0, capacity_ * sizeof(Entry));
-    }
+    entries_.assign(capacity_, Entry{EmptyKey, Value{}});
 
     size_ = 0;
     for (const auto &e : old_entries) {
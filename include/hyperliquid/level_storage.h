@@ -0,0 +1,159 @@
+#pragma once
+
+#include "order.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <numeric>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+#ifndef MAP_NORESERVE
+#define MAP_NORESERVE 0
+#endif
+
+namespace hyperliquid {
+
+// level storage policies for BasicPriceLevelsArray
+// the array reports level occupancy changes so storage can track usage
+
+// eagerly value-initialised levels, the whole band is resident up front
+class VectorLevelStorage {
+public:
+  explicit VectorLevelStorage(size_t n) : levels_(n) {}
+
+  LevelFIFO &operator[](size_t i) { return levels_[i]; }
+  const LevelFIFO &operator[](size_t i) const { return levels_[i]; }
+  size_t size() const noexcept { return levels_.size(); }
+
+  void on_occupied(size_t) noexcept {}
+  void on_emptied(size_t) noexcept {}
+
+private:
+  std::vector<LevelFIFO> levels_;
+};
+
+// levels in reserved anonymous memory, committed by the kernel on first
+// write. an empty LevelFIFO is all-zero, so untouched and released pages
+// read back as empty levels. trim_idle() returns chunks whose levels have
+// all stayed empty for a number of trim epochs; it only looks at chunks
+// that emptied since, never the whole band.
+// the array's occupancy bitmap stays dense, so a side costs about band / 8
+// bytes of resident memory however few of its levels are in use.
+class MappedLevelStorage {
+  struct Chunk {
+    uint32_t live{0};       // non-empty levels in this chunk
+    uint32_t idle_since{0}; // epoch at which live dropped to zero
+    bool dirty{false};      // written since the last release
+    bool queued{false};     // in the trim candidate list
+  };
+
+public:
+  explicit MappedLevelStorage(size_t n) : size_(n) {
+    size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    // smallest whole number of pages holding a whole number of levels
+    chunk_bytes_ = std::lcm(page, sizeof(LevelFIFO));
+    chunk_levels_ = chunk_bytes_ / sizeof(LevelFIFO);
+    size_t chunks = (n + chunk_levels_ - 1) / chunk_levels_;
+    bytes_ = chunks * chunk_bytes_;
+
+    void *ptr = mmap(nullptr, bytes_, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (ptr == MAP_FAILED) {
+      perror("mmap failed");
+      std::abort();
+    }
+    levels_ = static_cast<LevelFIFO *>(ptr);
+    chunks_.resize(chunks);
+  }
+
+  ~MappedLevelStorage() {
+    if (levels_)
+      munmap(levels_, bytes_);
+  }
+
+  MappedLevelStorage(const MappedLevelStorage &) = delete;
+  MappedLevelStorage &operator=(const MappedLevelStorage &) = delete;
+
+  MappedLevelStorage(MappedLevelStorage &&other) noexcept
+      : levels_(std::exchange(other.levels_, nullptr)), size_(other.size_),
+        bytes_(other.bytes_), chunk_bytes_(other.chunk_bytes_),
+        chunk_levels_(other.chunk_levels_), chunks_(std::move(other.chunks_)),
+        candidates_(std::move(other.candidates_)),
+        dirty_chunks_(other.dirty_chunks_), epoch_(other.epoch_) {}
+
+  MappedLevelStorage &operator=(MappedLevelStorage &&) = delete;
+
+  LevelFIFO &operator[](size_t i) { return levels_[i]; }
+  const LevelFIFO &operator[](size_t i) const { return levels_[i]; }
+  size_t size() const noexcept { return size_; }
+
+  void on_occupied(size_t i) noexcept {
+    Chunk &c = chunks_[i / chunk_levels_];
+    ++c.live;
+    if (!c.dirty) {
+      c.dirty = true;
+      ++dirty_chunks_;
+    }
+  }
+
+  void on_emptied(size_t i) noexcept {
+    size_t index = i / chunk_levels_;
+    Chunk &c = chunks_[index];
+    if (--c.live == 0) {
+      c.idle_since = epoch_;
+      if (!c.queued) {
+        c.queued = true;
+        candidates_.push_back(index);
+      }
+    }
+  }
+
+  /// Start a new epoch and release chunks that have been empty for at least
+  /// min_idle_epochs epochs. Returns the number of chunks released.
+  size_t trim_idle(uint32_t min_idle_epochs) {
+    ++epoch_;
+    size_t released = 0;
+    size_t kept = 0;
+    for (size_t index : candidates_) {
+      Chunk &chunk = chunks_[index];
+      if (chunk.live == 0 && epoch_ - chunk.idle_since < min_idle_epochs) {
+        candidates_[kept++] = index; // not idle long enough yet
+        continue;
+      }
+      chunk.queued = false;
+      if (chunk.live != 0)
+        continue; // reused, queued again when it next empties
+      madvise(reinterpret_cast<char *>(levels_) + index * chunk_bytes_,
+              chunk_bytes_, MADV_DONTNEED);
+      chunk.dirty = false;
+      --dirty_chunks_;
+      ++released;
+    }
+    candidates_.resize(kept);
+    return released;
+  }
+
+  /// Chunks written since they were last released (upper bound on RSS)
+  size_t dirty_chunks() const noexcept { return dirty_chunks_; }
+
+  size_t chunk_bytes() const noexcept { return chunk_bytes_; }
+
+private:
+  LevelFIFO *levels_{nullptr};
+  size_t size_;
+  size_t bytes_{0};
+  size_t chunk_bytes_{0};
+  size_t chunk_levels_{1};
+  std::vector<Chunk> chunks_;
+  std::vector<size_t> candidates_; // chunks that emptied, maybe idle now
+  size_t dirty_chunks_{0};
+  uint32_t epoch_{0};
+};
+
+} // namespace hyperliquid
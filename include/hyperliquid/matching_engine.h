@@ -1,32 +1,93 @@
 #pragma once
 
+#include "broadcast_ring.h"
 #include "command.h"
 #include "event.h"
+#include "event_sink.h"
 #include "order_book.h"
 #include "price_levels_array.h"
 #include "spsc_queue.h"
+#include "wait_strategy.h"
 #include <memory>
+#include <vector>
 
 namespace hyperliquid {
 
+/// Engine worker that owns the books of a set of symbols. It drains one
+/// input queue carrying the commands of all of them, tagged by symbol_id,
+/// and publishes their events to one output queue, so many symbols share a
+/// core instead of each needing a thread.
 class MatchingEngine {
 public:
+  // Events are written once and read in place by every subscriber
+  using OutputQueue = BroadcastRing<AnyEvent, 65536>;
+  using Book = OrderBook<PriceLevelsLazyArray, QueueSink<OutputQueue>>;
+
   struct Config {
-    SymbolId symbol_id;
+    uint32_t engine_id{0};
+    std::vector<SymbolId> symbols; // one book each, same price band
     PriceBand price_band;
-    SPSCQueue<OrderCommand, 65536> *input_queue;
-    SPSCQueue<AnyEvent, 65536> *output_queue;
+    SPSCQueue<OrderCommand, 65536> *input_queue; // commands of all symbols
+    OutputQueue *output_queue;
+    bool order_events{false}; // publish L3 order-by-order events
+    size_t depth_levels{0};   // publish top-N L2 depth updates (0: off)
+    // Book update conflation: publish at most one BookUpdate per this many
+    // commands and/or per this many nanoseconds (0: not used for either)
+    uint32_t conflate_commands{0};
+    uint64_t conflate_ns{0};
+    bool aggregate_trades{false}; // one trade per level a taker matches at
+    // GTD expiry clock: false follows command recv_ts (deterministic
+    // replay), true follows the local steady clock (live feeds)
+    bool expire_on_wall_clock{false};
+    // Idle policy, for an empty input queue and a full output queue
+    WaitMode wait{WaitMode::Yield};
+    Doorbell *input_bell{nullptr};  // rung by the feed, parked on when idle
+    Doorbell *output_bell{nullptr}; // rung after events are published
   };
 
   explicit MatchingEngine(const Config &config);
+
+  /// Runs until an EndOfStream command, then publishes a StreamEnd event
   void run();
 
+  /// Commands processed and time split, valid after run() returned
+  const StageStats &stats() const { return stats_; }
+
+  /// Book update counters summed over the books, including how many
+  /// updates were suppressed
+  BookUpdateStats book_update_stats() const;
+
 private:
+  // Idle polls between level trims, and trim epochs a chunk must stay empty
+  // before its memory is released
+  static constexpr uint32_t TRIM_IDLE_SPINS = 1 << 16;
+  static constexpr uint32_t TRIM_IDLE_EPOCHS = 4;
+
+  // Commands drained from the input queue per poll and executed as one
+  // OrderBook batch
+  static constexpr size_t MAX_BATCH = 64;
+
   Config config_;
-  std::unique_ptr<OrderBook<PriceLevelsArray>> order_book_;
+  Timestamp now_{0}; // engine clock for GTD expiry
+
+  /// Current time for GTD expiry, see Config::expire_on_wall_clock
+  Timestamp clock() const {
+    return config_.expire_on_wall_clock ? TimestampUtil::now_ns() : now_;
+  }
+
+  /// Publish what is pending and the StreamEnd that closes the output
+  void end_stream();
+  void flush_book_updates();
+
+  /// Book of a symbol, nullptr for symbols of other engines
+  Book *book_for(SymbolId symbol) const {
+    return symbol < by_symbol_.size() ? by_symbol_[symbol] : nullptr;
+  }
 
-  void process_trade(const TradeEvent &trade);
-  void process_book_update(const BookUpdate &update);
+  std::vector<std::unique_ptr<Book>> books_;
+  std::vector<Book *> by_symbol_; // indexed by symbol_id
+  WaitStrategy wait_;
+  StageStats stats_;
 };
 
 } // namespace hyperliquid
@@ -94,6 +94,15 @@ public:
     --in_use_;
   }
 
+  // return a chain of n objects linked through their first member, from
+  // first to last, in one splice. T must begin with its chain pointer.
+  void free_chain(T *first, T *last, size_t n) noexcept {
+    assert(in_use_ >= n && "chain larger than pool use");
+    reinterpret_cast<Node *>(last)->next = free_list_;
+    free_list_ = reinterpret_cast<Node *>(first);
+    in_use_ -= n;
+  }
+
   size_t in_use() const noexcept { return in_use_; }
   size_t capacity() const noexcept { return capacity_; }
   size_t num_slabs() const noexcept { return raw_slabs_.size(); }
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace hyperliquid {
+
+/// Hierarchical occupancy bitmap over a dense index range [0, size)
+/// Level 0 holds one bit per index, each level above holds one bit per
+/// non-zero word of the level below, so next/prev set-bit searches cost a
+/// handful of tzcnt/lzcnt operations regardless of the gap size.
+/// All words are allocated up front: about size / 8 bytes, set or not.
+class OccupancyBitmap {
+public:
+  static constexpr size_t npos = static_cast<size_t>(-1);
+
+  OccupancyBitmap() = default;
+
+  explicit OccupancyBitmap(size_t size) : size_(size) {
+    size_t bits = size;
+    do {
+      size_t words = bits ? (bits + 63) / 64 : 1;
+      levels_.emplace_back(words, 0);
+      bits = words;
+    } while (bits > 1);
+  }
+
+  size_t size() const noexcept { return size_; }
+
+  bool test(size_t i) const noexcept {
+    return (levels_[0][i >> 6] >> (i & 63)) & 1;
+  }
+
+  void set(size_t i) noexcept {
+    for (auto &level : levels_) {
+      uint64_t &word = level[i >> 6];
+      bool was_empty = word == 0;
+      word |= bit(i & 63);
+      if (!was_empty)
+        return;
+      i >>= 6;
+    }
+  }
+
+  void clear(size_t i) noexcept {
+    for (auto &level : levels_) {
+      uint64_t &word = level[i >> 6];
+      word &= ~bit(i & 63);
+      if (word != 0)
+        return;
+      i >>= 6;
+    }
+  }
+
+  bool any() const noexcept { return levels_.back()[0] != 0; }
+
+  /// Smallest set index >= i, or npos
+  size_t find_next(size_t i) const noexcept {
+    if (i >= size_)
+      return npos;
+    size_t lvl = 0;
+    // climb until a word has a set bit at or after the current position
+    for (;; ++lvl) {
+      const auto &words = levels_[lvl];
+      if ((i >> 6) >= words.size())
+        return npos;
+      uint64_t word = words[i >> 6] & (~uint64_t{0} << (i & 63));
+      if (word) {
+        i = (i & ~size_t{63}) | ctz(word);
+        break;
+      }
+      if (lvl + 1 == levels_.size())
+        return npos;
+      i = (i >> 6) + 1;
+    }
+    // descend taking the lowest set bit of each word
+    while (lvl-- > 0)
+      i = (i << 6) | ctz(levels_[lvl][i]);
+    return i;
+  }
+
+  /// Largest set index <= i, or npos
+  size_t find_prev(size_t i) const noexcept {
+    if (size_ == 0)
+      return npos;
+    if (i >= size_)
+      i = size_ - 1;
+    size_t lvl = 0;
+    for (;; ++lvl) {
+      uint64_t word = levels_[lvl][i >> 6] & (~uint64_t{0} >> (63 - (i & 63)));
+      if (word) {
+        i = (i & ~size_t{63}) | (63 - clz(word));
+        break;
+      }
+      if ((i >> 6) == 0 || lvl + 1 == levels_.size())
+        return npos;
+      i = (i >> 6) - 1;
+    }
+    while (lvl-- > 0)
+      i = (i << 6) | (63 - clz(levels_[lvl][i]));
+    return i;
+  }
+
+private:
+  static constexpr uint64_t bit(size_t b) noexcept { return uint64_t{1} << b; }
+  static size_t ctz(uint64_t w) noexcept {
+    return static_cast<size_t>(__builtin_ctzll(w));
+  }
+  static size_t clz(uint64_t w) noexcept {
+    return static_cast<size_t>(__builtin_clzll(w));
+  }
+
+  size_t size_{0};
+  std::vector<std::vector<uint64_t>> levels_;
+};
+
+} // namespace hyperliquid
@@ -6,36 +6,54 @@
 
 namespace hyperliquid {
 
+struct WheelTimer; // timing_wheel.h
+
 // intrusive order node for fifo queues
+// only the fields the match loop reads live here, packed into one 64-byte
+// line so resting orders stay dense in the slab pool. next comes first and
+// the fields read per fill share the first 32 bytes; the per-user links at
+// the end are only touched when an order rests or leaves the book.
 struct OrderNode {
+  OrderNode *next{nullptr};
   OrderId id;
-  UserId user;
   Quantity qty;
-  Timestamp ts;
+  UserId user;
   uint32_t flags;
-
-  Quantity display_qty{0}; // iceberg visible qty
-  Quantity hidden_qty{0};  // iceberg hidden qty
-  Timestamp expiry_ts{0};  // gtd expiry
-  Tick stop_price{0};      // stop trigger
-
   OrderNode *prev{nullptr};
-  OrderNode *next{nullptr};
-  uint8_t alloc_kind{0}; // 0=heap, 1=pool
+  Timestamp ts;
+  OrderNode *user_next{nullptr}; // user's other resting orders
+  OrderNode *user_prev{nullptr};
 
   OrderNode() = default;
   OrderNode(OrderId id_, UserId user_, Quantity qty_, Timestamp ts_,
             uint32_t flags_)
-      : id(id_), user(user_), qty(qty_), ts(ts_), flags(flags_) {}
+      : id(id_), qty(qty_), user(user_), flags(flags_), ts(ts_) {}
 
   bool is_iceberg() const noexcept {
     return (flags & OrderFlags::ICEBERG) != 0;
   }
 
-  Quantity replenish() noexcept {
+  bool has_extras() const noexcept {
+    return (flags & NodeFlags::HAS_EXTRAS) != 0;
+  }
+};
+
+static_assert(sizeof(OrderNode) == 64, "hot order node should stay compact");
+
+// cold attributes of iceberg, gtd and stop orders, kept in a side table
+// keyed by order id and only looked up when the node flags say so
+struct OrderExtras {
+  Quantity display_qty{0}; // iceberg visible qty
+  Quantity hidden_qty{0};  // iceberg hidden qty
+  Timestamp expiry_ts{0};  // gtd expiry
+  Tick stop_price{0};      // stop trigger
+  WheelTimer *expiry_timer{nullptr}; // gtd timer, cancelled on leaving
+
+  // refill the visible qty of an iceberg node from its hidden reserve
+  Quantity replenish(OrderNode &node) noexcept {
     if (hidden_qty > 0 && display_qty > 0) {
       Quantity r = std::min(hidden_qty, display_qty);
-      qty = r;
+      node.qty = r;
       hidden_qty -= r;
       return r;
     }
@@ -44,10 +62,15 @@ struct OrderNode {
 };
 
 // fifo queue at a price level
+// total_qty counts the visible qty only, so an iceberg contributes its
+// display slice. icebergs lets the match loop skip the refill check on
+// levels without any.
 struct LevelFIFO {
   OrderNode *head{nullptr};
   OrderNode *tail{nullptr};
   Quantity total_qty{0};
+  uint32_t count{0};    // resting orders
+  uint32_t icebergs{0}; // resting iceberg orders
 
   bool empty() const noexcept { return head == nullptr; }
 
@@ -60,6 +83,8 @@ struct LevelFIFO {
       head = node;
     tail = node;
     total_qty += node->qty;
+    ++count;
+    icebergs += node->is_iceberg();
   }
 
   void erase(OrderNode *node) noexcept {
@@ -72,6 +97,8 @@ struct LevelFIFO {
     else
       tail = node->prev;
     total_qty -= node->qty;
+    --count;
+    icebergs -= node->is_iceberg();
     node->prev = node->next = nullptr;
   }
 
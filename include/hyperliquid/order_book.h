@@ -1,14 +1,22 @@
 #pragma once
 
+#include "auction.h"
 #include "command.h"
+#include "depth_view.h"
+#include "event_sink.h"
 #include "flat_map.h"
 #include "mempool.h"
 #include "order.h"
 #include "price_level.h"
 #include "price_levels_array.h"
+#include "stop_book.h"
+#include "timing_wheel.h"
 #include "timestamp.h"
 #include "types.h"
+#include <cstddef>
 #include <functional>
+#include <limits>
+#include <span>
 #include <utility>
 #include <vector>
 
@@ -35,14 +43,17 @@
 namespace hyperliquid {
 
 /// Order book with template-based price level implementation
+/// Events go to a compile-time sink (see event_sink.h)
 /// Single-threaded, fully owns its data
-template <typename PriceLevelsImpl = PriceLevelsArray> class OrderBook {
+template <typename PriceLevelsImpl = PriceLevelsArray,
+          typename EventSink = CallbackSink>
+class OrderBook {
 public:
   explicit OrderBook(SymbolId symbol_id, PriceLevelsImpl &&bids,
-                     PriceLevelsImpl &&asks)
+                     PriceLevelsImpl &&asks, EventSink sink = EventSink())
       : symbol_id_(symbol_id), bids_(std::move(bids)), asks_(std::move(asks)),
-        order_pool_(2) // Start with 2 slabs
-  {}
+        order_pool_(2), // Start with 2 slabs
+        sink_(std::move(sink)) {}
 
   /// Submit a limit order
   ExecResult submit_limit(const OrderCommand &cmd);
@@ -50,12 +61,69 @@ public:
   /// Submit a market order
   ExecResult submit_market(const OrderCommand &cmd);
 
-  /// Cancel an order by ID
-  bool cancel(OrderId id);
+  /// Submit a stop-limit or stop-market order. It waits in the trigger
+  /// book until the last trade price reaches cmd.stop_price (at or above it
+  /// for buys, at or below for sells), then enters as a limit or market
+  /// order. Fills show up as events; the result reports the parked qty.
+  ExecResult submit_stop(const OrderCommand &cmd);
+
+  /// Cancel an order by ID (resting or pending stop). ts stamps the L3
+  /// Deleted event, 0 for the current time.
+  bool cancel(OrderId id, Timestamp ts = 0);
+
+  /// Cancel all resting and pending stop orders of a user that pass the
+  /// filter (stops by their stop price), walking only that user's orders.
+  /// Emits one book update. Returns the number cancelled.
+  size_t mass_cancel(UserId user,
+                     const MassCancelFilter &filter = MassCancelFilter(),
+                     Timestamp ts = 0);
+
+  /// Cancel per a MassCancel command (see MassCancelFlags)
+  size_t mass_cancel(const OrderCommand &cmd) {
+    return mass_cancel(cmd.user_id, MassCancelFilter(cmd), cmd.recv_ts);
+  }
+
+  /// Modify an existing order to cmd.price_ticks / cmd.qty. A same-price
+  /// size reduction keeps priority; anything else requeues the order at the
+  /// back of its new level (trading first if it crosses). Qty <= 0 cancels.
+  /// Emits a single book update; cmd.recv_ts becomes the new order time.
+  ExecResult modify(const OrderCommand &cmd);
 
-  /// Modify an existing order
+  /// Modify with the current time as order time
   ExecResult modify(OrderId id, Tick new_price, Quantity new_qty);
 
+  /// Execute a command of any type, dispatching on cmd.type and
+  /// cmd.order_type. A cancel of an unknown id reports accepted = false.
+  ExecResult execute(const OrderCommand &cmd);
+
+  /// Execute cmds in order with one book update for the whole batch (left
+  /// pending if conflation is on). GTD orders due by a command's recv_ts
+  /// expire before it runs. results receives the result of each command it
+  /// has room for. Returns the number of results written.
+  size_t submit_batch(std::span<const OrderCommand> cmds,
+                      std::span<ExecResult> results = {});
+
+  /// Start a call auction, e.g. to reopen after a halt. Until uncross(),
+  /// limit orders rest without matching and the book may cross; market,
+  /// IOC and FOK orders cannot rest and are rejected (accepted = false).
+  void begin_auction() { auction_ = true; }
+  bool in_auction() const { return auction_; }
+
+  /// Price and volume the auction would clear at now
+  AuctionResult indicative_uncross();
+
+  /// End the auction. Everything that crosses trades in one pass at the
+  /// clearing price that maximises volume (see find_clearing_price), bids
+  /// and asks each in price-time priority, and continuous matching
+  /// resumes. Trades name the bid as taker. Iceberg reserves do not count
+  /// toward the clearing volume.
+  AuctionResult uncross(Timestamp ts = 0);
+
+  /// Dry-run cmd against the book, for pre-trade checks: what it would
+  /// fill at what cost and what STP would cancel, changing nothing.
+  /// Market orders take any price. Cost is O(makers touched).
+  MatchPreview preview_match(const OrderCommand &cmd);
+
   /// Check if order book is empty for a side
   bool empty(Side s) const {
     return (s == Side::Bid) ? (bids_.best_bid() == Sentinel::EMPTY_BID)
@@ -71,14 +139,103 @@ public:
   /// Get symbol ID
   SymbolId symbol() const { return symbol_id_; }
 
-  /// Set trade event callback
-  void set_on_trade(std::function<void(const TradeEvent &)> cb) {
-    on_trade_ = std::move(cb);
+  /// Quote the cost of a taker on side `taker_side` sweeping qty from the
+  /// opposite side of the book
+  SweepQuote sweep_cost(Side taker_side, Quantity qty) const {
+    return (taker_side == Side::Bid) ? asks_.sweep_cost(Side::Ask, qty)
+                                     : bids_.sweep_cost(Side::Bid, qty);
+  }
+
+  /// Release memory held by price levels that have stayed empty, when the
+  /// level container supports it. Returns the number of chunks released.
+  size_t trim_idle_levels(uint32_t min_idle_epochs) {
+    if constexpr (requires { bids_.trim_idle(min_idle_epochs); }) {
+      return bids_.trim_idle(min_idle_epochs) +
+             asks_.trim_idle(min_idle_epochs);
+    } else {
+      return 0;
+    }
+  }
+
+  /// Number of stop orders waiting for their trigger
+  size_t pending_stops() const { return stops_.size(); }
+
+  /// Last trade price, the stop trigger reference (0 before any trade)
+  Tick last_trade_px() const { return stops_.last_trade_px(); }
+
+  /// Whether any resting GTD order is waiting to expire
+  bool has_expiring_orders() const { return !expiry_wheel_.empty(); }
+
+  /// Cancel every resting GTD order whose expiry is at or before now.
+  /// Expired orders are reported like cancels. Returns the number expired.
+  size_t expire_orders(Timestamp now);
+
+  /// Emit one trade per level a taker matches at, with the level's filled
+  /// qty and maker_id INVALID_ORDER, instead of one per maker. Per-maker
+  /// fills remain available as L3 Executed events.
+  void set_aggregate_trades(bool enabled) { aggregate_trades_ = enabled; }
+
+  /// Defer book updates until flush_book_update() instead of publishing
+  /// after every command
+  void set_book_update_conflation(bool enabled) {
+    conflate_book_updates_ = enabled;
+  }
+
+  /// Publish the deferred book update, if any command ran since the last
+  /// flush and the top of book changed
+  void flush_book_update() {
+    if (bbo_pending_) {
+      bbo_pending_ = false;
+      publish_book_update();
+    }
+  }
+
+  /// Book update counters; suppressed() covers unchanged and conflated ones
+  const BookUpdateStats &book_update_stats() const { return bbo_stats_; }
+
+  /// Maintain the top `levels` aggregated levels per side (0 disables,
+  /// capped at DepthView::MAX_DEPTH). Visible changes are emitted as
+  /// DepthUpdate events.
+  void enable_depth(size_t levels);
+
+  /// Copy up to max visible depth levels of side s, best first
+  size_t depth_snapshot(Side s, DepthLevel *out, size_t max) const {
+    return (s == Side::Bid) ? bid_depth_.snapshot(out, max)
+                            : ask_depth_.snapshot(out, max);
+  }
+
+  /// Cold attributes of a resting iceberg/GTD/stop order, or nullptr
+  const OrderExtras *order_extras(OrderId id) { return extras_.find(id); }
+
+  /// Access the event sink
+  EventSink &sink() { return sink_; }
+
+  /// Set trade event callback (callback sinks only)
+  void set_on_trade(std::function<void(const TradeEvent &)> cb)
+    requires requires(EventSink &s) { s.set_on_trade(nullptr); }
+  {
+    sink_.set_on_trade(std::move(cb));
+  }
+
+  /// Set L3 order event callback (callback sinks only)
+  void set_on_order(std::function<void(const OrderEvent &)> cb)
+    requires requires(EventSink &s) { s.set_on_order(nullptr); }
+  {
+    sink_.set_on_order(std::move(cb));
+  }
+
+  /// Set depth update callback (callback sinks only)
+  void set_on_depth(std::function<void(const DepthUpdate &)> cb)
+    requires requires(EventSink &s) { s.set_on_depth(nullptr); }
+  {
+    sink_.set_on_depth(std::move(cb));
   }
 
-  /// Set book update callback
-  void set_on_book_update(std::function<void(const BookUpdate &)> cb) {
-    on_book_update_ = std::move(cb);
+  /// Set book update callback (callback sinks only)
+  void set_on_book_update(std::function<void(const BookUpdate &)> cb)
+    requires requires(EventSink &s) { s.set_on_book_update(nullptr); }
+  {
+    sink_.set_on_book_update(std::move(cb));
   }
 
 private:
@@ -95,9 +252,44 @@ private:
   };
   FlatMap<OrderId, OrderEntry> id_index_{8192};
 
-  // Event callbacks
-  std::function<void(const TradeEvent &)> on_trade_;
-  std::function<void(const BookUpdate &)> on_book_update_;
+  // Most recently rested order of each user, heading the user's list
+  static constexpr UserId NO_USER = std::numeric_limits<UserId>::max();
+  FlatMap<UserId, OrderNode *, NO_USER> user_orders_{1024};
+
+  // Cold attributes of iceberg/GTD/stop orders, see OrderExtras
+  FlatMap<OrderId, OrderExtras> extras_{1024};
+
+  // Expiry index of resting GTD orders
+  TimingWheel expiry_wheel_;
+
+  // Pending stop orders and the last trade price
+  StopBook stops_;
+  bool activating_stops_{false};
+
+  // Call auction state; the arrays are scratch for the clearing price
+  // search, kept to not allocate per auction
+  bool auction_{false};
+  std::vector<Tick> auction_px_;
+  std::vector<Quantity> auction_bids_;
+  std::vector<Quantity> auction_asks_;
+
+  // Event output
+  EventSink sink_;
+  SeqNo order_seq_{0}; // last L3 order event sequence number
+
+  // Last published top of book and conflation state
+  Tick last_bid_px_{Sentinel::EMPTY_BID};
+  Tick last_ask_px_{Sentinel::EMPTY_ASK};
+  Quantity last_bid_qty_{0};
+  Quantity last_ask_qty_{0};
+  BookUpdateStats bbo_stats_;
+  bool conflate_book_updates_{false};
+  bool aggregate_trades_{false};
+  bool bbo_pending_{false};
+
+  // Top-N L2 depth, disabled unless enable_depth() is called
+  DepthView bid_depth_{Side::Bid};
+  DepthView ask_depth_{Side::Ask};
 
 #ifdef HYPERLIQUID_PROFILING
 public:
@@ -110,41 +302,169 @@ private:
 #endif
 
   // Memory management
-  OrderNode *alloc_node() {
-    OrderNode *node = order_pool_.alloc();
-    node->alloc_kind = 1; // Pooled
-    return node;
-  }
+  OrderNode *alloc_node() { return order_pool_.alloc(); }
 
   void free_node(OrderNode *node) {
-    if (LIKELY(node->alloc_kind == 1)) {
-      order_pool_.free(node);
+    release_node(node);
+    order_pool_.free(node);
+  }
+
+  // Drop what refers to a node leaving the book, short of freeing it
+  void release_node(OrderNode *node) {
+    if (UNLIKELY(node->has_extras())) {
+      const OrderExtras *extras = extras_.find(node->id);
+      if (extras && extras->expiry_timer) {
+        expiry_wheel_.cancel(extras->expiry_timer);
+      }
+      extras_.erase(node->id);
+    }
+    unlink_user(node);
+  }
+
+  // Per-user order lists; only the head lives in user_orders_
+  void link_user(OrderNode *node) {
+    node->user_prev = nullptr;
+    node->user_next = nullptr;
+    if (UNLIKELY(node->user == NO_USER)) {
+      return; // reserved id, not tracked
+    }
+    OrderNode **head = user_orders_.find(node->user);
+    if (head) {
+      node->user_next = *head;
+      (*head)->user_prev = node;
+      *head = node;
     } else {
-      delete node; // Fallback for non-pooled nodes
+      user_orders_.insert(node->user, node);
+    }
+  }
+
+  void unlink_user(OrderNode *node) {
+    if (node->user_prev) {
+      node->user_prev->user_next = node->user_next;
+    } else if (node->user_next) {
+      *user_orders_.find(node->user) = node->user_next;
+    } else {
+      user_orders_.erase(node->user);
+    }
+    if (node->user_next) {
+      node->user_next->user_prev = node->user_prev;
     }
   }
 
   // Matching helpers (branch-minimized with templates)
   template <bool IsBid> ExecResult submit_limit_side(const OrderCommand &cmd);
 
+  // Taker qty filled, and removed by self-trade prevention
+  struct MatchResult {
+    Quantity filled{0};
+    Quantity stp_cancelled{0};
+  };
+
+  // STP policy bits of a taker, 0 when STP is off
+  static uint32_t stp_policy(uint32_t flags) {
+    return (flags & OrderFlags::STP)
+               ? flags & (OrderFlags::STP | OrderFlags::STP_MODE_MASK)
+               : 0;
+  }
+
+  template <bool IsBid>
+  MatchResult match_against_side(Quantity qty, Tick px_limit,
+                                 OrderId taker_id, UserId taker_user,
+                                 Timestamp ts, uint32_t stp);
+
+  // Cancel qty of a resting order for STP, removing it when nothing is left
+  void stp_cancel_maker(Side s, Tick px, OrderNode *maker, Quantity qty,
+                        Timestamp ts);
+
+  // Execute qty of a maker at px. True if it was an iceberg slice that
+  // refilled to the back of the level instead of leaving the book.
+  template <bool IsBid>
+  bool fill_maker(Tick px, OrderNode *maker, Quantity qty, OrderId taker_id,
+                  Timestamp ts, bool icebergs);
+
+  // fill_maker without the trade event
+  template <bool IsBid>
+  bool execute_resting(Tick px, OrderNode *node, Quantity qty, Timestamp ts,
+                       bool icebergs);
+
+  // Execute qty of the uncross's current order on one side and return the
+  // next one to fill, moving px on as levels empty
+  template <bool IsBid>
+  OrderNode *uncross_step(Tick &px, OrderNode *node, Quantity qty,
+                          Timestamp ts);
+
+  // One step of a fill plan: qty of a maker to trade, or for a self maker
+  // to cancel under STP
+  struct FillLeg {
+    OrderNode *maker;
+    Tick px;
+    Quantity qty;
+    bool self;
+  };
+
+  // Match planned up front on the stack, so an all-or-nothing order is
+  // decided before the book is touched
+  static constexpr size_t MAX_PLAN_LEGS = 64;
+  struct FillPlan {
+    MatchPreview outcome;
+    size_t size{0};
+    FillLeg legs[MAX_PLAN_LEGS];
+  };
+
+  // Walk the makers a match would reach, in match order, applying the STP
+  // policy as the match loop does but changing nothing. on_leg(leg) sees
+  // each step and returns false to stop the walk. Returns whether out is
+  // the complete outcome.
+  template <bool IsBid, typename LegFn>
+  bool walk_match(Quantity qty, Tick px_limit, UserId taker_user,
+                  uint32_t stp, MatchPreview &out, LegFn &&on_leg);
+
+  // Plan a match into plan; false if it did not fit or is not exact
+  template <bool IsBid>
+  bool plan_match(Quantity qty, Tick px_limit, UserId taker_user,
+                  uint32_t stp, FillPlan &plan);
+
+  // Apply a plan from plan_match, level by level
   template <bool IsBid>
-  Quantity match_against_side(Quantity qty, Tick px_limit, OrderId taker_id,
-                              UserId taker_user, Timestamp ts, bool enable_stp);
+  void commit_plan(const FillPlan &plan, OrderId taker_id, Timestamp ts);
+
+  // Fill a whole level at px: the level is detached in one step and its
+  // node chain spliced back into the pool. Returns the qty filled.
+  template <bool IsBid>
+  Quantity sweep_level(Tick px, OrderId taker_id, Timestamp ts);
+
+  template <bool IsBid>
+  bool check_fok_liquidity(Quantity qty, Tick px_limit, UserId user,
+                           uint32_t stp);
+
+  // Stop activation, see submit_stop
+  void activate_stops();
 
-  template <bool IsBid> bool check_fok_liquidity(Quantity qty, Tick px_limit);
+  // Refill a fully executed iceberg slice from its reserve and requeue it
+  // at the back of the level. False once the reserve is used up.
+  bool replenish_iceberg(Side s, Tick px, OrderNode *node, Timestamp ts);
 
   // Book update helpers
+  void unlink_order(Side side, Tick price, OrderNode *node, Timestamp ts);
   void refresh_best_after_depletion(Side s);
   void emit_trade(const TradeEvent &trade);
   void emit_book_update();
+  void publish_book_update();
+  void emit_order(OrderEventKind kind, Side side, OrderId id, Tick px,
+                  Quantity qty, Timestamp ts);
+
+  // Depth view helpers, ts as for emit_order
+  void touch_depth(Side s, Tick px, Timestamp ts);
+  void emit_depth(Side s, const DepthLevel &level, Timestamp ts);
 };
 
 //
 // Implementation
 //
 
-template <typename PriceLevelsImpl>
-ExecResult OrderBook<PriceLevelsImpl>::submit_limit(const OrderCommand &cmd) {
+template <typename PriceLevelsImpl, typename EventSink>
+ExecResult
+OrderBook<PriceLevelsImpl, EventSink>::submit_limit(const OrderCommand &cmd) {
   PROFILE_SCOPE_START();
   ExecResult result;
   if (cmd.side == Side::Bid) {
@@ -152,62 +472,135 @@ ExecResult OrderBook<PriceLevelsImpl>::submit_limit(const OrderCommand &cmd) {
   } else {
     result = submit_limit_side<false>(cmd);
   }
+  if (UNLIKELY(stops_.triggered())) {
+    activate_stops();
+  }
   PROFILE_SCOPE_END(latency_tracker_);
   return result;
 }
 
-template <typename PriceLevelsImpl>
-ExecResult OrderBook<PriceLevelsImpl>::submit_market(const OrderCommand &cmd) {
+template <typename PriceLevelsImpl, typename EventSink>
+ExecResult
+OrderBook<PriceLevelsImpl, EventSink>::submit_market(const OrderCommand &cmd) {
+  if (UNLIKELY(auction_)) {
+    ExecResult rejected;
+    rejected.accepted = false;
+    return rejected;
+  }
   PROFILE_SCOPE_START();
-  Quantity filled = 0;
-  bool enable_stp = (cmd.flags & OrderFlags::STP) != 0;
+  MatchResult match;
+  uint32_t stp = stp_policy(cmd.flags);
 
   if (cmd.side == Side::Bid) {
     // Market buy: match against asks at any price
-    filled =
-        match_against_side<false>(cmd.qty, Sentinel::EMPTY_ASK, cmd.order_id,
-                                  cmd.user_id, cmd.recv_ts, enable_stp);
+    match = match_against_side<false>(cmd.qty, Sentinel::EMPTY_ASK,
+                                      cmd.order_id, cmd.user_id, cmd.recv_ts,
+                                      stp);
   } else {
     // Market sell: match against bids at any price
-    filled =
-        match_against_side<true>(cmd.qty, Sentinel::EMPTY_BID, cmd.order_id,
-                                 cmd.user_id, cmd.recv_ts, enable_stp);
+    match = match_against_side<true>(cmd.qty, Sentinel::EMPTY_BID,
+                                     cmd.order_id, cmd.user_id, cmd.recv_ts,
+                                     stp);
   }
 
-  Quantity remaining = cmd.qty - filled;
+  Quantity filled = match.filled;
+  Quantity remaining = cmd.qty - filled - match.stp_cancelled;
   emit_book_update();
+  if (UNLIKELY(stops_.triggered())) {
+    activate_stops();
+  }
 
   PROFILE_SCOPE_END(latency_tracker_);
   return ExecResult{filled, remaining};
 }
 
-template <typename PriceLevelsImpl>
-bool OrderBook<PriceLevelsImpl>::cancel(OrderId id) {
+template <typename PriceLevelsImpl, typename EventSink>
+ExecResult
+OrderBook<PriceLevelsImpl, EventSink>::submit_stop(const OrderCommand &cmd) {
+  stops_.add(cmd);
+  // A stop already crossed by the last trade fires right away
+  if (stops_.triggered()) {
+    activate_stops();
+  }
+  return ExecResult{0, cmd.qty};
+}
+
+template <typename PriceLevelsImpl, typename EventSink>
+ExecResult
+OrderBook<PriceLevelsImpl, EventSink>::execute(const OrderCommand &cmd) {
+  switch (cmd.type) {
+  case CommandType::NewOrder:
+    switch (cmd.order_type) {
+    case OrderType::Limit:
+      return submit_limit(cmd);
+    case OrderType::Market:
+      return submit_market(cmd);
+    case OrderType::StopLimit:
+    case OrderType::StopMarket:
+      return submit_stop(cmd);
+    }
+    break;
+  case CommandType::CancelOrder: {
+    ExecResult result;
+    result.accepted = cancel(cmd.order_id, cmd.recv_ts);
+    return result;
+  }
+  case CommandType::ModifyOrder:
+    return modify(cmd);
+  case CommandType::MassCancel:
+    mass_cancel(cmd);
+    return ExecResult{};
+  case CommandType::EndOfStream:
+    break; // pipeline control, never reaches the book
+  }
+  ExecResult rejected;
+  rejected.accepted = false;
+  return rejected;
+}
+
+template <typename PriceLevelsImpl, typename EventSink>
+size_t OrderBook<PriceLevelsImpl, EventSink>::submit_batch(
+    std::span<const OrderCommand> cmds, std::span<ExecResult> results) {
+  // Per-command book updates only mark the BBO dirty, one publish at the
+  // end covers them all
+  bool conflating = conflate_book_updates_;
+  conflate_book_updates_ = true;
+  const size_t written = std::min(results.size(), cmds.size());
+  for (size_t i = 0; i < cmds.size(); ++i) {
+    const OrderCommand &cmd = cmds[i];
+    if (UNLIKELY(!expiry_wheel_.empty())) {
+      expire_orders(cmd.recv_ts);
+    }
+    ExecResult result = execute(cmd);
+    if (i < written) {
+      results[i] = result;
+    }
+  }
+  conflate_book_updates_ = conflating;
+  if (!conflating) {
+    flush_book_update();
+  }
+  return written;
+}
+
+template <typename PriceLevelsImpl, typename EventSink>
+bool OrderBook<PriceLevelsImpl, EventSink>::cancel(OrderId id,
+                                                   Timestamp ts) {
   PROFILE_SCOPE_START();
 
   auto *entry_ptr = id_index_.find(id);
   if (!entry_ptr) {
     PROFILE_SCOPE_END(latency_tracker_);
-    return false; // Order not found
+    // Not resting, may still wait for its stop trigger
+    return !stops_.empty() && stops_.cancel(id);
   }
 
   OrderEntry entry = *entry_ptr;
-  Side side = entry.side;
-  Tick price = entry.price;
-
-  // Get the price level
-  auto &levels = (side == Side::Bid) ? bids_ : asks_;
-  LevelFIFO &level = levels.get_level(price);
-
-  // Remove from level
-  level.erase(entry.node);
+  emit_order(OrderEventKind::Deleted, entry.side, id, entry.price,
+             entry.node->qty, ts);
+  unlink_order(entry.side, entry.price, entry.node, ts);
   free_node(entry.node);
 
-  // Update best price if level is now empty
-  if (level.empty()) {
-    refresh_best_after_depletion(side);
-  }
-
   id_index_.erase(id); // Passed by key now
   emit_book_update();
 
@@ -215,11 +608,64 @@ bool OrderBook<PriceLevelsImpl>::cancel(OrderId id) {
   return true;
 }
 
-template <typename PriceLevelsImpl>
-ExecResult OrderBook<PriceLevelsImpl>::modify(OrderId id, Tick new_price,
-                                              Quantity new_qty) {
+template <typename PriceLevelsImpl, typename EventSink>
+size_t OrderBook<PriceLevelsImpl, EventSink>::mass_cancel(
+    UserId user, const MassCancelFilter &filter, Timestamp ts) {
   PROFILE_SCOPE_START();
 
+  OrderNode **head = user_orders_.find(user);
+  OrderNode *node = head ? *head : nullptr;
+  size_t cancelled = 0;
+  while (node) {
+    // free_node unlinks the node, so step first
+    OrderNode *next = node->user_next;
+    OrderEntry entry = *id_index_.find(node->id);
+    if (filter.matches(entry.side, entry.price)) {
+      emit_order(OrderEventKind::Deleted, entry.side, node->id, entry.price,
+                 node->qty, ts);
+      unlink_order(entry.side, entry.price, node, ts);
+      id_index_.erase(node->id);
+      free_node(node);
+      ++cancelled;
+    }
+    node = next;
+  }
+
+  // One update for the whole batch; stops are not on the book
+  if (cancelled > 0) {
+    emit_book_update();
+  }
+  if (UNLIKELY(!stops_.empty())) {
+    cancelled += stops_.cancel_user(user, filter);
+  }
+
+  PROFILE_SCOPE_END(latency_tracker_);
+  return cancelled;
+}
+
+template <typename PriceLevelsImpl, typename EventSink>
+ExecResult OrderBook<PriceLevelsImpl, EventSink>::modify(OrderId id,
+                                                         Tick new_price,
+                                                         Quantity new_qty) {
+  OrderCommand cmd{};
+  cmd.type = CommandType::ModifyOrder;
+  cmd.recv_ts = TimestampUtil::now_ns();
+  cmd.order_id = id;
+  cmd.price_ticks = new_price;
+  cmd.qty = new_qty;
+  return modify(cmd);
+}
+
+template <typename PriceLevelsImpl, typename EventSink>
+ExecResult
+OrderBook<PriceLevelsImpl, EventSink>::modify(const OrderCommand &cmd) {
+  PROFILE_SCOPE_START();
+
+  OrderId id = cmd.order_id;
+  Tick new_price = cmd.price_ticks;
+  Quantity new_qty = cmd.qty;
+
+  // The only index lookup unless the order trades on the way
   auto *entry_ptr = id_index_.find(id);
   if (!entry_ptr) {
     PROFILE_SCOPE_END(latency_tracker_);
@@ -227,114 +673,180 @@ ExecResult OrderBook<PriceLevelsImpl>::modify(OrderId id, Tick new_price,
   }
 
   OrderEntry entry = *entry_ptr;
+  OrderNode *node = entry.node;
+  Side side = entry.side;
+  auto &levels = (side == Side::Bid) ? bids_ : asks_;
+
+  // Case 0: Nothing left to rest, same as a cancel
+  if (new_qty <= 0) {
+    emit_order(OrderEventKind::Deleted, side, id, entry.price, node->qty,
+               cmd.recv_ts);
+    unlink_order(side, entry.price, node, cmd.recv_ts);
+    free_node(node);
+    id_index_.erase(id);
+    emit_book_update();
+    PROFILE_SCOPE_END(latency_tracker_);
+    return ExecResult{0, 0};
+  }
 
   // Case 1: In-place resize (Partial cancel)
   // Logic: new_qty < current_qty AND same price
   // We preserve priority by just reducing the quantity on the node
-  if (new_price == entry.price && new_qty < entry.node->qty) {
-    Side side = entry.side;
-    auto &levels = (side == Side::Bid) ? bids_ : asks_;
-    LevelFIFO &level = levels.get_level(entry.price);
-
-    // Calculate reduction
-    // entry.node->qty is the current open quantity
-    // new_qty is the desired new quantity
-    Quantity diff = entry.node->qty - new_qty;
-
-    // LevelFIFO::reduce_qty reduces the node's qty and the level's total_qty
-    level.reduce_qty(entry.node, diff);
-
-    // Emit update to reflect size change
+  // Icebergs take Case 2 so the new qty is split into slice and reserve
+  if (new_price == entry.price && new_qty < node->qty &&
+      !node->is_iceberg()) {
+    Quantity diff = node->qty - new_qty;
+    levels.reduce_qty(entry.price, node, diff);
+    emit_order(OrderEventKind::Reduced, side, id, entry.price, diff,
+               cmd.recv_ts);
+    touch_depth(side, entry.price, cmd.recv_ts);
     emit_book_update();
-
     PROFILE_SCOPE_END(latency_tracker_);
     // Return 0 filled, and the new open quantity as remaining
     return ExecResult{0, new_qty};
   }
 
-  // Case 2: Full Cancel and Replace
-  // Logic: Price changed OR Quantity increased
-  // Priority is lost. We treat this as a new order.
+  // Case 2: Requeue (price changed or quantity increased)
+  // Priority is lost. The node moves to the back of its new level without
+  // going back through the pool, and keeps its index slot and extras.
+  unlink_order(side, entry.price, node, cmd.recv_ts);
+
+  // A move across the spread trades first, as a new order would
+  bool crosses = false;
+  if (UNLIKELY(auction_)) {
+    // Rests crossed until the uncross
+  } else if (side == Side::Bid) {
+    crosses = asks_.best_ask() != Sentinel::EMPTY_ASK &&
+              asks_.best_ask() <= new_price;
+  } else {
+    crosses = bids_.best_bid() != Sentinel::EMPTY_BID &&
+              bids_.best_bid() >= new_price;
+  }
+  Quantity filled = 0;
+  if (UNLIKELY(crosses)) {
+    emit_order(OrderEventKind::Deleted, side, id, entry.price, node->qty,
+               cmd.recv_ts);
+    uint32_t stp = stp_policy(node->flags);
+    MatchResult match;
+    if (side == Side::Bid) {
+      match = match_against_side<false>(new_qty, new_price, id, node->user,
+                                        cmd.recv_ts, stp);
+    } else {
+      match = match_against_side<true>(new_qty, new_price, id, node->user,
+                                       cmd.recv_ts, stp);
+    }
+    filled = match.filled;
+    new_qty -= match.stp_cancelled;
+    // Fills erase other orders, which may shift index slots
+    entry_ptr = id_index_.find(id);
+  }
 
-  // Capture order details before cancelling (as cancel frees the node)
-  UserId user = entry.node->user;
-  uint32_t flags = entry.node->flags;
-  Side side = entry.side;
-  // We effectively treat it as a new order arriving "now"
-  uint64_t now = TimestampUtil::now_ns();
-
-  // Perform atomic cancel
-  // Note: calling cancel(id) will look up id_index_ again.
-  // We could optimize by having an internal cancel_by_entry, but reusing
-  // cancel(id) is safer/DRY.
-  if (!cancel(id)) {
-    // Should rare/impossible since we found it above, unless concurrent
-    // modification happened (not thread safe class)
-    PROFILE_SCOPE_END(latency_tracker_);
-    return ExecResult{0, 0};
+  Quantity remaining = new_qty - filled;
+  if (remaining > 0) {
+    Quantity visible = remaining;
+    if (node->is_iceberg()) {
+      // Resplit into display slice and reserve
+      OrderExtras *extras = extras_.find(id);
+      visible = std::min(remaining, extras->display_qty);
+      extras->hidden_qty = remaining - visible;
+    }
+    node->qty = visible;
+    node->ts = cmd.recv_ts;
+    levels.enqueue(new_price, node);
+    emit_order(crosses ? OrderEventKind::Added : OrderEventKind::Replaced,
+               side, id, new_price, visible, cmd.recv_ts);
+    touch_depth(side, new_price, cmd.recv_ts);
+
+    // Update best price if needed
+    if (side == Side::Bid) {
+      if (new_price > bids_.best_bid()) {
+        bids_.set_best_bid(new_price);
+      }
+    } else {
+      if (new_price < asks_.best_ask()) {
+        asks_.set_best_ask(new_price);
+      }
+    }
+    entry_ptr->price = new_price;
+  } else {
+    // Filled completely on the way
+    id_index_.erase(id);
+    free_node(node);
   }
 
-  // Construct new command
-  OrderCommand new_cmd;
-  new_cmd.type = CommandType::NewOrder;
-  new_cmd.order_id =
-      id; // Reuse same ID as this is a modification of the same order
-  new_cmd.user_id = user;
-  new_cmd.price_ticks = new_price;
-  new_cmd.qty = new_qty;
-  new_cmd.side = side;
-  new_cmd.order_type = OrderType::Limit;
-  new_cmd.tif = TimeInForce::GTC; // Resting orders are GTC (IOC/FOK don't rest)
-  new_cmd.recv_ts = now;
-  new_cmd.flags = flags;
-
-  // Submit new order
-  // This will handle matching if the new price crosses the book, or resting if
-  // not.
-  ExecResult res = submit_limit(new_cmd);
+  emit_book_update();
+  if (UNLIKELY(stops_.triggered())) {
+    activate_stops();
+  }
 
   PROFILE_SCOPE_END(latency_tracker_);
-  return res;
+  return ExecResult{filled, remaining};
 }
 
-template <typename PriceLevelsImpl>
+template <typename PriceLevelsImpl, typename EventSink>
 template <bool IsBid>
-ExecResult
-OrderBook<PriceLevelsImpl>::submit_limit_side(const OrderCommand &cmd) {
+ExecResult OrderBook<PriceLevelsImpl, EventSink>::submit_limit_side(
+    const OrderCommand &cmd) {
   constexpr Side taker_side = IsBid ? Side::Bid : Side::Ask;
   Quantity filled = 0;
   Quantity remaining = cmd.qty;
-  bool enable_stp = (cmd.flags & OrderFlags::STP) != 0;
+  uint32_t stp = stp_policy(cmd.flags);
 
-  // Handle time-in-force FOK check
+  if (UNLIKELY(auction_) && (cmd.tif == TimeInForce::IOC ||
+                             cmd.tif == TimeInForce::FOK)) {
+    ExecResult rejected;
+    rejected.accepted = false;
+    return rejected;
+  }
+
+  // Fill-or-kill: plan the whole match first and commit it only if it
+  // fills. STP may resolve own orders by decrementing, but a taker it
+  // cancels is not filled.
   if (cmd.tif == TimeInForce::FOK) {
-    // Check if we can fill fully
-    bool can_fill = check_fok_liquidity<IsBid>(cmd.qty, cmd.price_ticks);
-    if (!can_fill) {
-      // Cannot fill fully -> Kill
-      // Do not match, do not add to book.
+    FillPlan plan;
+    if (plan_match<!IsBid>(cmd.qty, cmd.price_ticks, cmd.user_id, stp,
+                           plan)) {
+      const MatchPreview &out = plan.outcome;
+      bool fills = out.filled + out.stp_cancelled == cmd.qty &&
+                   (out.stp_cancelled == 0 ||
+                    (stp & OrderFlags::STP_MODE_MASK) ==
+                        OrderFlags::STP_DECREMENT);
+      if (fills) {
+        commit_plan<!IsBid>(plan, cmd.order_id, cmd.recv_ts);
+      }
+      emit_book_update();
+      return ExecResult{fills ? out.filled : 0, 0};
+    }
+    // Too many makers for one plan, check first and then match
+    if (!check_fok_liquidity<IsBid>(cmd.qty, cmd.price_ticks, cmd.user_id,
+                                    stp)) {
       emit_book_update();
       return ExecResult{0, 0};
     }
-    // If can fill, proceed to match (which will drain the required liquidity)
   }
 
   // Match against opposite side
   if constexpr (IsBid) {
     // Buy order: match against asks if ask price <= our bid price
     Tick best_ask = asks_.best_ask();
-    if (best_ask != Sentinel::EMPTY_ASK && best_ask <= cmd.price_ticks) {
-      filled = match_against_side<false>(cmd.qty, cmd.price_ticks, cmd.order_id,
-                                         cmd.user_id, cmd.recv_ts, enable_stp);
-      remaining = cmd.qty - filled;
+    if (best_ask != Sentinel::EMPTY_ASK && best_ask <= cmd.price_ticks &&
+        LIKELY(!auction_)) {
+      MatchResult match =
+          match_against_side<false>(cmd.qty, cmd.price_ticks, cmd.order_id,
+                                    cmd.user_id, cmd.recv_ts, stp);
+      filled = match.filled;
+      remaining = cmd.qty - filled - match.stp_cancelled;
     }
   } else {
     // Sell order: match against bids if bid price >= our ask price
     Tick best_bid = bids_.best_bid();
-    if (best_bid != Sentinel::EMPTY_BID && best_bid >= cmd.price_ticks) {
-      filled = match_against_side<true>(cmd.qty, cmd.price_ticks, cmd.order_id,
-                                        cmd.user_id, cmd.recv_ts, enable_stp);
-      remaining = cmd.qty - filled;
+    if (best_bid != Sentinel::EMPTY_BID && best_bid >= cmd.price_ticks &&
+        LIKELY(!auction_)) {
+      MatchResult match =
+          match_against_side<true>(cmd.qty, cmd.price_ticks, cmd.order_id,
+                                   cmd.user_id, cmd.recv_ts, stp);
+      filled = match.filled;
+      remaining = cmd.qty - filled - match.stp_cancelled;
     }
   }
 
@@ -345,42 +857,52 @@ OrderBook<PriceLevelsImpl>::submit_limit_side(const OrderCommand &cmd) {
       emit_book_update();
       return ExecResult{filled, 0};
     } else if (cmd.tif == TimeInForce::FOK) {
-      // Should not happen if FOK logic above is correct,
-      // unless liquidity disappeared concurrently (impossible in single thread)
-      // or check was imperfect.
-      // But since we checked, we assume filled == qty if we reached here with
-      // remaining == 0 If remaining > 0 here for FOK, it means we FAILED to
-      // fill even though we thought we could? Or we are in the "remaining"
-      // block, which means we didn't match everything.
-
-      // If we are here and FOK, it means partial fill occurred?
-      // No, match_against_side consumes liquidity.
-      // If check_fok_liquidity passed, match_against_side SHOULD have filled
-      // everything unless STP prevented it? Ah, STP! If STP triggered, we might
-      // have skipped orders. So check_fok_liquidity doesn't account for STP
-      // (user check).
-
-      // If we are here with remaining > 0, it's a busted FOK.
-      // We really should ideally rollback.
-      // But for MVP, we just kill the remainder.
-      // The fills that happened... we can't easily undo.
-      // This is a known limitation if STP interacts with FOK.
+      // Not reached: the FOK check above accounts for STP as the match
+      // loop applies it. Never rest a FOK remainder regardless.
       emit_book_update();
       return ExecResult{filled, 0};
     }
 
     // GTC: rest in book
     auto &levels = IsBid ? bids_ : asks_;
-    LevelFIFO &level = levels.get_level(cmd.price_ticks);
 
     OrderNode *node = alloc_node();
     node->id = cmd.order_id;
     node->user = cmd.user_id;
     node->qty = remaining;
     node->ts = cmd.recv_ts;
-    node->flags = cmd.flags;
+    node->flags = cmd.flags & ~NodeFlags::HAS_EXTRAS;
+
+    // Advanced-order attributes go to the side table, off the hot node
+    bool cold = (cmd.flags & (OrderFlags::ICEBERG | OrderFlags::STOP)) != 0 ||
+                cmd.tif == TimeInForce::GTD;
+    if (UNLIKELY(cold)) {
+      OrderExtras extras;
+      extras.display_qty = cmd.display_qty;
+      extras.expiry_ts = cmd.expiry_ts;
+      extras.stop_price = cmd.stop_price;
+      if (node->is_iceberg()) {
+        if (cmd.display_qty > 0 && cmd.display_qty < remaining) {
+          // Only the display slice rests visibly, the rest is held back
+          node->qty = cmd.display_qty;
+          extras.hidden_qty = remaining - cmd.display_qty;
+        } else {
+          node->flags &= ~OrderFlags::ICEBERG; // nothing to hide
+        }
+      }
+      if (cmd.tif == TimeInForce::GTD && cmd.expiry_ts != 0) {
+        extras.expiry_timer =
+            expiry_wheel_.schedule(cmd.order_id, cmd.expiry_ts, cmd.recv_ts);
+      }
+      extras_.insert(cmd.order_id, extras);
+      node->flags |= NodeFlags::HAS_EXTRAS;
+    }
 
-    level.enqueue(node);
+    levels.enqueue(cmd.price_ticks, node);
+    link_user(node);
+    emit_order(OrderEventKind::Added, taker_side, cmd.order_id,
+               cmd.price_ticks, node->qty, cmd.recv_ts);
+    touch_depth(taker_side, cmd.price_ticks, cmd.recv_ts);
 
     // Update best price if needed
     if constexpr (IsBid) {
@@ -402,12 +924,14 @@ OrderBook<PriceLevelsImpl>::submit_limit_side(const OrderCommand &cmd) {
   return ExecResult{filled, remaining};
 }
 
-template <typename PriceLevelsImpl>
+template <typename PriceLevelsImpl, typename EventSink>
 template <bool IsBid>
-Quantity OrderBook<PriceLevelsImpl>::match_against_side(
+typename OrderBook<PriceLevelsImpl, EventSink>::MatchResult
+OrderBook<PriceLevelsImpl, EventSink>::match_against_side(
     Quantity qty, Tick px_limit, OrderId taker_id, UserId taker_user,
-    Timestamp ts, bool enable_stp) {
+    Timestamp ts, uint32_t stp) {
   Quantity total_filled = 0;
+  Quantity stp_cancelled = 0;
   auto &levels = IsBid ? bids_ : asks_;
 
   while (qty > 0) {
@@ -428,199 +952,669 @@ Quantity OrderBook<PriceLevelsImpl>::match_against_side(
         break; // No more matches for buy taker
     }
 
-    // Match orders at this level
-    OrderNode *maker = best_level->head;
+    // Refills only happen on iceberg levels. Read before a sweep, which
+    // removes the level and may move or free what best_level points to.
+    bool icebergs = best_level->icebergs != 0;
+    Quantity level_filled = 0;
+    if (qty >= best_level->total_qty && !stp && !icebergs) {
+      // The taker clears the level, take it whole
+      level_filled = sweep_level<IsBid>(best_price, taker_id, ts);
+      qty -= level_filled;
+      total_filled += level_filled;
+    }
+
+    // Match orders at this level, unless it was swept
+    OrderNode *maker = level_filled ? nullptr : best_level->head;
     while (maker && qty > 0) {
       if (maker->next) {
         __builtin_prefetch(maker->next, 0, 1);
       }
 
-      // Self-trade prevention
-      if (enable_stp && maker->user == taker_user) {
-        maker = maker->next;
+      // Self-trade prevention. Each policy removes the resting order or
+      // stops the taker, so a self-match is O(1) and no maker is walked
+      // over again by later takers.
+      if (UNLIKELY(stp) && maker->user == taker_user) {
+        uint32_t mode = stp & OrderFlags::STP_MODE_MASK;
+        if (mode == OrderFlags::STP_CANCEL_NEWEST) {
+          stp_cancelled += qty;
+          qty = 0;
+          break;
+        }
+        OrderNode *next_maker = maker->next;
+        Quantity cut = maker->qty;
+        if (mode == OrderFlags::STP_DECREMENT) {
+          cut = std::min(qty, maker->qty);
+          qty -= cut;
+          stp_cancelled += cut;
+        } else if (mode == OrderFlags::STP_CANCEL_BOTH) {
+          stp_cancelled += qty;
+          qty = 0;
+        }
+        stp_cancel_maker(IsBid ? Side::Bid : Side::Ask, best_price, maker, cut,
+                         ts);
+        maker = next_maker;
         continue;
       }
 
       Quantity match_qty = std::min(qty, maker->qty);
-
-      // Generate trade event
-      if (on_trade_) {
-        TradeEvent trade{ts,         taker_id,   maker->id,
-                         symbol_id_, best_price, match_qty};
-        emit_trade(trade);
-      }
-
       qty -= match_qty;
       total_filled += match_qty;
+      level_filled += match_qty;
 
       OrderNode *next_maker = maker->next;
-
-      if (match_qty >= maker->qty) {
-        // Maker fully filled
-        best_level->erase(maker);
-        id_index_.erase(maker->id);
-        free_node(maker);
-      } else {
-        // Partial fill
-        best_level->reduce_qty(maker, match_qty);
+      if (fill_maker<IsBid>(best_price, maker, match_qty, taker_id, ts,
+                            icebergs)) {
+        // Refilled slice is now at the back; reach it if nothing else
+        // is left on the level
+        maker = next_maker ? next_maker : maker;
+        continue;
       }
-
       maker = next_maker;
     }
+    if (level_filled > 0) {
+      if (aggregate_trades_ && sink_.wants_trades()) {
+        TradeEvent trade{ts,         taker_id,   Sentinel::INVALID_ORDER,
+                         symbol_id_, best_price, level_filled};
+        emit_trade(trade);
+      }
+      stops_.on_trade(best_price, ts);
+    }
+    touch_depth(IsBid ? Side::Bid : Side::Ask, best_price, ts);
 
     // If level is depleted, find next best
-    if (best_level->empty()) {
+    if (!levels.has_level(best_price)) {
       refresh_best_after_depletion(IsBid ? Side::Bid : Side::Ask);
     } else {
       break; // Still have orders at this level
     }
   }
 
-  return total_filled;
+  return MatchResult{total_filled, stp_cancelled};
 }
 
-template <typename PriceLevelsImpl>
-void OrderBook<PriceLevelsImpl>::refresh_best_after_depletion(Side s) {
-  if (s == Side::Bid) {
-    Tick current_best = bids_.best_bid();
-    if (current_best == Sentinel::EMPTY_BID)
-      return;
+template <typename PriceLevelsImpl, typename EventSink>
+template <bool IsBid>
+bool OrderBook<PriceLevelsImpl, EventSink>::fill_maker(Tick px,
+                                                       OrderNode *maker,
+                                                       Quantity qty,
+                                                       OrderId taker_id,
+                                                       Timestamp ts,
+                                                       bool icebergs) {
+  // Generate trade event
+  if (sink_.wants_trades() && !aggregate_trades_) {
+    TradeEvent trade{ts, taker_id, maker->id, symbol_id_, px, qty};
+    emit_trade(trade);
+  }
+  return execute_resting<IsBid>(px, maker, qty, ts, icebergs);
+}
+
+template <typename PriceLevelsImpl, typename EventSink>
+template <bool IsBid>
+bool OrderBook<PriceLevelsImpl, EventSink>::execute_resting(
+    Tick px, OrderNode *node, Quantity qty, Timestamp ts, bool icebergs) {
+  constexpr Side s = IsBid ? Side::Bid : Side::Ask;
+  auto &levels = IsBid ? bids_ : asks_;
+  emit_order(OrderEventKind::Executed, s, node->id, px, qty, ts);
+
+  if (qty < node->qty) {
+    // Partial fill
+    levels.reduce_qty(px, node, qty);
+    return false;
+  }
+  if (UNLIKELY(icebergs) && node->is_iceberg() &&
+      replenish_iceberg(s, px, node, ts)) {
+    return true;
+  }
+  // Fully filled
+  levels.erase(px, node);
+  id_index_.erase(node->id);
+  free_node(node);
+  return false;
+}
+
+template <typename PriceLevelsImpl, typename EventSink>
+AuctionResult OrderBook<PriceLevelsImpl, EventSink>::indicative_uncross() {
+  auction_px_.clear();
+  auction_bids_.clear();
+  auction_asks_.clear();
+  Tick lo = asks_.best_ask();
+  Tick hi = bids_.best_bid();
+  if (lo == Sentinel::EMPTY_ASK || hi == Sentinel::EMPTY_BID || hi < lo) {
+    return AuctionResult{};
+  }
+  // Merge the ask and bid levels in [lo, hi] into ascending price order;
+  // find_next_ask on the bid side steps to the next higher bid level
+  Tick a = lo;
+  Tick b = bids_.find_next_ask(lo - 1);
+  while (a <= hi || b <= hi) {
+    Tick px = std::min(a, b);
+    auction_px_.push_back(px);
+    auction_bids_.push_back(b == px ? bids_.get_level(px).total_qty : 0);
+    auction_asks_.push_back(a == px ? asks_.get_level(px).total_qty : 0);
+    if (a == px) {
+      a = asks_.find_next_ask(a);
+    }
+    if (b == px) {
+      b = bids_.find_next_ask(b);
+    }
+  }
+  return find_clearing_price(auction_px_.data(), auction_bids_.data(),
+                             auction_asks_.data(), auction_px_.size());
+}
+
+template <typename PriceLevelsImpl, typename EventSink>
+AuctionResult OrderBook<PriceLevelsImpl, EventSink>::uncross(Timestamp ts) {
+  if (ts == 0) {
+    ts = TimestampUtil::now_ns();
+  }
+  AuctionResult result = indicative_uncross();
+  auction_ = false;
+  if (result.volume == 0) {
+    emit_book_update();
+    return result;
+  }
+
+  // Pair bids and asks off both queues, best first, all at one price
+  Tick bid_px = bids_.best_bid();
+  Tick ask_px = asks_.best_ask();
+  OrderNode *bid = bids_.get_level(bid_px).head;
+  OrderNode *ask = asks_.get_level(ask_px).head;
+  Quantity left = result.volume;
+  while (left > 0) {
+    Quantity qty = std::min(left, std::min(bid->qty, ask->qty));
+    if (sink_.wants_trades() && !aggregate_trades_) {
+      TradeEvent trade{ts,        bid->id,      ask->id,
+                       symbol_id_, result.price, qty};
+      emit_trade(trade);
+    }
+    left -= qty;
+    bid = uncross_step<true>(bid_px, bid, qty, ts);
+    ask = uncross_step<false>(ask_px, ask, qty, ts);
+  }
+  if (aggregate_trades_ && sink_.wants_trades()) {
+    TradeEvent trade{ts,         Sentinel::INVALID_ORDER,
+                     Sentinel::INVALID_ORDER, symbol_id_,
+                     result.price, result.volume};
+    emit_trade(trade);
+  }
+  // The last level of each side may be left partly filled
+  if (bid) {
+    touch_depth(Side::Bid, bid_px, ts);
+  }
+  if (ask) {
+    touch_depth(Side::Ask, ask_px, ts);
+  }
+  stops_.on_trade(result.price, ts);
+  emit_book_update();
+  if (UNLIKELY(stops_.triggered())) {
+    activate_stops();
+  }
+  return result;
+}
+
+template <typename PriceLevelsImpl, typename EventSink>
+template <bool IsBid>
+OrderNode *OrderBook<PriceLevelsImpl, EventSink>::uncross_step(
+    Tick &px, OrderNode *node, Quantity qty, Timestamp ts) {
+  constexpr Side s = IsBid ? Side::Bid : Side::Ask;
+  auto &levels = IsBid ? bids_ : asks_;
+  bool partial = qty < node->qty;
+  bool icebergs = levels.get_level(px).icebergs != 0;
+  OrderNode *next = node->next;
+  bool refilled = execute_resting<IsBid>(px, node, qty, ts, icebergs);
+  if (partial) {
+    return node;
+  }
+  if (refilled) {
+    return next ? next : node;
+  }
+  if (next) {
+    return next;
+  }
+  // The level emptied; it was the best of its side
+  touch_depth(s, px, ts);
+  refresh_best_after_depletion(s);
+  px = IsBid ? levels.best_bid() : levels.best_ask();
+  bool none = px == (IsBid ? Sentinel::EMPTY_BID : Sentinel::EMPTY_ASK);
+  return none ? nullptr : levels.get_level(px).head;
+}
 
-    // Search downward for next best bid
-    // Limit search to avoid extremely long iterations
-    constexpr int MAX_SEARCH = 10000;
-    for (int i = 1; i <= MAX_SEARCH; ++i) {
-      Tick px = current_best - i;
-      if (px <= Sentinel::EMPTY_BID) {
-        break;
+template <typename PriceLevelsImpl, typename EventSink>
+template <bool IsBid, typename LegFn>
+bool OrderBook<PriceLevelsImpl, EventSink>::walk_match(
+    Quantity qty, Tick px_limit, UserId taker_user, uint32_t stp,
+    MatchPreview &out, LegFn &&on_leg) {
+  auto &levels = IsBid ? bids_ : asks_;
+  uint32_t mode = stp & OrderFlags::STP_MODE_MASK;
+  Tick px = IsBid ? levels.best_bid() : levels.best_ask();
+  while (qty > 0 && (IsBid ? px != Sentinel::EMPTY_BID && px >= px_limit
+                           : px != Sentinel::EMPTY_ASK && px <= px_limit)) {
+    const LevelFIFO &level = levels.get_level(px);
+    for (OrderNode *maker = level.head; maker && qty > 0;
+         maker = maker->next) {
+      if (maker->next) {
+        __builtin_prefetch(maker->next, 0, 1);
       }
-      // Check bounds BEFORE calling has_level to avoid assertion
-      if (!bids_.is_valid_price(px)) {
-        break;
+      if (UNLIKELY(stp) && maker->user == taker_user) {
+        if (mode == OrderFlags::STP_CANCEL_NEWEST) {
+          out.stp_cancelled += qty;
+          return true;
+        }
+        Quantity cut = mode == OrderFlags::STP_DECREMENT
+                           ? std::min(qty, maker->qty)
+                           : maker->qty;
+        if (!on_leg(FillLeg{maker, px, cut, true})) {
+          return false;
+        }
+        Quantity taker_cut = mode == OrderFlags::STP_DECREMENT ? cut
+                             : mode == OrderFlags::STP_CANCEL_BOTH ? qty
+                                                                   : 0;
+        qty -= taker_cut;
+        out.stp_cancelled += taker_cut;
+        continue;
       }
-      if (bids_.has_level(px)) {
-        bids_.set_best_bid(px);
-        return;
+      Quantity n = std::min(qty, maker->qty);
+      if (!on_leg(FillLeg{maker, px, n, false})) {
+        return false;
       }
+      qty -= n;
+      out.filled += n;
+      out.notional += n * px;
+      out.last_px = px;
+      ++out.makers;
     }
-    // No levels found - book is empty
-    bids_.set_best_bid(Sentinel::EMPTY_BID);
-  } else {
-    Tick current_best = asks_.best_ask();
-    if (current_best == Sentinel::EMPTY_ASK)
-      return;
+    // Iceberg refills rejoin behind the makers walked, out of sight
+    if (qty > 0 && level.icebergs != 0) {
+      return false;
+    }
+    px = IsBid ? levels.find_next_bid(px) : levels.find_next_ask(px);
+  }
+  return true;
+}
 
-    // Search upward for next best ask
-    constexpr int MAX_SEARCH = 10000;
-    for (int i = 1; i <= MAX_SEARCH; ++i) {
-      Tick px = current_best + i;
-      if (px >= Sentinel::EMPTY_ASK) {
-        // Reached top of search
-        break;
+template <typename PriceLevelsImpl, typename EventSink>
+template <bool IsBid>
+bool OrderBook<PriceLevelsImpl, EventSink>::plan_match(Quantity qty,
+                                                       Tick px_limit,
+                                                       UserId taker_user,
+                                                       uint32_t stp,
+                                                       FillPlan &plan) {
+  return walk_match<IsBid>(qty, px_limit, taker_user, stp, plan.outcome,
+                           [&plan](const FillLeg &leg) {
+                             if (plan.size == MAX_PLAN_LEGS) {
+                               return false;
+                             }
+                             plan.legs[plan.size++] = leg;
+                             return true;
+                           });
+}
+
+template <typename PriceLevelsImpl, typename EventSink>
+template <bool IsBid>
+void OrderBook<PriceLevelsImpl, EventSink>::commit_plan(const FillPlan &plan,
+                                                        OrderId taker_id,
+                                                        Timestamp ts) {
+  constexpr Side s = IsBid ? Side::Bid : Side::Ask;
+  auto &levels = IsBid ? bids_ : asks_;
+  size_t i = 0;
+  while (i < plan.size) {
+    Tick px = plan.legs[i].px;
+    bool icebergs = levels.get_level(px).icebergs != 0;
+    Quantity level_filled = 0;
+    for (; i < plan.size && plan.legs[i].px == px; ++i) {
+      const FillLeg &leg = plan.legs[i];
+      if (i + 1 < plan.size) {
+        __builtin_prefetch(plan.legs[i + 1].maker, 1, 1);
       }
-      // Check bounds BEFORE calling has_level to avoid assertion
-      if (!asks_.is_valid_price(px)) {
-        break;
+      if (UNLIKELY(leg.self)) {
+        stp_cancel_maker(s, px, leg.maker, leg.qty, ts);
+        continue;
       }
-      if (asks_.has_level(px)) {
-        asks_.set_best_ask(px);
-        return;
+      fill_maker<IsBid>(px, leg.maker, leg.qty, taker_id, ts, icebergs);
+      level_filled += leg.qty;
+    }
+    if (level_filled > 0) {
+      if (aggregate_trades_ && sink_.wants_trades()) {
+        TradeEvent trade{ts, taker_id, Sentinel::INVALID_ORDER,
+                         symbol_id_, px, level_filled};
+        emit_trade(trade);
       }
+      stops_.on_trade(px, ts);
     }
-    // No levels found - book is empty
-    asks_.set_best_ask(Sentinel::EMPTY_ASK);
+    touch_depth(s, px, ts);
+    if (!levels.has_level(px)) {
+      refresh_best_after_depletion(s);
+    }
+  }
+}
+
+template <typename PriceLevelsImpl, typename EventSink>
+MatchPreview
+OrderBook<PriceLevelsImpl, EventSink>::preview_match(const OrderCommand &cmd) {
+  bool market = cmd.order_type == OrderType::Market;
+  uint32_t stp = stp_policy(cmd.flags);
+  auto any = [](const FillLeg &) { return true; };
+  MatchPreview out;
+  if (cmd.side == Side::Bid) {
+    out.exact = walk_match<false>(
+        cmd.qty, market ? Sentinel::EMPTY_ASK : cmd.price_ticks, cmd.user_id,
+        stp, out, any);
+  } else {
+    out.exact = walk_match<true>(
+        cmd.qty, market ? Sentinel::EMPTY_BID : cmd.price_ticks, cmd.user_id,
+        stp, out, any);
   }
+  return out;
 }
 
-template <typename PriceLevelsImpl>
+template <typename PriceLevelsImpl, typename EventSink>
+void OrderBook<PriceLevelsImpl, EventSink>::stp_cancel_maker(
+    Side s, Tick px, OrderNode *maker, Quantity qty, Timestamp ts) {
+  auto &levels = (s == Side::Bid) ? bids_ : asks_;
+  if (qty < maker->qty) {
+    levels.reduce_qty(px, maker, qty);
+    emit_order(OrderEventKind::Reduced, s, maker->id, px, qty, ts);
+    return;
+  }
+  // The whole order goes, including any iceberg reserve
+  emit_order(OrderEventKind::Deleted, s, maker->id, px, maker->qty, ts);
+  levels.erase(px, maker);
+  id_index_.erase(maker->id);
+  free_node(maker);
+}
+
+template <typename PriceLevelsImpl, typename EventSink>
 template <bool IsBid>
-bool OrderBook<PriceLevelsImpl>::check_fok_liquidity(Quantity qty,
-                                                     Tick px_limit) {
-  // If I am Bid, I match against Asks.
-  // auto &levels = IsBid ? asks_ : bids_;
+Quantity OrderBook<PriceLevelsImpl, EventSink>::sweep_level(Tick px,
+                                                            OrderId taker_id,
+                                                            Timestamp ts) {
+  static_assert(offsetof(OrderNode, next) == 0,
+                "level chains are handed to the pool as free lists");
+  auto &levels = IsBid ? bids_ : asks_;
+  LevelFIFO fifo = levels.take_level(px);
 
-  Tick best_price = IsBid ? asks_.best_ask() : bids_.best_bid();
+  // Per maker only what has to name it: events, the index, side tables
+  for (OrderNode *maker = fifo.head; maker; maker = maker->next) {
+    if (sink_.wants_trades() && !aggregate_trades_) {
+      TradeEvent trade{ts, taker_id, maker->id, symbol_id_, px, maker->qty};
+      emit_trade(trade);
+    }
+    emit_order(OrderEventKind::Executed, IsBid ? Side::Bid : Side::Ask,
+               maker->id, px, maker->qty, ts);
+    id_index_.erase(maker->id);
+    release_node(maker);
+  }
+  order_pool_.free_chain(fifo.head, fifo.tail, fifo.count);
+  return fifo.total_qty;
+}
 
-  if (IsBid) {
-    if (best_price == Sentinel::EMPTY_ASK)
-      return false;
-    if (best_price > px_limit)
-      return false;
-  } else {
-    if (best_price == Sentinel::EMPTY_BID)
-      return false;
-    if (best_price < px_limit)
-      return false;
+template <typename PriceLevelsImpl, typename EventSink>
+void OrderBook<PriceLevelsImpl, EventSink>::activate_stops() {
+  // Orders entered here trade and move the last price in turn; the outer
+  // call keeps popping until the price stops reaching new stops, so a
+  // cascade is one heap pop per activated stop
+  if (activating_stops_) {
+    return;
+  }
+  activating_stops_ = true;
+  OrderCommand cmd;
+  while (stops_.pop_triggered(cmd)) {
+    cmd.flags &= ~OrderFlags::STOP;
+    cmd.recv_ts = stops_.last_trade_ts();
+    if (cmd.order_type == OrderType::StopMarket) {
+      cmd.order_type = OrderType::Market;
+      submit_market(cmd);
+    } else {
+      cmd.order_type = OrderType::Limit;
+      submit_limit(cmd);
+    }
   }
+  activating_stops_ = false;
+}
 
-  Quantity available = 0;
-  Tick current_px = best_price;
+template <typename PriceLevelsImpl, typename EventSink>
+bool OrderBook<PriceLevelsImpl, EventSink>::replenish_iceberg(
+    Side s, Tick px, OrderNode *node, Timestamp ts) {
+  OrderExtras *extras = extras_.find(node->id);
+  if (!extras || extras->hidden_qty == 0) {
+    return false;
+  }
+  // The executed slice leaves the queue, the new one joins at the back
+  // with a fresh timestamp, losing time priority like a new order would
+  auto &levels = (s == Side::Bid) ? bids_ : asks_;
+  levels.erase(px, node);
+  extras->replenish(*node);
+  node->ts = ts;
+  levels.enqueue(px, node);
+  emit_order(OrderEventKind::Added, s, node->id, px, node->qty, ts);
+  return true;
+}
 
-  constexpr int MAX_STEPS = 10000;
-  int steps = 0;
+template <typename PriceLevelsImpl, typename EventSink>
+void OrderBook<PriceLevelsImpl, EventSink>::unlink_order(Side side, Tick price,
+                                                         OrderNode *node,
+                                                         Timestamp ts) {
+  auto &levels = (side == Side::Bid) ? bids_ : asks_;
+  levels.erase(price, node);
+  touch_depth(side, price, ts);
 
-  while (available < qty && steps < MAX_STEPS) {
-    if (IsBid) {
-      // Walking Asks UP
-      if (current_px > px_limit || current_px == Sentinel::EMPTY_ASK)
-        break;
-      if (!asks_.is_valid_price(current_px))
-        break;
+  // Update best price if the best level is now empty
+  Tick best = (side == Side::Bid) ? levels.best_bid() : levels.best_ask();
+  if (price == best && !levels.has_level(price)) {
+    refresh_best_after_depletion(side);
+  }
+}
 
-      if (asks_.has_level(current_px)) {
-        available += asks_.get_level(current_px).total_qty;
-      }
-      current_px++;
-    } else {
-      // Walking Bids DOWN
-      if (current_px < px_limit || current_px == Sentinel::EMPTY_BID)
-        break;
-      if (!bids_.is_valid_price(current_px))
-        break;
-
-      if (bids_.has_level(current_px)) {
-        available += bids_.get_level(current_px).total_qty;
+template <typename PriceLevelsImpl, typename EventSink>
+void OrderBook<PriceLevelsImpl, EventSink>::refresh_best_after_depletion(
+    Side s) {
+  // The level containers index non-empty levels, so the next best price is
+  // found without walking empty ticks
+  if (s == Side::Bid) {
+    Tick current_best = bids_.best_bid();
+    if (current_best == Sentinel::EMPTY_BID)
+      return;
+    bids_.set_best_bid(bids_.find_next_bid(current_best));
+  } else {
+    Tick current_best = asks_.best_ask();
+    if (current_best == Sentinel::EMPTY_ASK)
+      return;
+    asks_.set_best_ask(asks_.find_next_ask(current_best));
+  }
+}
+
+template <typename PriceLevelsImpl, typename EventSink>
+template <bool IsBid>
+bool OrderBook<PriceLevelsImpl, EventSink>::check_fok_liquidity(
+    Quantity qty, Tick px_limit, UserId user, uint32_t stp) {
+  if (UNLIKELY(stp)) {
+    // Replay the match loop's STP decisions without touching the book:
+    // own orders give no fill, and cancel-newest/both stop the taker
+    auto &levels = IsBid ? asks_ : bids_;
+    uint32_t mode = stp & OrderFlags::STP_MODE_MASK;
+    bool stops = mode == OrderFlags::STP_CANCEL_NEWEST ||
+                 mode == OrderFlags::STP_CANCEL_BOTH;
+    Tick px = IsBid ? levels.best_ask() : levels.best_bid();
+    while (qty > 0 && (IsBid ? px != Sentinel::EMPTY_ASK && px <= px_limit
+                             : px != Sentinel::EMPTY_BID && px >= px_limit)) {
+      for (OrderNode *maker = levels.get_level(px).head; maker && qty > 0;
+           maker = maker->next) {
+        if (maker->user != user) {
+          qty -= std::min(qty, maker->qty);
+        } else if (stops) {
+          return false;
+        } else if (mode == OrderFlags::STP_DECREMENT) {
+          qty -= std::min(qty, maker->qty); // resolved without a fill
+        }
       }
-      current_px--;
+      px = IsBid ? levels.find_next_ask(px) : levels.find_next_bid(px);
     }
-    steps++;
+    return qty == 0;
   }
 
-  return available >= qty;
+  // A buy takes from the asks at or below its limit, a sell from the bids at
+  // or above it. The level container answers from its depth index when it
+  // has one, otherwise by walking non-empty levels.
+  if constexpr (IsBid) {
+    return asks_.available_qty(Side::Ask, px_limit, qty) >= qty;
+  } else {
+    return bids_.available_qty(Side::Bid, px_limit, qty) >= qty;
+  }
+}
+
+template <typename PriceLevelsImpl, typename EventSink>
+void OrderBook<PriceLevelsImpl, EventSink>::emit_trade(
+    const TradeEvent &trade) {
+  sink_.on_trade(trade);
 }
 
-template <typename PriceLevelsImpl>
-void OrderBook<PriceLevelsImpl>::emit_trade(const TradeEvent &trade) {
-  if (on_trade_) {
-    on_trade_(trade);
+template <typename PriceLevelsImpl, typename EventSink>
+void OrderBook<PriceLevelsImpl, EventSink>::emit_book_update() {
+  if (sink_.wants_book_updates()) {
+    ++bbo_stats_.requested;
+    if (conflate_book_updates_) {
+      bbo_pending_ = true; // published by flush_book_update()
+      return;
+    }
+    publish_book_update();
   }
 }
 
-template <typename PriceLevelsImpl>
-void OrderBook<PriceLevelsImpl>::emit_book_update() {
-  if (on_book_update_) {
-    Tick best_bid_px = bids_.best_bid();
-    Tick best_ask_px = asks_.best_ask();
+template <typename PriceLevelsImpl, typename EventSink>
+void OrderBook<PriceLevelsImpl, EventSink>::publish_book_update() {
+  Tick best_bid_px = bids_.best_bid();
+  Tick best_ask_px = asks_.best_ask();
 
-    Quantity bid_qty = 0;
-    Quantity ask_qty = 0;
+  Quantity bid_qty = 0;
+  Quantity ask_qty = 0;
 
-    if (best_bid_px != Sentinel::EMPTY_BID) {
-      bid_qty = bids_.get_level(best_bid_px).total_qty;
+  if (best_bid_px != Sentinel::EMPTY_BID) {
+    bid_qty = bids_.get_level(best_bid_px).total_qty;
+  }
+  if (best_ask_px != Sentinel::EMPTY_ASK) {
+    ask_qty = asks_.get_level(best_ask_px).total_qty;
+  }
+
+  // Only a change of the top of book is worth a timestamp and an event
+  if (best_bid_px == last_bid_px_ && best_ask_px == last_ask_px_ &&
+      bid_qty == last_bid_qty_ && ask_qty == last_ask_qty_) {
+    return;
+  }
+  last_bid_px_ = best_bid_px;
+  last_ask_px_ = best_ask_px;
+  last_bid_qty_ = bid_qty;
+  last_ask_qty_ = ask_qty;
+
+  BookUpdate update;
+  update.ts = TimestampUtil::now_ns();
+  update.symbol_id = symbol_id_;
+  update.best_bid = best_bid_px;
+  update.best_ask = best_ask_px;
+  update.bid_qty = bid_qty;
+  update.ask_qty = ask_qty;
+
+  ++bbo_stats_.published;
+  sink_.on_book_update(update);
+}
+
+template <typename PriceLevelsImpl, typename EventSink>
+void OrderBook<PriceLevelsImpl, EventSink>::emit_order(OrderEventKind kind,
+                                                       Side side, OrderId id,
+                                                       Tick px, Quantity qty,
+                                                       Timestamp ts) {
+  if (sink_.wants_orders()) {
+    OrderEvent event;
+    event.ts = ts ? ts : TimestampUtil::now_ns(); // 0: no command timestamp
+    event.seq = ++order_seq_;
+    event.order_id = id;
+    event.symbol_id = symbol_id_;
+    event.side = side;
+    event.kind = kind;
+    event.price_ticks = px;
+    event.qty = qty;
+    sink_.on_order(event);
+  }
+}
+
+template <typename PriceLevelsImpl, typename EventSink>
+size_t OrderBook<PriceLevelsImpl, EventSink>::expire_orders(Timestamp now) {
+  if (LIKELY(!expiry_wheel_.due(now))) {
+    return 0;
+  }
+  size_t expired = 0;
+  expiry_wheel_.advance(now, [&](OrderId id, Timestamp expiry) {
+    // Timers leave the wheel with their order, so the order is live; its
+    // timer is freed by the wheel once this returns
+    OrderExtras *extras = extras_.find(id);
+    if (extras && extras->expiry_ts == expiry) {
+      extras->expiry_timer = nullptr;
+      cancel(id, expiry); // stamped with the order's own expiry time
+      ++expired;
     }
-    if (best_ask_px != Sentinel::EMPTY_ASK) {
-      ask_qty = asks_.get_level(best_ask_px).total_qty;
+  });
+  return expired;
+}
+
+template <typename PriceLevelsImpl, typename EventSink>
+void OrderBook<PriceLevelsImpl, EventSink>::enable_depth(size_t levels) {
+  bid_depth_.reset(levels);
+  ask_depth_.reset(levels);
+  // Seed the views from the best levels; later changes are incremental
+  const Timestamp now = TimestampUtil::now_ns();
+  for (Tick px = bids_.best_bid();
+       px != Sentinel::EMPTY_BID && bid_depth_.size() < bid_depth_.depth();
+       px = bids_.find_next_bid(px)) {
+    touch_depth(Side::Bid, px, now);
+  }
+  for (Tick px = asks_.best_ask();
+       px != Sentinel::EMPTY_ASK && ask_depth_.size() < ask_depth_.depth();
+       px = asks_.find_next_ask(px)) {
+    touch_depth(Side::Ask, px, now);
+  }
+}
+
+template <typename PriceLevelsImpl, typename EventSink>
+void OrderBook<PriceLevelsImpl, EventSink>::touch_depth(Side s, Tick px,
+                                                        Timestamp ts) {
+  DepthView &view = (s == Side::Bid) ? bid_depth_ : ask_depth_;
+  if (LIKELY(!view.enabled())) {
+    return;
+  }
+  auto &levels = (s == Side::Bid) ? bids_ : asks_;
+
+  auto level_at = [&](Tick p) {
+    DepthLevel lvl{p, 0, 0};
+    if (levels.has_level(p)) {
+      const LevelFIFO &fifo = levels.get_level(p);
+      lvl.qty = fifo.total_qty;
+      lvl.count = fifo.count;
     }
+    return lvl;
+  };
+  auto next = [&](Tick worst) {
+    Tick p = (s == Side::Bid) ? levels.find_next_bid(worst)
+                              : levels.find_next_ask(worst);
+    bool none = p == Sentinel::EMPTY_BID || p == Sentinel::EMPTY_ASK;
+    return none ? DepthLevel{p, 0, 0} : level_at(p);
+  };
 
-    BookUpdate update;
-    update.ts = TimestampUtil::now_ns();
-    update.symbol_id = symbol_id_;
-    update.best_bid = best_bid_px;
-    update.best_ask = best_ask_px;
-    update.bid_qty = bid_qty;
-    update.ask_qty = ask_qty;
+  DepthLevel lvl = level_at(px);
+  view.update(px, lvl.qty, lvl.count, next,
+              [&](const DepthLevel &changed) { emit_depth(s, changed, ts); });
+}
 
-    on_book_update_(update);
+template <typename PriceLevelsImpl, typename EventSink>
+void OrderBook<PriceLevelsImpl, EventSink>::emit_depth(
+    Side s, const DepthLevel &level, Timestamp ts) {
+  if (sink_.wants_depth()) {
+    DepthUpdate update;
+    update.ts = ts ? ts : TimestampUtil::now_ns(); // 0: no command timestamp
+    update.symbol_id = symbol_id_;
+    update.side = s;
+    update.price_ticks = level.price_ticks;
+    update.qty = level.qty;
+    update.count = level.count;
+    sink_.on_depth(update);
   }
 }
 
@@ -6,6 +6,13 @@
 
 namespace hyperliquid {
 
+// result of a "cost to sweep qty" query against one side
+struct SweepQuote {
+  Quantity filled{0};  // qty available up to the requested amount
+  int64_t notional{0}; // sum of fill qty * price in ticks
+  Tick last_px{0};     // worst price touched
+};
+
 // price level storage interface
 class IPriceLevels {
 public:
@@ -19,6 +26,27 @@ public:
   virtual LevelFIFO *best_level_ptr(Side s) = 0;
   virtual void set_best_bid(Tick px) = 0;
   virtual void set_best_ask(Tick px) = 0;
+
+  // level mutations go through the container so it can keep its indexes
+  virtual void enqueue(Tick px, OrderNode *node) = 0;
+  virtual void erase(Tick px, OrderNode *node) = 0;
+  virtual void reduce_qty(Tick px, OrderNode *node, Quantity reduction) = 0;
+
+  // empty the level at px in one step and hand back its node chain
+  virtual LevelFIFO take_level(Tick px) = 0;
+
+  // next non-empty level strictly below / above the given price
+  virtual Tick find_next_bid(Tick current) const = 0;
+  virtual Tick find_next_ask(Tick current) const = 0;
+
+  // resting qty at or better than px_limit for side s (bids: >= px_limit,
+  // asks: <= px_limit); may stop counting once `want` is reached
+  virtual Quantity available_qty(Side s, Tick px_limit,
+                                 Quantity want) const = 0;
+
+  // cost of taking qty from side s starting at its best level
+  virtual SweepQuote sweep_cost(Side s, Quantity qty) const = 0;
+
   virtual void
   for_each_order(const std::function<void(Tick, OrderNode *)> &fn) const = 0;
   virtual void for_each_nonempty(
@@ -1,20 +1,30 @@
 #pragma once
 
+#include "depth_index.h"
+#include "level_storage.h"
+#include "occupancy_bitmap.h"
 #include "price_level.h"
 #include "types.h"
+#include <algorithm>
 #include <cassert>
-#include <vector>
 
 namespace hyperliquid {
 
 // array-indexed price levels, o(1) access for bounded ranges
-class PriceLevelsArray final : public IPriceLevels {
+// an occupancy bitmap tracks non-empty levels so next-best lookups skip gaps;
+// the optional depth index answers cumulative-depth queries in o(log n)
+template <typename Storage>
+class BasicPriceLevelsArray final : public IPriceLevels {
 public:
-  explicit PriceLevelsArray(const PriceBand &band)
+  explicit BasicPriceLevelsArray(const PriceBand &band,
+                                 bool depth_index = false)
       : band_(band),
         levels_(static_cast<size_t>(band.max_tick - band.min_tick + 1)),
-        best_bid_(Sentinel::EMPTY_BID), best_ask_(Sentinel::EMPTY_ASK),
-        best_bid_ptr_(nullptr), best_ask_ptr_(nullptr) {}
+        occupied_(levels_.size()),
+        depth_(depth_index ? DepthIndex(levels_.size()) : DepthIndex()),
+        best_bid_(Sentinel::EMPTY_BID),
+        best_ask_(Sentinel::EMPTY_ASK), best_bid_ptr_(nullptr),
+        best_ask_ptr_(nullptr) {}
 
   LevelFIFO &get_level(Tick px) override { return levels_[idx(px)]; }
   bool has_level(Tick px) const override { return !levels_[idx(px)].empty(); }
@@ -38,20 +48,169 @@ public:
     best_ask_ptr_ = (px == Sentinel::EMPTY_ASK) ? nullptr : &levels_[idx(px)];
   }
 
+  void enqueue(Tick px, OrderNode *node) override {
+    size_t i = idx(px);
+    if (levels_[i].empty()) {
+      occupied_.set(i);
+      levels_.on_occupied(i);
+    }
+    if (depth_.enabled())
+      depth_.add(i, node->qty, px);
+    levels_[i].enqueue(node);
+  }
+
+  void erase(Tick px, OrderNode *node) override {
+    size_t i = idx(px);
+    if (depth_.enabled())
+      depth_.add(i, -node->qty, px);
+    levels_[i].erase(node);
+    if (levels_[i].empty()) {
+      occupied_.clear(i);
+      levels_.on_emptied(i);
+    }
+  }
+
+  void reduce_qty(Tick px, OrderNode *node, Quantity reduction) override {
+    size_t i = idx(px);
+    if (depth_.enabled())
+      depth_.add(i, -reduction, px);
+    levels_[i].reduce_qty(node, reduction);
+  }
+
+  LevelFIFO take_level(Tick px) override {
+    size_t i = idx(px);
+    LevelFIFO fifo = levels_[i];
+    if (depth_.enabled())
+      depth_.add(i, -fifo.total_qty, px);
+    levels_[i] = LevelFIFO{};
+    occupied_.clear(i);
+    levels_.on_emptied(i);
+    return fifo;
+  }
+
+  Tick find_next_bid(Tick current) const override {
+    if (current <= band_.min_tick)
+      return Sentinel::EMPTY_BID;
+    size_t i = occupied_.find_prev(
+        current > band_.max_tick ? levels_.size() - 1 : idx(current) - 1);
+    return i == OccupancyBitmap::npos ? Sentinel::EMPTY_BID : px_at(i);
+  }
+
+  Tick find_next_ask(Tick current) const override {
+    if (current >= band_.max_tick)
+      return Sentinel::EMPTY_ASK;
+    size_t i = occupied_.find_next(current < band_.min_tick ? 0
+                                                            : idx(current) + 1);
+    return i == OccupancyBitmap::npos ? Sentinel::EMPTY_ASK : px_at(i);
+  }
+
+  bool has_depth_index() const { return depth_.enabled(); }
+
+  /// Release storage for levels that have stayed empty for a while
+  /// (only available with MappedLevelStorage)
+  size_t trim_idle(uint32_t min_idle_epochs)
+    requires requires(Storage &st) { st.trim_idle(0u); }
+  {
+    return levels_.trim_idle(min_idle_epochs);
+  }
+
+  const Storage &storage() const { return levels_; }
+
+  Quantity available_qty(Side s, Tick px_limit,
+                         Quantity want) const override {
+    if (depth_.enabled()) {
+      if (s == Side::Ask) {
+        if (px_limit < band_.min_tick)
+          return 0;
+        return px_limit >= band_.max_tick ? depth_.total_qty()
+                                          : depth_.prefix_qty(idx(px_limit));
+      }
+      if (px_limit > band_.max_tick)
+        return 0;
+      return px_limit <= band_.min_tick
+                 ? depth_.total_qty()
+                 : depth_.total_qty() - depth_.prefix_qty(idx(px_limit) - 1);
+    }
+
+    // no index: walk occupied levels only
+    Quantity sum = 0;
+    if (s == Side::Ask) {
+      for (Tick px = find_next_ask(Sentinel::EMPTY_BID);
+           px != Sentinel::EMPTY_ASK && px <= px_limit && sum < want;
+           px = find_next_ask(px))
+        sum += levels_[idx(px)].total_qty;
+    } else {
+      for (Tick px = find_next_bid(Sentinel::EMPTY_ASK);
+           px != Sentinel::EMPTY_BID && px >= px_limit && sum < want;
+           px = find_next_bid(px))
+        sum += levels_[idx(px)].total_qty;
+    }
+    return sum;
+  }
+
+  SweepQuote sweep_cost(Side s, Quantity qty) const override {
+    SweepQuote q;
+    if (qty <= 0)
+      return q;
+    if (!depth_.enabled()) {
+      bool ask = s == Side::Ask;
+      for (Tick px = ask ? find_next_ask(Sentinel::EMPTY_BID)
+                         : find_next_bid(Sentinel::EMPTY_ASK);
+           px != (ask ? Sentinel::EMPTY_ASK : Sentinel::EMPTY_BID) &&
+           q.filled < qty;
+           px = ask ? find_next_ask(px) : find_next_bid(px)) {
+        Quantity take = std::min(qty - q.filled, levels_[idx(px)].total_qty);
+        q.filled += take;
+        q.notional += take * px;
+        q.last_px = px;
+      }
+      return q;
+    }
+
+    Quantity total = depth_.total_qty();
+    if (qty >= total) {
+      q.filled = total;
+      q.notional = depth_.total_notional();
+      Tick worst = (s == Side::Ask) ? find_next_bid(Sentinel::EMPTY_ASK)
+                                    : find_next_ask(Sentinel::EMPTY_BID);
+      q.last_px = (total > 0) ? worst : 0;
+      return q;
+    }
+
+    q.filled = qty;
+    if (s == Side::Ask) {
+      // asks fill upward from the low end of the band
+      size_t i = depth_.count_prefix(qty, false);
+      Quantity full = i ? depth_.prefix_qty(i - 1) : 0;
+      int64_t full_notional = i ? depth_.prefix_notional(i - 1) : 0;
+      q.last_px = px_at(i);
+      q.notional = full_notional + (qty - full) * q.last_px;
+    } else {
+      // bids fill downward from the high end of the band
+      size_t i = depth_.count_prefix(total - qty, true);
+      Quantity above = total - depth_.prefix_qty(i);
+      int64_t above_notional =
+          depth_.total_notional() - depth_.prefix_notional(i);
+      q.last_px = px_at(i);
+      q.notional = above_notional + (qty - above) * q.last_px;
+    }
+    return q;
+  }
+
   void for_each_order(
       const std::function<void(Tick, OrderNode *)> &fn) const override {
-    for (Tick px = band_.min_tick; px <= band_.max_tick; ++px) {
-      for (OrderNode *node = levels_[idx(px)].head; node; node = node->next)
-        fn(px, node);
+    for (size_t i = occupied_.find_next(0); i != OccupancyBitmap::npos;
+         i = occupied_.find_next(i + 1)) {
+      for (OrderNode *node = levels_[i].head; node; node = node->next)
+        fn(px_at(i), node);
     }
   }
 
   void for_each_nonempty(
       const std::function<void(Tick, const LevelFIFO &)> &fn) const override {
-    for (Tick px = band_.min_tick; px <= band_.max_tick; ++px) {
-      if (!levels_[idx(px)].empty())
-        fn(px, levels_[idx(px)]);
-    }
+    for (size_t i = occupied_.find_next(0); i != OccupancyBitmap::npos;
+         i = occupied_.find_next(i + 1))
+      fn(px_at(i), levels_[i]);
   }
 
 private:
@@ -59,13 +218,22 @@ private:
     assert(px >= band_.min_tick && px <= band_.max_tick);
     return static_cast<size_t>(px - band_.min_tick);
   }
+  Tick px_at(size_t i) const { return band_.min_tick + static_cast<Tick>(i); }
 
   PriceBand band_;
-  std::vector<LevelFIFO> levels_;
+  Storage levels_;
+  OccupancyBitmap occupied_;
+  DepthIndex depth_;
   Tick best_bid_;
   Tick best_ask_;
   LevelFIFO *best_bid_ptr_;
   LevelFIFO *best_ask_ptr_;
 };
 
+using PriceLevelsArray = BasicPriceLevelsArray<VectorLevelStorage>;
+
+// wide-band variant whose level memory tracks the levels in use, on top of
+// the dense occupancy bitmap (band / 8 bytes per side)
+using PriceLevelsLazyArray = BasicPriceLevelsArray<MappedLevelStorage>;
+
 } // namespace hyperliquid
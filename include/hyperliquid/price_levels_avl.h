@@ -3,6 +3,7 @@
 #include "order.h"
 #include "price_level.h"
 #include "types.h"
+#include <algorithm>
 #include <functional>
 #include <map>
 
@@ -53,6 +54,23 @@ public:
     }
   }
 
+  void enqueue(Tick px, OrderNode *node) override {
+    levels_[px].enqueue(node);
+  }
+
+  void erase(Tick px, OrderNode *node) override { levels_[px].erase(node); }
+
+  void reduce_qty(Tick px, OrderNode *node, Quantity reduction) override {
+    levels_[px].reduce_qty(node, reduction);
+  }
+
+  LevelFIFO take_level(Tick px) override {
+    LevelFIFO &level = levels_[px];
+    LevelFIFO fifo = level;
+    level = LevelFIFO{};
+    return fifo;
+  }
+
   void for_each_order(
       const std::function<void(Tick, OrderNode *)> &fn) const override {
     for (const auto &[px, level] : levels_)
@@ -67,7 +85,7 @@ public:
         fn(px, level);
   }
 
-  Tick find_next_bid(Tick current) const {
+  Tick find_next_bid(Tick current) const override {
     if (current == Sentinel::EMPTY_BID)
       return Sentinel::EMPTY_BID;
     auto it = levels_.lower_bound(current);
@@ -79,7 +97,7 @@ public:
     return Sentinel::EMPTY_BID;
   }
 
-  Tick find_next_ask(Tick current) const {
+  Tick find_next_ask(Tick current) const override {
     if (current == Sentinel::EMPTY_ASK)
       return Sentinel::EMPTY_ASK;
     auto it = levels_.upper_bound(current);
@@ -91,6 +109,43 @@ public:
     return Sentinel::EMPTY_ASK;
   }
 
+  Quantity available_qty(Side s, Tick px_limit,
+                         Quantity want) const override {
+    Quantity sum = 0;
+    if (s == Side::Ask) {
+      for (auto it = levels_.begin();
+           it != levels_.end() && it->first <= px_limit && sum < want; ++it)
+        sum += it->second.total_qty;
+    } else {
+      for (auto it = levels_.rbegin();
+           it != levels_.rend() && it->first >= px_limit && sum < want; ++it)
+        sum += it->second.total_qty;
+    }
+    return sum;
+  }
+
+  SweepQuote sweep_cost(Side s, Quantity qty) const override {
+    SweepQuote q;
+    auto take = [&](Tick px, const LevelFIFO &level) {
+      if (level.empty())
+        return;
+      Quantity n = std::min(qty - q.filled, level.total_qty);
+      q.filled += n;
+      q.notional += n * px;
+      q.last_px = px;
+    };
+    if (s == Side::Ask) {
+      for (auto it = levels_.begin(); it != levels_.end() && q.filled < qty;
+           ++it)
+        take(it->first, it->second);
+    } else {
+      for (auto it = levels_.rbegin(); it != levels_.rend() && q.filled < qty;
+           ++it)
+        take(it->first, it->second);
+    }
+    return q;
+  }
+
   void cleanup_empty_levels() {
     for (auto it = levels_.begin(); it != levels_.end();)
       it = it->second.empty() ? levels_.erase(it) : std::next(it);
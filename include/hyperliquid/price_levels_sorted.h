@@ -0,0 +1,266 @@
+#pragma once
+
+#include "order.h"
+#include "price_level.h"
+#include "types.h"
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+namespace hyperliquid {
+
+// sorted-array price levels for sparse books
+// non-empty levels are kept contiguous in ascending price order inside a gap
+// buffer with free space at both ends, so the best bid (back) and best ask
+// (front) are o(1) to reach and to remove. depleted levels are erased
+// automatically. tick keys are stored apart from levels for fast search.
+class PriceLevelsSorted final : public IPriceLevels {
+public:
+  explicit PriceLevelsSorted(size_t initial_capacity = 64)
+      : keys_(std::max<size_t>(initial_capacity, 8)), vals_(keys_.size()),
+        begin_(keys_.size() / 2), end_(begin_),
+        best_bid_(Sentinel::EMPTY_BID), best_ask_(Sentinel::EMPTY_ASK),
+        best_bid_ptr_(nullptr), best_ask_ptr_(nullptr) {}
+
+  // a missing price reads as an empty level; only enqueue adds levels
+  LevelFIFO &get_level(Tick px) override {
+    size_t i = lower_bound(px);
+    if (i == end_ || keys_[i] != px) {
+      missing_ = LevelFIFO{};
+      return missing_;
+    }
+    return vals_[i];
+  }
+
+  bool has_level(Tick px) const override {
+    size_t i = lower_bound(px);
+    return i != end_ && keys_[i] == px && !vals_[i].empty();
+  }
+
+  bool is_valid_price(Tick px) const override {
+    return px > Sentinel::EMPTY_BID && px < Sentinel::EMPTY_ASK;
+  }
+
+  Tick best_bid() const override { return best_bid_; }
+  Tick best_ask() const override { return best_ask_; }
+
+  LevelFIFO *best_level_ptr(Side s) override {
+    return (s == Side::Bid) ? best_bid_ptr_ : best_ask_ptr_;
+  }
+
+  void set_best_bid(Tick px) override {
+    best_bid_ = px;
+    best_bid_ptr_ = find_ptr(px, Sentinel::EMPTY_BID);
+  }
+
+  void set_best_ask(Tick px) override {
+    best_ask_ = px;
+    best_ask_ptr_ = find_ptr(px, Sentinel::EMPTY_ASK);
+  }
+
+  void enqueue(Tick px, OrderNode *node) override {
+    size_t i = lower_bound(px);
+    if (i == end_ || keys_[i] != px)
+      i = insert_at(i, px);
+    vals_[i].enqueue(node);
+  }
+
+  void erase(Tick px, OrderNode *node) override {
+    size_t i = lower_bound(px);
+    vals_[i].erase(node);
+    if (vals_[i].empty())
+      remove_at(i);
+  }
+
+  void reduce_qty(Tick px, OrderNode *node, Quantity reduction) override {
+    vals_[lower_bound(px)].reduce_qty(node, reduction);
+  }
+
+  LevelFIFO take_level(Tick px) override {
+    size_t i = lower_bound(px);
+    LevelFIFO fifo = vals_[i];
+    remove_at(i);
+    return fifo;
+  }
+
+  Tick find_next_bid(Tick current) const override {
+    if (current == Sentinel::EMPTY_BID)
+      return Sentinel::EMPTY_BID;
+    for (size_t i = lower_bound(current); i > begin_; --i)
+      if (!vals_[i - 1].empty())
+        return keys_[i - 1];
+    return Sentinel::EMPTY_BID;
+  }
+
+  Tick find_next_ask(Tick current) const override {
+    if (current == Sentinel::EMPTY_ASK)
+      return Sentinel::EMPTY_ASK;
+    for (size_t i = upper_bound(current); i < end_; ++i)
+      if (!vals_[i].empty())
+        return keys_[i];
+    return Sentinel::EMPTY_ASK;
+  }
+
+  Quantity available_qty(Side s, Tick px_limit,
+                         Quantity want) const override {
+    Quantity sum = 0;
+    if (s == Side::Ask) {
+      for (size_t i = begin_; i < end_ && keys_[i] <= px_limit && sum < want;
+           ++i)
+        sum += vals_[i].total_qty;
+    } else {
+      for (size_t i = end_;
+           i > begin_ && keys_[i - 1] >= px_limit && sum < want; --i)
+        sum += vals_[i - 1].total_qty;
+    }
+    return sum;
+  }
+
+  SweepQuote sweep_cost(Side s, Quantity qty) const override {
+    SweepQuote q;
+    auto take = [&](size_t i) {
+      Quantity n = std::min(qty - q.filled, vals_[i].total_qty);
+      q.filled += n;
+      q.notional += n * keys_[i];
+      q.last_px = keys_[i];
+    };
+    if (s == Side::Ask) {
+      for (size_t i = begin_; i < end_ && q.filled < qty; ++i)
+        take(i);
+    } else {
+      for (size_t i = end_; i > begin_ && q.filled < qty; --i)
+        take(i - 1);
+    }
+    return q;
+  }
+
+  void for_each_order(
+      const std::function<void(Tick, OrderNode *)> &fn) const override {
+    for (size_t i = begin_; i < end_; ++i)
+      for (OrderNode *node = vals_[i].head; node; node = node->next)
+        fn(keys_[i], node);
+  }
+
+  void for_each_nonempty(
+      const std::function<void(Tick, const LevelFIFO &)> &fn) const override {
+    for (size_t i = begin_; i < end_; ++i)
+      if (!vals_[i].empty())
+        fn(keys_[i], vals_[i]);
+  }
+
+  size_t num_levels() const { return end_ - begin_; }
+
+private:
+  // branch-light binary search over the contiguous key array
+  size_t lower_bound(Tick px) const {
+    size_t lo = begin_, n = end_ - begin_;
+    while (n > 0) {
+      size_t half = n / 2;
+      if (keys_[lo + half] < px) {
+        lo += half + 1;
+        n -= half + 1;
+      } else {
+        n = half;
+      }
+    }
+    return lo;
+  }
+
+  size_t upper_bound(Tick px) const {
+    size_t i = lower_bound(px);
+    return (i != end_ && keys_[i] == px) ? i + 1 : i;
+  }
+
+  LevelFIFO *find_ptr(Tick px, Tick sentinel) {
+    if (px == sentinel || begin_ == end_)
+      return nullptr;
+    // the best bid/ask normally sit at the ends of the live range
+    if (keys_[end_ - 1] == px)
+      return &vals_[end_ - 1];
+    if (keys_[begin_] == px)
+      return &vals_[begin_];
+    size_t i = lower_bound(px);
+    return (i != end_ && keys_[i] == px) ? &vals_[i] : nullptr;
+  }
+
+  // insert an empty level at position i, shifting the shorter side outward
+  size_t insert_at(size_t i, Tick px) {
+    bool shift_front = (i - begin_) < (end_ - i);
+    if ((shift_front && begin_ == 0) ||
+        (!shift_front && end_ == keys_.size())) {
+      size_t offset = i - begin_;
+      regrow();
+      i = begin_ + offset;
+      shift_front = (i - begin_) < (end_ - i);
+    }
+    if (shift_front) {
+      std::move(keys_.begin() + begin_, keys_.begin() + i,
+                keys_.begin() + begin_ - 1);
+      std::move(vals_.begin() + begin_, vals_.begin() + i,
+                vals_.begin() + begin_ - 1);
+      --begin_;
+      --i;
+    } else {
+      std::move_backward(keys_.begin() + i, keys_.begin() + end_,
+                         keys_.begin() + end_ + 1);
+      std::move_backward(vals_.begin() + i, vals_.begin() + end_,
+                         vals_.begin() + end_ + 1);
+      ++end_;
+    }
+    keys_[i] = px;
+    vals_[i] = LevelFIFO{};
+    refresh_best_ptrs();
+    return i;
+  }
+
+  void remove_at(size_t i) {
+    if (i - begin_ < end_ - i) {
+      std::move_backward(keys_.begin() + begin_, keys_.begin() + i,
+                         keys_.begin() + i + 1);
+      std::move_backward(vals_.begin() + begin_, vals_.begin() + i,
+                         vals_.begin() + i + 1);
+      ++begin_;
+    } else {
+      std::move(keys_.begin() + i + 1, keys_.begin() + end_,
+                keys_.begin() + i);
+      std::move(vals_.begin() + i + 1, vals_.begin() + end_,
+                vals_.begin() + i);
+      --end_;
+    }
+    refresh_best_ptrs();
+  }
+
+  // recentre the live range, doubling the buffer when it is half full
+  void regrow() {
+    size_t n = end_ - begin_;
+    size_t cap = (n + 1) * 2 > keys_.size() ? keys_.size() * 2 : keys_.size();
+    std::vector<Tick> keys(cap);
+    std::vector<LevelFIFO> vals(cap);
+    size_t nb = (cap - n) / 2;
+    std::copy(keys_.begin() + begin_, keys_.begin() + end_, keys.begin() + nb);
+    std::copy(vals_.begin() + begin_, vals_.begin() + end_, vals.begin() + nb);
+    keys_.swap(keys);
+    vals_.swap(vals);
+    begin_ = nb;
+    end_ = nb + n;
+  }
+
+  // levels move on insert/remove, so cached pointers are re-resolved
+  void refresh_best_ptrs() {
+    best_bid_ptr_ = find_ptr(best_bid_, Sentinel::EMPTY_BID);
+    best_ask_ptr_ = find_ptr(best_ask_, Sentinel::EMPTY_ASK);
+  }
+
+  std::vector<Tick> keys_;
+  std::vector<LevelFIFO> vals_;
+  size_t begin_;
+  size_t end_;
+  Tick best_bid_;
+  Tick best_ask_;
+  LevelFIFO *best_bid_ptr_;
+  LevelFIFO *best_ask_ptr_;
+  LevelFIFO missing_; // returned empty for get_level misses
+};
+
+} // namespace hyperliquid
@@ -0,0 +1,325 @@
+#pragma once
+
+#include "occupancy_bitmap.h"
+#include "order.h"
+#include "price_level.h"
+#include "types.h"
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <vector>
+
+namespace hyperliquid {
+
+// sliding-window price levels for wide bands
+// a dense power-of-two ring covers [lo, lo + W) around the best price and is
+// recentred as the market moves; levels outside the window live in a sparse
+// overflow map. memory scales with the window, not with the declared band.
+class PriceLevelsWindow final : public IPriceLevels {
+public:
+  explicit PriceLevelsWindow(const PriceBand &band,
+                             size_t window_ticks = size_t{1} << 16)
+      : band_(band), ring_(round_up_pow2(window_ticks)),
+        occupied_(ring_.size()), mask_(ring_.size() - 1),
+        lo_(band.min_tick), best_bid_(Sentinel::EMPTY_BID),
+        best_ask_(Sentinel::EMPTY_ASK), best_bid_ptr_(nullptr),
+        best_ask_ptr_(nullptr) {}
+
+  LevelFIFO &get_level(Tick px) override {
+    return in_window(px) ? ring_[slot(px)] : overflow_[px];
+  }
+
+  bool has_level(Tick px) const override {
+    if (in_window(px))
+      return !ring_[slot(px)].empty();
+    auto it = overflow_.find(px);
+    return it != overflow_.end() && !it->second.empty();
+  }
+
+  bool is_valid_price(Tick px) const override {
+    return px >= band_.min_tick && px <= band_.max_tick;
+  }
+
+  Tick best_bid() const override { return best_bid_; }
+  Tick best_ask() const override { return best_ask_; }
+
+  LevelFIFO *best_level_ptr(Side s) override {
+    return (s == Side::Bid) ? best_bid_ptr_ : best_ask_ptr_;
+  }
+
+  void set_best_bid(Tick px) override {
+    best_bid_ = px;
+    if (px != Sentinel::EMPTY_BID && !in_core(px))
+      recenter(px);
+    best_bid_ptr_ = (px == Sentinel::EMPTY_BID) ? nullptr : level_ptr(px);
+  }
+
+  void set_best_ask(Tick px) override {
+    best_ask_ = px;
+    if (px != Sentinel::EMPTY_ASK && !in_core(px))
+      recenter(px);
+    best_ask_ptr_ = (px == Sentinel::EMPTY_ASK) ? nullptr : level_ptr(px);
+  }
+
+  void enqueue(Tick px, OrderNode *node) override {
+    // an empty side can move its window anywhere for free
+    if (!in_window(px) && !occupied_.any() && overflow_.empty())
+      recenter(px);
+    if (in_window(px)) {
+      size_t i = slot(px);
+      if (ring_[i].empty())
+        occupied_.set(i);
+      ring_[i].enqueue(node);
+    } else {
+      overflow_[px].enqueue(node);
+    }
+  }
+
+  void erase(Tick px, OrderNode *node) override {
+    if (in_window(px)) {
+      size_t i = slot(px);
+      ring_[i].erase(node);
+      if (ring_[i].empty())
+        occupied_.clear(i);
+      return;
+    }
+    auto it = overflow_.find(px);
+    it->second.erase(node);
+    if (it->second.empty()) {
+      if (best_bid_ptr_ == &it->second)
+        best_bid_ptr_ = nullptr;
+      if (best_ask_ptr_ == &it->second)
+        best_ask_ptr_ = nullptr;
+      overflow_.erase(it);
+    }
+  }
+
+  void reduce_qty(Tick px, OrderNode *node, Quantity reduction) override {
+    get_level(px).reduce_qty(node, reduction);
+  }
+
+  LevelFIFO take_level(Tick px) override {
+    if (in_window(px)) {
+      size_t i = slot(px);
+      LevelFIFO fifo = ring_[i];
+      ring_[i] = LevelFIFO{};
+      occupied_.clear(i);
+      return fifo;
+    }
+    auto it = overflow_.find(px);
+    LevelFIFO fifo = it->second;
+    if (best_bid_ptr_ == &it->second)
+      best_bid_ptr_ = nullptr;
+    if (best_ask_ptr_ == &it->second)
+      best_ask_ptr_ = nullptr;
+    overflow_.erase(it);
+    return fifo;
+  }
+
+  Tick find_next_bid(Tick current) const override {
+    if (current == Sentinel::EMPTY_BID)
+      return Sentinel::EMPTY_BID;
+    Tick best = ring_prev(current);
+    auto it = overflow_.lower_bound(current);
+    while (it != overflow_.begin()) {
+      --it;
+      if (!it->second.empty()) {
+        best = std::max(best, it->first);
+        break;
+      }
+    }
+    return best;
+  }
+
+  Tick find_next_ask(Tick current) const override {
+    if (current == Sentinel::EMPTY_ASK)
+      return Sentinel::EMPTY_ASK;
+    Tick best = ring_next(current);
+    for (auto it = overflow_.upper_bound(current); it != overflow_.end();
+         ++it) {
+      if (!it->second.empty()) {
+        best = std::min(best, it->first);
+        break;
+      }
+    }
+    return best;
+  }
+
+  Quantity available_qty(Side s, Tick px_limit,
+                         Quantity want) const override {
+    Quantity sum = 0;
+    if (s == Side::Ask) {
+      for (Tick px = find_next_ask(Sentinel::EMPTY_BID);
+           px != Sentinel::EMPTY_ASK && px <= px_limit && sum < want;
+           px = find_next_ask(px))
+        sum += level_at(px).total_qty;
+    } else {
+      for (Tick px = find_next_bid(Sentinel::EMPTY_ASK);
+           px != Sentinel::EMPTY_BID && px >= px_limit && sum < want;
+           px = find_next_bid(px))
+        sum += level_at(px).total_qty;
+    }
+    return sum;
+  }
+
+  SweepQuote sweep_cost(Side s, Quantity qty) const override {
+    SweepQuote q;
+    bool ask = s == Side::Ask;
+    for (Tick px = ask ? find_next_ask(Sentinel::EMPTY_BID)
+                       : find_next_bid(Sentinel::EMPTY_ASK);
+         px != (ask ? Sentinel::EMPTY_ASK : Sentinel::EMPTY_BID) &&
+         q.filled < qty;
+         px = ask ? find_next_ask(px) : find_next_bid(px)) {
+      Quantity take = std::min(qty - q.filled, level_at(px).total_qty);
+      q.filled += take;
+      q.notional += take * px;
+      q.last_px = px;
+    }
+    return q;
+  }
+
+  void for_each_order(
+      const std::function<void(Tick, OrderNode *)> &fn) const override {
+    for_each_nonempty([&](Tick px, const LevelFIFO &level) {
+      for (OrderNode *node = level.head; node; node = node->next)
+        fn(px, node);
+    });
+  }
+
+  void for_each_nonempty(
+      const std::function<void(Tick, const LevelFIFO &)> &fn) const override {
+    for (Tick px = find_next_ask(Sentinel::EMPTY_BID); px != Sentinel::EMPTY_ASK;
+         px = find_next_ask(px))
+      fn(px, level_at(px));
+  }
+
+  Tick window_lo() const { return lo_; }
+  size_t window_size() const { return ring_.size(); }
+  size_t num_overflow_levels() const { return overflow_.size(); }
+
+private:
+  static size_t round_up_pow2(size_t n) {
+    size_t p = 64;
+    while (p < n)
+      p <<= 1;
+    return p;
+  }
+
+  size_t slot(Tick px) const { return static_cast<size_t>(px) & mask_; }
+
+  uint64_t offset(Tick px) const {
+    return static_cast<uint64_t>(px) - static_cast<uint64_t>(lo_);
+  }
+
+  bool in_window(Tick px) const { return offset(px) < ring_.size(); }
+
+  // inner half of the window; a best price outside it triggers a recentre
+  bool in_core(Tick px) const {
+    return offset(px) - ring_.size() / 4 < ring_.size() / 2;
+  }
+
+  LevelFIFO *level_ptr(Tick px) {
+    if (in_window(px))
+      return &ring_[slot(px)];
+    auto it = overflow_.find(px);
+    return it != overflow_.end() ? &it->second : nullptr;
+  }
+
+  const LevelFIFO &level_at(Tick px) const {
+    return in_window(px) ? ring_[slot(px)] : overflow_.at(px);
+  }
+
+  Tick slot_price(size_t i) const {
+    return lo_ + static_cast<Tick>((i - slot(lo_)) & mask_);
+  }
+
+  // highest occupied window price strictly below current
+  Tick ring_prev(Tick current) const {
+    Tick hi = lo_ + static_cast<Tick>(ring_.size()) - 1;
+    if (current <= lo_)
+      return Sentinel::EMPTY_BID;
+    Tick top = std::min(current - 1, hi);
+    size_t start = slot(lo_), t = slot(top);
+    size_t r = occupied_.find_prev(t);
+    if (t >= start) {
+      if (r != OccupancyBitmap::npos && r >= start)
+        return slot_price(r);
+      return Sentinel::EMPTY_BID;
+    }
+    if (r != OccupancyBitmap::npos)
+      return slot_price(r);
+    r = occupied_.find_prev(mask_);
+    if (r != OccupancyBitmap::npos && r >= start)
+      return slot_price(r);
+    return Sentinel::EMPTY_BID;
+  }
+
+  // lowest occupied window price strictly above current
+  Tick ring_next(Tick current) const {
+    Tick hi = lo_ + static_cast<Tick>(ring_.size()) - 1;
+    if (current >= hi)
+      return Sentinel::EMPTY_ASK;
+    Tick from = std::max(current + 1, lo_);
+    size_t start = slot(lo_), f = slot(from);
+    size_t r = occupied_.find_next(f);
+    if (f >= start) {
+      if (r != OccupancyBitmap::npos)
+        return slot_price(r);
+      r = occupied_.find_next(0);
+      if (r != OccupancyBitmap::npos && r < start)
+        return slot_price(r);
+      return Sentinel::EMPTY_ASK;
+    }
+    if (r != OccupancyBitmap::npos && r < start)
+      return slot_price(r);
+    return Sentinel::EMPTY_ASK;
+  }
+
+  // move the window so it is centred on px, spilling levels that fall out
+  // of it into the overflow map and pulling overflow levels that fall in
+  void recenter(Tick px) {
+    Tick new_lo = px - static_cast<Tick>(ring_.size() / 2);
+    Tick new_hi = new_lo + static_cast<Tick>(ring_.size());
+
+    for (size_t i = occupied_.find_next(0); i != OccupancyBitmap::npos;
+         i = occupied_.find_next(i + 1)) {
+      Tick level_px = slot_price(i);
+      if (level_px < new_lo || level_px >= new_hi) {
+        overflow_[level_px] = ring_[i];
+        ring_[i] = LevelFIFO{};
+        occupied_.clear(i);
+      }
+    }
+
+    lo_ = new_lo;
+    for (auto it = overflow_.lower_bound(new_lo);
+         it != overflow_.end() && it->first < new_hi;) {
+      if (!it->second.empty()) {
+        size_t i = slot(it->first);
+        ring_[i] = it->second;
+        occupied_.set(i);
+      }
+      it = overflow_.erase(it);
+    }
+
+    // cached level pointers may have moved between ring and overflow
+    if (best_bid_ != Sentinel::EMPTY_BID)
+      best_bid_ptr_ = level_ptr(best_bid_);
+    if (best_ask_ != Sentinel::EMPTY_ASK)
+      best_ask_ptr_ = level_ptr(best_ask_);
+  }
+
+  PriceBand band_;
+  std::vector<LevelFIFO> ring_;
+  OccupancyBitmap occupied_;
+  size_t mask_;
+  Tick lo_;
+  std::map<Tick, LevelFIFO> overflow_;
+  Tick best_bid_;
+  Tick best_ask_;
+  LevelFIFO *best_bid_ptr_;
+  LevelFIFO *best_ask_ptr_;
+};
+
+} // namespace hyperliquid
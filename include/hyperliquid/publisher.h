@@ -1,7 +1,8 @@
 #pragma once
 
+#include "broadcast_ring.h"
 #include "event.h"
-#include "spsc_queue.h"
+#include "wait_strategy.h"
 #include <fstream>
 #include <string>
 #include <vector>
@@ -12,18 +13,36 @@ class Publisher {
 public:
   struct Config {
     std::string output_dir;
-    std::vector<SPSCQueue<AnyEvent, 65536> *> input_queues;
+    // One required subscription per engine output ring
+    std::vector<BroadcastRing<AnyEvent, 65536>::Reader> inputs;
+    WaitMode wait{WaitMode::Yield}; // while all inputs are empty
+    Doorbell *bell{nullptr};        // rung by the engines, parked on
   };
 
   explicit Publisher(const Config &config);
 
+  // Writes events until every input delivered its StreamEnd, then
+  // flushes the logs and returns
   void run();
 
+  // Events written and time split, valid after run() returned
+  const StageStats &stats() const { return stats_; }
+
 private:
-  std::vector<SPSCQueue<AnyEvent, 65536> *> queues_;
+  // Events read from one input before moving on to the next
+  static constexpr size_t MAX_DRAIN = 256;
+
+  void write_event(const AnyEvent &evt);
+
+  std::vector<BroadcastRing<AnyEvent, 65536>::Reader> inputs_;
   std::ofstream trades_log_;
   std::ofstream book_updates_log_;
+  std::ofstream orders_log_;
+  std::ofstream depth_log_;
   std::string output_dir_;
+  WaitStrategy wait_;
+  StageStats stats_;
+  size_t ended_{0}; // inputs that delivered their StreamEnd
 };
 
 } // namespace hyperliquid
@@ -1,11 +1,11 @@
 #pragma once
 
+#include "wait_strategy.h"
+#include <algorithm>
 #include <atomic>
 #include <cstddef>
+#include <span>
 #include <type_traits>
-#if defined(__x86_64__) || defined(_M_X64)
-#include <emmintrin.h>
-#endif
 
 namespace hyperliquid {
 
@@ -16,13 +16,7 @@ template <typename T, size_t N> class SPSCQueue {
                 "T must be trivially copyable");
 
 public:
-  static void pause() {
-#if defined(__x86_64__) || defined(_M_X64)
-    _mm_pause();
-#elif defined(__aarch64__)
-    asm volatile("yield");
-#endif
-  }
+  static void pause() { cpu_relax(); }
 
   SPSCQueue() : head_(0), tail_(0) {}
 
@@ -34,8 +28,12 @@ public:
   bool push(const T &item) noexcept {
     const size_t current_tail = tail_.load(std::memory_order_relaxed);
     const size_t next_tail = (current_tail + 1) & MASK;
-    if (next_tail == head_.load(std::memory_order_acquire))
-      return false;
+    if (next_tail == cached_head_) {
+      // looks full, re-read the consumer's index
+      cached_head_ = head_.load(std::memory_order_acquire);
+      if (next_tail == cached_head_)
+        return false;
+    }
     buffer_[current_tail] = item;
     tail_.store(next_tail, std::memory_order_release);
     return true;
@@ -43,13 +41,60 @@ public:
 
   bool pop(T &item) noexcept {
     const size_t current_head = head_.load(std::memory_order_relaxed);
-    if (current_head == tail_.load(std::memory_order_acquire))
-      return false;
+    if (current_head == cached_tail_) {
+      // looks empty, re-read the producer's index
+      cached_tail_ = tail_.load(std::memory_order_acquire);
+      if (current_head == cached_tail_)
+        return false;
+    }
     item = buffer_[current_head];
     head_.store((current_head + 1) & MASK, std::memory_order_release);
     return true;
   }
 
+  // push as many of items as fit, publishing the tail once
+  // returns the number pushed, 0 when full
+  size_t push_n(std::span<const T> items) noexcept {
+    const size_t current_tail = tail_.load(std::memory_order_relaxed);
+    size_t free = (cached_head_ - current_tail - 1) & MASK;
+    if (free < items.size()) {
+      cached_head_ = head_.load(std::memory_order_acquire);
+      free = (cached_head_ - current_tail - 1) & MASK;
+    }
+    const size_t n = std::min(free, items.size());
+    const size_t first = std::min(n, N - current_tail);
+    std::copy_n(items.data(), first, buffer_ + current_tail);
+    std::copy_n(items.data() + first, n - first, buffer_);
+    if (n > 0)
+      tail_.store((current_tail + n) & MASK, std::memory_order_release);
+    return n;
+  }
+
+  // pop up to out.size() items, publishing the head once
+  // returns the number popped, 0 when empty
+  size_t pop_n(std::span<T> out) noexcept {
+    return consume([&out, i = size_t{0}](const T &item) mutable {
+      out[i++] = item;
+    }, out.size());
+  }
+
+  // call fn(const T &) on up to max items in place, then release them with
+  // one head update. fn must not touch the queue.
+  template <typename Fn> size_t consume(Fn &&fn, size_t max) {
+    const size_t current_head = head_.load(std::memory_order_relaxed);
+    size_t avail = (cached_tail_ - current_head) & MASK;
+    if (avail < max) {
+      cached_tail_ = tail_.load(std::memory_order_acquire);
+      avail = (cached_tail_ - current_head) & MASK;
+    }
+    const size_t n = std::min(avail, max);
+    for (size_t i = 0; i < n; ++i)
+      fn(buffer_[(current_head + i) & MASK]);
+    if (n > 0)
+      head_.store((current_head + n) & MASK, std::memory_order_release);
+    return n;
+  }
+
   bool empty() const noexcept {
     return head_.load(std::memory_order_relaxed) ==
            tail_.load(std::memory_order_acquire);
@@ -65,9 +110,13 @@ public:
 
 private:
   static constexpr size_t MASK = N - 1;
-  alignas(64) std::atomic<size_t> head_;
-  alignas(64) std::atomic<size_t> tail_;
-  T buffer_[N];
+  // each side caches the other's index and only reloads it, a cross-core
+  // cache line transfer, when the queue looks full or empty
+  alignas(64) std::atomic<size_t> head_; // consumer
+  size_t cached_tail_{0};
+  alignas(64) std::atomic<size_t> tail_; // producer
+  size_t cached_head_{0};
+  alignas(64) T buffer_[N];
 };
 
 } // namespace hyperliquid
@@ -0,0 +1,206 @@
+#pragma once
+
+#include "command.h"
+#include "flat_map.h"
+#include "types.h"
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+namespace hyperliquid {
+
+// trigger book of pending stop orders, indexed by stop price
+// buy stops fire once the last trade price rises to their stop price and sell
+// stops once it falls to theirs, so each side is a heap whose top is the stop
+// nearest to the last price: checking for a trigger is two compares, and each
+// activation is one pop. ties fire in arrival order. cancelled stops leave
+// their heap entry behind and are skipped when it surfaces. the ids of each
+// user's stops are listed too, so a mass cancel walks only that user's.
+class StopBook {
+public:
+  explicit StopBook(size_t initial_capacity = 256)
+      : pending_(initial_capacity) {
+    buy_heap_.reserve(initial_capacity);
+    sell_heap_.reserve(initial_capacity);
+  }
+
+  size_t size() const noexcept { return size_; }
+  bool empty() const noexcept { return size_ == 0; }
+  bool contains(OrderId id) { return pending_.find(id) != nullptr; }
+
+  // last trade price, the reference for triggering
+  bool has_last_trade() const noexcept { return has_last_; }
+  Tick last_trade_px() const noexcept { return last_px_; }
+  Timestamp last_trade_ts() const noexcept { return last_ts_; }
+
+  void on_trade(Tick px, Timestamp ts) {
+    last_px_ = px;
+    last_ts_ = ts;
+    has_last_ = true;
+  }
+
+  // park a stop order until cmd.stop_price is reached
+  void add(const OrderCommand &cmd) {
+    Entry e{cmd.stop_price, ++seq_, cmd.order_id};
+    if (!pending_.find(cmd.order_id))
+      ++size_; // a reused id replaces the pending stop
+    pending_.insert(cmd.order_id, Pending{cmd, e.seq});
+    if (cmd.user_id != NO_USER) {
+      std::vector<OrderId> *ids = by_user_.find(cmd.user_id);
+      if (!ids) {
+        by_user_.insert(cmd.user_id, {});
+        ids = by_user_.find(cmd.user_id);
+      }
+      // drop ids of stops that fired or were cancelled as the list doubles
+      if (ids->size() >= 8 && (ids->size() & (ids->size() - 1)) == 0)
+        prune(cmd.user_id, *ids);
+      ids->push_back(cmd.order_id);
+    }
+    if (cmd.side == Side::Bid) {
+      buy_heap_.push_back(e);
+      std::push_heap(buy_heap_.begin(), buy_heap_.end(), BuyAfter{});
+    } else {
+      sell_heap_.push_back(e);
+      std::push_heap(sell_heap_.begin(), sell_heap_.end(), SellAfter{});
+    }
+  }
+
+  bool cancel(OrderId id) {
+    if (!pending_.find(id))
+      return false;
+    pending_.erase(id);
+    --size_;
+    // drop dead heap entries once they outnumber the live ones
+    if (buy_heap_.size() + sell_heap_.size() > 2 * size_ + 64)
+      compact();
+    return true;
+  }
+
+  // cancel the pending stops of user that pass filter, matched on their
+  // side and stop price. returns the number cancelled.
+  size_t cancel_user(UserId user, const MassCancelFilter &filter) {
+    std::vector<OrderId> *ids = by_user_.find(user);
+    if (!ids)
+      return 0;
+    size_t cancelled = 0;
+    for (OrderId id : *ids) {
+      Pending *p = pending_.find(id);
+      if (p && p->cmd.user_id == user &&
+          filter.matches(p->cmd.side, p->cmd.stop_price)) {
+        pending_.erase(id);
+        --size_;
+        ++cancelled;
+      }
+    }
+    prune(user, *ids);
+    if (ids->empty())
+      by_user_.erase(user);
+    if (cancelled > 0 && buy_heap_.size() + sell_heap_.size() > 2 * size_ + 64)
+      compact();
+    return cancelled;
+  }
+
+  // whether the last trade price has reached a pending stop, o(1)
+  bool triggered() const noexcept {
+    if (!has_last_)
+      return false;
+    return (!buy_heap_.empty() && buy_heap_.front().stop_px <= last_px_) ||
+           (!sell_heap_.empty() && sell_heap_.front().stop_px >= last_px_);
+  }
+
+  // remove the next stop triggered by the last trade price, earliest
+  // arrival first when both sides have one. false if none is triggered.
+  bool pop_triggered(OrderCommand &out) {
+    while (triggered()) {
+      bool buy = !buy_heap_.empty() && buy_heap_.front().stop_px <= last_px_;
+      bool sell =
+          !sell_heap_.empty() && sell_heap_.front().stop_px >= last_px_;
+      if (buy && sell)
+        buy = buy_heap_.front().seq < sell_heap_.front().seq;
+      Entry e =
+          buy ? pop(buy_heap_, BuyAfter{}) : pop(sell_heap_, SellAfter{});
+
+      // skip entries of cancelled stops, or of a reused id
+      if (!live(e))
+        continue;
+      out = pending_.find(e.id)->cmd;
+      pending_.erase(e.id);
+      --size_;
+      return true;
+    }
+    return false;
+  }
+
+private:
+  struct Entry {
+    Tick stop_px;
+    uint64_t seq;
+    OrderId id;
+  };
+
+  struct Pending {
+    OrderCommand cmd;
+    uint64_t seq;
+  };
+
+  // heap orderings: the top is the lowest buy stop / highest sell stop
+  struct BuyAfter {
+    bool operator()(const Entry &a, const Entry &b) const {
+      return a.stop_px != b.stop_px ? a.stop_px > b.stop_px : a.seq > b.seq;
+    }
+  };
+  struct SellAfter {
+    bool operator()(const Entry &a, const Entry &b) const {
+      return a.stop_px != b.stop_px ? a.stop_px < b.stop_px : a.seq > b.seq;
+    }
+  };
+
+  template <typename After>
+  static Entry pop(std::vector<Entry> &heap, After after) {
+    std::pop_heap(heap.begin(), heap.end(), after);
+    Entry e = heap.back();
+    heap.pop_back();
+    return e;
+  }
+
+  // keep the ids of user's stops that are still pending
+  void prune(UserId user, std::vector<OrderId> &ids) {
+    ids.erase(std::remove_if(ids.begin(), ids.end(),
+                             [&](OrderId id) {
+                               Pending *p = pending_.find(id);
+                               return !p || p->cmd.user_id != user;
+                             }),
+              ids.end());
+  }
+
+  bool live(const Entry &e) {
+    Pending *p = pending_.find(e.id);
+    return p && p->seq == e.seq;
+  }
+
+  void compact() {
+    auto dead = [this](const Entry &e) { return !live(e); };
+    buy_heap_.erase(std::remove_if(buy_heap_.begin(), buy_heap_.end(), dead),
+                    buy_heap_.end());
+    sell_heap_.erase(
+        std::remove_if(sell_heap_.begin(), sell_heap_.end(), dead),
+        sell_heap_.end());
+    std::make_heap(buy_heap_.begin(), buy_heap_.end(), BuyAfter{});
+    std::make_heap(sell_heap_.begin(), sell_heap_.end(), SellAfter{});
+  }
+
+  static constexpr UserId NO_USER = std::numeric_limits<UserId>::max();
+
+  FlatMap<OrderId, Pending> pending_;
+  FlatMap<UserId, std::vector<OrderId>, NO_USER> by_user_;
+  std::vector<Entry> buy_heap_;
+  std::vector<Entry> sell_heap_;
+  uint64_t seq_{0};
+  size_t size_{0};
+  Tick last_px_{0};
+  Timestamp last_ts_{0};
+  bool has_last_{false};
+};
+
+} // namespace hyperliquid
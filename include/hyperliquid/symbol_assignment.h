@@ -0,0 +1,102 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <istream>
+#include <numeric>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace hyperliquid {
+
+// engine each symbol is matched on, indexed by symbol_id
+using SymbolAssignment = std::vector<uint32_t>;
+
+// symbol i on engine i % engines
+inline SymbolAssignment assign_round_robin(size_t symbols, size_t engines) {
+  SymbolAssignment out(symbols);
+  for (size_t i = 0; i < symbols; ++i)
+    out[i] = static_cast<uint32_t>(i % engines);
+  return out;
+}
+
+// balance observed per-symbol load (e.g. command counts) over the engines
+// greedy longest-processing-time: the busiest symbol goes first, each onto
+// the engine with the least load so far, which lands within 4/3 of the best
+// possible busiest engine. idle symbols are spread by count so no engine
+// collects all of them.
+inline SymbolAssignment assign_by_load(const std::vector<uint64_t> &load,
+                                       size_t engines) {
+  std::vector<size_t> order(load.size());
+  std::iota(order.begin(), order.end(), size_t{0});
+  std::stable_sort(order.begin(), order.end(),
+                   [&](size_t a, size_t b) { return load[a] > load[b]; });
+
+  SymbolAssignment out(load.size());
+  std::vector<uint64_t> engine_load(engines, 0);
+  std::vector<size_t> engine_symbols(engines, 0);
+  for (size_t sym : order) {
+    size_t best = 0;
+    for (size_t e = 1; e < engines; ++e) {
+      if (engine_load[e] < engine_load[best] ||
+          (engine_load[e] == engine_load[best] &&
+           engine_symbols[e] < engine_symbols[best]))
+        best = e;
+    }
+    out[sym] = static_cast<uint32_t>(best);
+    engine_load[best] += load[sym];
+    ++engine_symbols[best];
+  }
+  return out;
+}
+
+// static assignment from a map with one "SYMBOL ENGINE" pair per line
+// '#' starts a comment. symbols the map leaves out go to the engine with the
+// fewest symbols. false, with a reason in error, for a symbol that is not
+// traded or an engine index out of range.
+inline bool parse_symbol_map(std::istream &in,
+                             const std::vector<std::string> &symbols,
+                             size_t engines, SymbolAssignment &out,
+                             std::string &error) {
+  constexpr uint32_t UNASSIGNED = UINT32_MAX;
+  out.assign(symbols.size(), UNASSIGNED);
+  std::vector<size_t> engine_symbols(engines, 0);
+
+  std::string line;
+  for (size_t line_no = 1; std::getline(in, line); ++line_no) {
+    line = line.substr(0, line.find('#'));
+    std::istringstream fields(line);
+    std::string symbol;
+    long engine;
+    if (!(fields >> symbol))
+      continue; // blank or comment
+    if (!(fields >> engine) || engine < 0 ||
+        static_cast<size_t>(engine) >= engines) {
+      error = "line " + std::to_string(line_no) + ": bad engine for " + symbol;
+      return false;
+    }
+    auto it = std::find(symbols.begin(), symbols.end(), symbol);
+    if (it == symbols.end()) {
+      error = "line " + std::to_string(line_no) + ": unknown symbol " + symbol;
+      return false;
+    }
+    uint32_t &slot = out[static_cast<size_t>(it - symbols.begin())];
+    if (slot != UNASSIGNED)
+      --engine_symbols[slot]; // a later line moves the symbol
+    slot = static_cast<uint32_t>(engine);
+    ++engine_symbols[slot];
+  }
+
+  for (uint32_t &slot : out) {
+    if (slot == UNASSIGNED) {
+      slot = static_cast<uint32_t>(
+          std::min_element(engine_symbols.begin(), engine_symbols.end()) -
+          engine_symbols.begin());
+      ++engine_symbols[slot];
+    }
+  }
+  return true;
+}
+
+} // namespace hyperliquid
@@ -0,0 +1,196 @@
+#pragma once
+
+#include "mempool.h"
+#include "types.h"
+#include <cstddef>
+#include <cstdint>
+
+namespace hyperliquid {
+
+/// One scheduled expiry; the handle TimingWheel::schedule returns
+struct WheelTimer {
+  WheelTimer *next;
+  WheelTimer **pprev; // the link pointing here, nullptr while firing
+  OrderId id;
+  Timestamp expiry;
+  uint32_t level; // LEVELS for the due list
+};
+
+/// Hierarchical timing wheel keyed by order id, for GTD expiry.
+/// Four levels of 256 slots cover 2^32 ticks; a timer sits in the level of
+/// the highest 8-bit tick digit in which its expiry differs from the current
+/// tick and moves down a level each time that digit comes up. Scheduling,
+/// cancelling and firing are O(1) per timer and timers come from a slab
+/// pool, so the hot path does not allocate. Slot lists are doubly linked,
+/// so the owner cancels a timer as soon as its order leaves the book and
+/// no dead timers pile up to be paid for when their tick comes.
+class TimingWheel {
+  using Timer = WheelTimer;
+
+public:
+  static constexpr size_t LEVELS = 4;
+  static constexpr size_t SLOT_BITS = 8;
+  static constexpr size_t SLOTS = size_t{1} << SLOT_BITS;
+
+  /// tick_shift sets the resolution to 2^tick_shift ns (default ~1 ms)
+  explicit TimingWheel(uint32_t tick_shift = 20, Timestamp start = 0)
+      : pool_(0), shift_(tick_shift), cur_(start >> tick_shift) {}
+
+  size_t size() const noexcept { return size_; }
+  bool empty() const noexcept { return size_ == 0; }
+
+  /// Whether advance(now) would have anything to do
+  bool due(Timestamp now) const noexcept {
+    return size_ != 0 && (due_ != nullptr || (now >> shift_) > cur_);
+  }
+
+  /// Fire id once now >= expiry (rounded up to the tick resolution).
+  /// now lets an empty wheel catch up with the caller's clock for free.
+  /// The handle stays valid until the timer fires or is cancelled.
+  WheelTimer *schedule(OrderId id, Timestamp expiry, Timestamp now = 0) {
+    if (size_ == 0 && (now >> shift_) > cur_)
+      cur_ = now >> shift_;
+    Timer *t = pool_.alloc();
+    t->id = id;
+    t->expiry = expiry;
+    ++size_;
+    uint64_t tick = tick_of(expiry);
+    if (tick <= cur_) {
+      // already due; this tick's slot may have fired
+      t->level = LEVELS;
+      push_front(due_, t);
+      return t;
+    }
+    place(t, tick);
+    return t;
+  }
+
+  /// Remove a timer before it fires. A timer whose callback is running is
+  /// left to advance(), which frees it afterwards.
+  void cancel(WheelTimer *t) {
+    if (!t->pprev)
+      return;
+    *t->pprev = t->next;
+    if (t->next)
+      t->next->pprev = t->pprev;
+    if (t->level < LEVELS)
+      --count_[t->level];
+    pool_.free(t);
+    --size_;
+  }
+
+  /// Advance to now, calling fn(id, expiry) for every timer that is due.
+  /// Returns the number of timers fired.
+  template <typename Fn> size_t advance(Timestamp now, Fn &&fn) {
+    size_t fired = fire_list(due_, fn);
+
+    uint64_t target = now >> shift_;
+    while (cur_ < target) {
+      // with the lower levels empty nothing happens before the next
+      // boundary of the lowest non-empty level, so jump straight to it
+      size_t low = 0;
+      while (low < LEVELS && count_[low] == 0)
+        ++low;
+      if (low == LEVELS) {
+        cur_ = target;
+        break;
+      }
+      if (low > 0) {
+        uint64_t span = uint64_t{1} << (SLOT_BITS * low);
+        uint64_t boundary = (cur_ | (span - 1)) + 1;
+        if (boundary > target) {
+          cur_ = target;
+          break;
+        }
+        cur_ = boundary - 1;
+      }
+      ++cur_;
+      // cascade from the highest level whose digit rolled over
+      size_t top = 0;
+      while (top + 1 < LEVELS &&
+             (cur_ & ((uint64_t{1} << (SLOT_BITS * (top + 1))) - 1)) == 0)
+        ++top;
+      for (size_t level = top; level > 0; --level) {
+        Timer *&head = slots_[level][digit(cur_, level)];
+        Timer *t = head;
+        head = nullptr;
+        while (t) {
+          Timer *next = t->next;
+          --count_[level];
+          place(t, tick_of(t->expiry));
+          t = next;
+        }
+      }
+      fired += fire_list(slots_[0][digit(cur_, 0)], fn);
+    }
+    return fired;
+  }
+
+private:
+  static size_t digit(uint64_t tick, size_t level) {
+    return (tick >> (SLOT_BITS * level)) & (SLOTS - 1);
+  }
+
+  // first tick at or after ts, so timers never fire early
+  uint64_t tick_of(Timestamp ts) const {
+    uint64_t tick = ts >> shift_;
+    return (ts & ((Timestamp{1} << shift_) - 1)) ? tick + 1 : tick;
+  }
+
+  // tick > cur_ on entry from schedule, tick >= cur_ on a cascade
+  void place(Timer *t, uint64_t tick) {
+    size_t level = 0;
+    while (level + 1 < LEVELS &&
+           (tick >> (SLOT_BITS * (level + 1))) !=
+               (cur_ >> (SLOT_BITS * (level + 1))))
+      ++level;
+    size_t slot;
+    if ((tick >> (SLOT_BITS * LEVELS)) != (cur_ >> (SLOT_BITS * LEVELS))) {
+      // beyond the horizon: park in top-level slot 0, which comes up when
+      // the wheel wraps and is otherwise unused since tick > cur_
+      slot = 0;
+    } else {
+      slot = digit(tick, level);
+    }
+    t->level = static_cast<uint32_t>(level);
+    push_front(slots_[level][slot], t);
+    ++count_[level];
+  }
+
+  static void push_front(Timer *&head, Timer *t) {
+    t->next = head;
+    t->pprev = &head;
+    if (head)
+      head->pprev = &t->next;
+    head = t;
+  }
+
+  // fire and free every timer of a list, which stays consistent meanwhile
+  // so fn may cancel other timers on it
+  template <typename Fn> size_t fire_list(Timer *&head, Fn &fn) {
+    size_t n = 0;
+    while (Timer *t = head) {
+      head = t->next;
+      if (head)
+        head->pprev = &head;
+      if (t->level < LEVELS)
+        --count_[t->level];
+      t->pprev = nullptr; // cancel() leaves it to us
+      fn(t->id, t->expiry);
+      pool_.free(t);
+      --size_;
+      ++n;
+    }
+    return n;
+  }
+
+  SlabPool<Timer, (1 << 16)> pool_;
+  uint32_t shift_;
+  uint64_t cur_;
+  size_t size_{0};
+  Timer *due_{nullptr};
+  size_t count_[LEVELS]{}; // timers per level
+  Timer *slots_[LEVELS][SLOTS]{};
+};
+
+} // namespace hyperliquid
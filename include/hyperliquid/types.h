@@ -36,8 +36,21 @@ constexpr uint32_t REDUCE_ONLY = 1 << 1;
 constexpr uint32_t STP = 1 << 2;     // self-trade prevention
 constexpr uint32_t ICEBERG = 1 << 3; // hidden qty
 constexpr uint32_t STOP = 1 << 4;
+
+// self-trade prevention policy when STP is set: what happens when the taker
+// meets a resting order of the same user
+constexpr uint32_t STP_CANCEL_OLDEST = 0 << 5; // cancel the resting order
+constexpr uint32_t STP_CANCEL_NEWEST = 1 << 5; // cancel the taker's rest
+constexpr uint32_t STP_CANCEL_BOTH = 2 << 5;   // cancel both
+constexpr uint32_t STP_DECREMENT = 3 << 5;     // reduce both by the overlap
+constexpr uint32_t STP_MODE_MASK = 3 << 5;
 } // namespace OrderFlags
 
+// book-internal bits kept in OrderNode::flags next to the order flags
+namespace NodeFlags {
+constexpr uint32_t HAS_EXTRAS = 1u << 31; // entry in the cold side table
+} // namespace NodeFlags
+
 struct PriceBand {
   Tick min_tick;
   Tick max_tick;
@@ -0,0 +1,212 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#if defined(__linux__)
+#include <ctime>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#if defined(__x86_64__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+namespace hyperliquid {
+
+// spin-wait hint: lets the sibling hyperthread run and saves power
+inline void cpu_relax() noexcept {
+#if defined(__x86_64__) || defined(_M_X64)
+  _mm_pause();
+#elif defined(__aarch64__)
+  asm volatile("yield");
+#endif
+}
+
+// futex word a producer rings after publishing, so parked consumers wake
+// ringing is a fence and a load while nobody is parked; a consumer arms
+// before its last check for work, so a ring cannot fall between that check
+// and the park
+class Doorbell {
+public:
+  void ring() noexcept {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleepers_.load(std::memory_order_relaxed) == 0)
+      return;
+    seq_.fetch_add(1, std::memory_order_release);
+#if defined(__linux__)
+    syscall(SYS_futex, word(), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr,
+            0);
+#endif
+  }
+
+  // announce a park, returning the ring count to wait on
+  uint32_t arm() noexcept {
+    sleepers_.fetch_add(1, std::memory_order_seq_cst);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    return seq_.load(std::memory_order_acquire);
+  }
+
+  void disarm() noexcept { sleepers_.fetch_sub(1, std::memory_order_relaxed); }
+
+  // sleep until rung after arm() returned seen, or for at most timeout
+  void wait(uint32_t seen, std::chrono::nanoseconds timeout) noexcept {
+#if defined(__linux__)
+    timespec ts{static_cast<time_t>(timeout.count() / 1'000'000'000),
+                static_cast<long>(timeout.count() % 1'000'000'000)};
+    syscall(SYS_futex, word(), FUTEX_WAIT_PRIVATE, seen, &ts, nullptr, 0);
+#else
+    if (seq_.load(std::memory_order_acquire) == seen)
+      std::this_thread::sleep_for(timeout);
+#endif
+  }
+
+private:
+  static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t),
+                "the futex word is the atomic itself");
+  uint32_t *word() noexcept { return reinterpret_cast<uint32_t *>(&seq_); }
+
+  alignas(64) std::atomic<uint32_t> seq_{0};
+  std::atomic<uint32_t> sleepers_{0};
+};
+
+// how a pipeline thread waits when it has nothing to do
+enum class WaitMode : uint8_t {
+  Yield,   // sched_yield per poll (a syscall each time)
+  Spin,    // busy-spin with a pause hint, lowest latency, burns a core
+  Backoff, // pause count doubling per idle poll, then yield
+  Park,    // short spin, then sleep on a doorbell (futex) until rung
+};
+
+inline const char *to_string(WaitMode mode) {
+  switch (mode) {
+  case WaitMode::Yield:
+    return "yield";
+  case WaitMode::Spin:
+    return "spin";
+  case WaitMode::Backoff:
+    return "backoff";
+  case WaitMode::Park:
+    return "park";
+  }
+  return "unknown";
+}
+
+inline bool parse_wait_mode(const char *s, WaitMode &out) {
+  for (WaitMode mode : {WaitMode::Yield, WaitMode::Spin, WaitMode::Backoff,
+                        WaitMode::Park}) {
+    if (std::strcmp(s, to_string(mode)) == 0) {
+      out = mode;
+      return true;
+    }
+  }
+  return false;
+}
+
+// time accounting of one pipeline stage
+struct StageStats {
+  uint64_t items{0};   // commands or events handled
+  uint64_t wall_ns{0}; // from start of run() to its return
+  uint64_t idle_ns{0}; // waiting for work or for queue space
+
+  uint64_t busy_ns() const noexcept {
+    return wall_ns > idle_ns ? wall_ns - idle_ns : 0;
+  }
+};
+
+// idle policy of one waiting thread
+// call idle() for every poll that found no work and reset() once work shows
+// up again. a park sleeps on the doorbell when there is one and for the
+// timeout otherwise, e.g. waiting for queue space nobody signals. the time
+// from the first idle() to the reset() after it adds up in idle_ns(), two
+// clock reads per idle stretch.
+class WaitStrategy {
+public:
+  static constexpr uint32_t SPIN_ROUNDS = 64; // idle polls before parking
+  static constexpr uint32_t MAX_BACKOFF_SHIFT = 10; // up to 1024 pauses
+
+  explicit WaitStrategy(
+      WaitMode mode = WaitMode::Yield, Doorbell *bell = nullptr,
+      std::chrono::nanoseconds park_timeout = std::chrono::milliseconds(1))
+      : mode_(mode), bell_(bell), park_timeout_(park_timeout) {}
+
+  WaitMode mode() const noexcept { return mode_; }
+  uint64_t parks() const noexcept { return parks_; }
+  uint64_t idle_ns() const noexcept { return idle_ns_; }
+
+  // one idle poll; ready() is checked again after arming a park
+  template <typename Ready> void idle(Ready &&ready) {
+    if (!idling_) {
+      idling_ = true;
+      idle_since_ = std::chrono::steady_clock::now();
+    }
+    switch (mode_) {
+    case WaitMode::Yield:
+      std::this_thread::yield();
+      return;
+    case WaitMode::Spin:
+      cpu_relax();
+      return;
+    case WaitMode::Backoff:
+      if (rounds_ > MAX_BACKOFF_SHIFT) {
+        std::this_thread::yield();
+        return;
+      }
+      for (uint32_t i = 0; i < (1u << rounds_); ++i)
+        cpu_relax();
+      ++rounds_;
+      return;
+    case WaitMode::Park:
+      if (rounds_ < SPIN_ROUNDS) {
+        ++rounds_;
+        cpu_relax();
+        return;
+      }
+      park(ready);
+      return;
+    }
+  }
+
+  void idle() {
+    idle([] { return false; });
+  }
+
+  void reset() noexcept {
+    rounds_ = 0;
+    if (idling_) {
+      idling_ = false;
+      idle_ns_ += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      std::chrono::steady_clock::now() - idle_since_)
+                      .count();
+    }
+  }
+
+private:
+  template <typename Ready> void park(Ready &ready) {
+    ++parks_;
+    if (!bell_) {
+      std::this_thread::sleep_for(park_timeout_);
+      return;
+    }
+    uint32_t seen = bell_->arm();
+    if (!ready())
+      bell_->wait(seen, park_timeout_);
+    bell_->disarm();
+  }
+
+  WaitMode mode_;
+  Doorbell *bell_;
+  std::chrono::nanoseconds park_timeout_;
+  uint32_t rounds_{0};
+  uint64_t parks_{0};
+  bool idling_{false};
+  std::chrono::steady_clock::time_point idle_since_;
+  uint64_t idle_ns_{0};
+};
+
+} // namespace hyperliquid
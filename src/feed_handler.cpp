@@ -1,23 +1,38 @@
 #include "hyperliquid/feed_handler.h"
+#include <algorithm>
+#include <chrono>
 #include <cstring>
 #include <fcntl.h>
+#include <fstream>
 #include <iostream>
 #include <sys/mman.h>
 #include <sys/stat.h>
-#include <thread>
 #include <unistd.h>
 
 namespace hyperliquid {
 
 FeedHandler::FeedHandler(const Config &config)
-    : input_path_(config.input_file), queues_(config.param_queues) {}
+    : input_path_(config.input_file), queues_(config.param_queues),
+      bells_(config.bells), engine_queues_(config.engine_queues),
+      engine_bells_(config.engine_bells),
+      wait_(config.wait, nullptr, std::chrono::microseconds(50)) {}
 
 void FeedHandler::run() {
+  auto start = std::chrono::steady_clock::now();
+  stats_.items = replay();
+  end_stream();
+  stats_.wall_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+  stats_.idle_ns = wait_.idle_ns();
+}
+
+uint64_t FeedHandler::replay() {
   int fd = open(input_path_.c_str(), O_RDONLY);
   if (fd == -1) {
     std::cerr << "FeedHandler: Failed to open input file: " << input_path_
               << "\n";
-    return;
+    return 0;
   }
 
   // Get file size
@@ -25,14 +40,14 @@ void FeedHandler::run() {
   if (fstat(fd, &sb) == -1) {
     std::cerr << "FeedHandler: Failed to stat file\n";
     close(fd);
-    return;
+    return 0;
   }
 
   size_t file_size = static_cast<size_t>(sb.st_size);
   if (file_size == 0) {
     std::cout << "FeedHandler: Empty input file\n";
     close(fd);
-    return;
+    return 0;
   }
 
   // Map file into memory
@@ -40,7 +55,7 @@ void FeedHandler::run() {
   if (addr == MAP_FAILED) {
     std::cerr << "FeedHandler: mmap failed\n";
     close(fd);
-    return;
+    return 0;
   }
 
   // We can close fd after mmap
@@ -56,30 +71,37 @@ void FeedHandler::run() {
   size_t num_cmds = file_size / sizeof(OrderCommand);
   uint64_t count = 0;
 
-  for (size_t i = 0; i < num_cmds; ++i) {
-    const OrderCommand &cmd = cmds[i];
+  uint64_t next_report = 1000000;
+
+  for (size_t i = 0; i < num_cmds;) {
+    SymbolId symbol = cmds[i].symbol_id;
 
     // Validate symbol_id to avoid segfaults
-    if (cmd.symbol_id >= queues_.size() || !queues_[cmd.symbol_id]) {
+    if (symbol >= queues_.size() || !queues_[symbol]) {
       // Typically we might log this, but for high perf we might just skip or
       // count errors std::cerr << "FeedHandler: Invalid symbol_id " <<
-      // cmd.symbol_id << "\n";
+      // symbol << "\n";
+      ++i;
       continue;
     }
 
-    auto *queue = queues_[cmd.symbol_id];
-
-    // Busy wait until we can push
-    while (!queue->push(cmd)) {
-      // Optimization: Using CPU relax instruction would be better here,
-      // but we will do that in the "Matching Logic" optimization step.
-      // For now, keep yield to play nice with restricted core counts.
-      std::this_thread::yield();
+    // Hand over the run of commands for this symbol's queue straight from
+    // the mapping, publishing the queue index once per push_n
+    auto *queue = queues_[symbol];
+    size_t run = 1;
+    while (run < MAX_RUN && i + run < num_cmds &&
+           cmds[i + run].symbol_id < queues_.size() &&
+           queues_[cmds[i + run].symbol_id] == queue) {
+      ++run;
     }
+    push_all(queue, symbol < bells_.size() ? bells_[symbol] : nullptr,
+             std::span<const OrderCommand>(cmds + i, run));
+    i += run;
 
-    count++;
-    if (count % 1000000 == 0) {
+    count += run;
+    if (count >= next_report) {
       std::cout << "FeedHandler: Processed " << count << " commands\n";
+      next_report += 1000000;
     }
   }
 
@@ -87,6 +109,66 @@ void FeedHandler::run() {
   munmap(addr, file_size);
 
   std::cout << "FeedHandler: Finished. Total commands: " << count << "\n";
+  return count;
+}
+
+std::vector<uint64_t> FeedHandler::symbol_load(const std::string &path,
+                                               size_t symbols) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    return {};
+  }
+  std::vector<uint64_t> load(symbols, 0);
+  std::vector<OrderCommand> chunk(4096);
+  while (in) {
+    in.read(reinterpret_cast<char *>(chunk.data()),
+            static_cast<std::streamsize>(chunk.size() * sizeof(OrderCommand)));
+    size_t n = static_cast<size_t>(in.gcount()) / sizeof(OrderCommand);
+    for (size_t i = 0; i < n; ++i) {
+      if (chunk[i].symbol_id < symbols) {
+        ++load[chunk[i].symbol_id];
+      }
+    }
+  }
+  return load;
+}
+
+void FeedHandler::end_stream() {
+  // Every engine gets the marker once, also when the input was unreadable
+  // or no symbol maps to it, so the pipeline always drains and exits
+  std::vector<SPSCQueue<OrderCommand, 65536> *> queues = engine_queues_;
+  std::vector<Doorbell *> bells = engine_bells_;
+  bells.resize(queues.size(), nullptr);
+  for (size_t symbol = 0; symbol < queues_.size(); ++symbol) {
+    queues.push_back(queues_[symbol]);
+    bells.push_back(symbol < bells_.size() ? bells_[symbol] : nullptr);
+  }
+
+  OrderCommand end{};
+  end.type = CommandType::EndOfStream;
+  for (size_t i = 0; i < queues.size(); ++i) {
+    if (queues[i] && std::find(queues.begin(), queues.begin() + i,
+                               queues[i]) == queues.begin() + i) {
+      push_all(queues[i], bells[i], std::span<const OrderCommand>(&end, 1));
+    }
+  }
+}
+
+void FeedHandler::push_all(SPSCQueue<OrderCommand, 65536> *queue,
+                           Doorbell *bell,
+                           std::span<const OrderCommand> pending) {
+  while (!pending.empty()) {
+    size_t pushed = queue->push_n(pending);
+    pending = pending.subspan(pushed);
+    if (pushed > 0) {
+      if (bell) {
+        bell->ring();
+      }
+      wait_.reset();
+    } else {
+      wait_.idle(); // queue full
+    }
+  }
 }
 
 } // namespace hyperliquid
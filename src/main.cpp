@@ -2,8 +2,13 @@
 #include "hyperliquid/feed_handler.h"
 #include "hyperliquid/matching_engine.h"
 #include "hyperliquid/publisher.h"
+#include "hyperliquid/symbol_assignment.h"
 #include "hyperliquid/timestamp.h"
+#include <algorithm>
+#include <chrono>
 #include <cstring>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
 #include <string>
 #include <thread>
@@ -15,9 +20,22 @@ struct ProgramConfig {
   std::string input_file;
   std::string output_dir = "results";
   std::vector<std::string> symbols;
-  std::vector<int> cpu_cores;
+  std::vector<int> cpu_cores; // one engine per core
+  size_t engines = 0;         // without cores; 0 sizes to the machine
+  int feed_core = -1;
+  int publisher_core = -1;
+  std::string assign = "round-robin"; // or "load"
+  std::string symbol_map;             // static assignment file
   Tick min_price = 1;
   Tick max_price = 100000;
+  bool order_events = false;
+  size_t depth_levels = 0;
+  uint32_t conflate_commands = 0;
+  uint64_t conflate_ns = 0;
+  bool aggregate_trades = false;
+  WaitMode feed_wait = WaitMode::Yield;
+  WaitMode engine_wait = WaitMode::Yield;
+  WaitMode publisher_wait = WaitMode::Yield;
 };
 
 void print_usage(const char *program) {
@@ -28,7 +46,34 @@ void print_usage(const char *program) {
       << "  --output <dir>        Output directory (default: results)\n"
       << "  --symbols <list>      Comma-separated symbols (e.g. BTC,ETH)\n"
       << "  --price-band <min:max> Price range (default: 1:100000)\n"
-      << "  --cpu-cores <list>    Comma-separated CPU cores (e.g. 0,1,2,3)\n";
+      << "  --cpu-cores <list>    Engine cores, one engine each (e.g. 2,3,4)\n"
+      << "  --engines <n>         Engines when no cores are given\n"
+      << "  --feed-core <n>       Pin the feed handler\n"
+      << "  --publisher-core <n>  Pin the publisher\n"
+      << "  --assign <how>        Symbols to engines: round-robin (default)\n"
+      << "                        or load (command counts of the input)\n"
+      << "  --symbol-map <file>   Static \"SYMBOL ENGINE\" lines, rest by\n"
+      << "                        fewest symbols\n"
+      << "  --l3                  Publish L3 order events to orders.bin\n"
+      << "  --depth <n>           Publish top-n depth updates to depth.bin\n"
+      << "  --conflate <n>        At most one book update per n commands\n"
+      << "  --conflate-ns <ns>    At most one book update per time slice\n"
+      << "  --aggregate-trades    One trade per price level a taker sweeps\n"
+      << "  --wait <mode>         Idle wait of all stages: yield (default),\n"
+      << "                        spin, backoff or park\n"
+      << "  --wait-feed <mode>    Idle wait of the feed handler only\n"
+      << "  --wait-engine <mode>  Idle wait of the matching engines only\n"
+      << "  --wait-publisher <mode> Idle wait of the publisher only\n";
+}
+
+// One row of the per-stage report: items handled and where the time went
+void print_stage(const std::string &name, const StageStats &stats) {
+  double wall = stats.wall_ns > 0 ? static_cast<double>(stats.wall_ns) : 1.0;
+  std::cout << std::left << std::setw(14) << name << std::right
+            << std::setw(12) << stats.items << std::fixed
+            << std::setprecision(1) << std::setw(12) << stats.busy_ns() / 1e6
+            << std::setw(12) << stats.idle_ns / 1e6 << std::setw(9)
+            << 100.0 * stats.busy_ns() / wall << "%\n";
 }
 
 int main(int argc, char *argv[]) {
@@ -64,6 +109,59 @@ int main(int argc, char *argv[]) {
         s.erase(0, pos + 1);
       }
       config.cpu_cores.push_back(std::stoi(s));
+    } else if (std::strcmp(argv[i], "--engines") == 0 && i + 1 < argc) {
+      config.engines = std::stoul(argv[++i]);
+    } else if (std::strcmp(argv[i], "--feed-core") == 0 && i + 1 < argc) {
+      config.feed_core = std::stoi(argv[++i]);
+    } else if (std::strcmp(argv[i], "--publisher-core") == 0 &&
+               i + 1 < argc) {
+      config.publisher_core = std::stoi(argv[++i]);
+    } else if (std::strcmp(argv[i], "--assign") == 0 && i + 1 < argc) {
+      config.assign = argv[++i];
+      if (config.assign != "round-robin" && config.assign != "load") {
+        std::cerr << "Error: unknown assignment " << config.assign << "\n";
+        return 1;
+      }
+    } else if (std::strcmp(argv[i], "--symbol-map") == 0 && i + 1 < argc) {
+      config.symbol_map = argv[++i];
+    } else if (std::strcmp(argv[i], "--depth") == 0 && i + 1 < argc) {
+      config.depth_levels = std::stoul(argv[++i]);
+    } else if (std::strcmp(argv[i], "--conflate") == 0 && i + 1 < argc) {
+      config.conflate_commands = static_cast<uint32_t>(std::stoul(argv[++i]));
+    } else if (std::strcmp(argv[i], "--conflate-ns") == 0 && i + 1 < argc) {
+      config.conflate_ns = std::stoull(argv[++i]);
+    } else if (std::strcmp(argv[i], "--l3") == 0) {
+      config.order_events = true;
+    } else if (std::strcmp(argv[i], "--aggregate-trades") == 0) {
+      config.aggregate_trades = true;
+    } else if (std::strncmp(argv[i], "--wait", 6) == 0) {
+      const char *stage = argv[i] + 6;
+      bool all = *stage == '\0';
+      bool feed = std::strcmp(stage, "-feed") == 0;
+      bool engine = std::strcmp(stage, "-engine") == 0;
+      bool publisher = std::strcmp(stage, "-publisher") == 0;
+      if (!(all || feed || engine || publisher)) {
+        std::cerr << "Error: unknown option " << argv[i] << "\n";
+        print_usage(argv[0]);
+        return 1;
+      }
+      if (i + 1 >= argc) {
+        std::cerr << "Error: " << argv[i] << " needs a wait mode\n";
+        print_usage(argv[0]);
+        return 1;
+      }
+      WaitMode mode;
+      if (!parse_wait_mode(argv[i + 1], mode)) {
+        std::cerr << "Error: unknown wait mode " << argv[i + 1] << "\n";
+        return 1;
+      }
+      if (all || feed)
+        config.feed_wait = mode;
+      if (all || engine)
+        config.engine_wait = mode;
+      if (all || publisher)
+        config.publisher_wait = mode;
+      ++i;
     } else if (std::strcmp(argv[i], "--help") == 0) {
       print_usage(argv[0]);
       return 0;
@@ -84,32 +182,92 @@ int main(int argc, char *argv[]) {
   std::cout << "Initializing Hyperliquid Engine...\n";
   TimestampUtil::calibrate();
 
+  // Engine workers: one per engine core, otherwise what the machine has
+  // left after the feed handler and publisher, never more than symbols
+  size_t num_engines = config.cpu_cores.size();
+  if (num_engines == 0) {
+    num_engines = config.engines;
+  }
+  if (num_engines == 0) {
+    unsigned hw = std::thread::hardware_concurrency();
+    num_engines = hw > 3 ? hw - 2 : 1;
+  }
+  if (config.symbol_map.empty()) {
+    num_engines = std::min(num_engines, config.symbols.size());
+  }
+
+  // Symbol to engine assignment, indexed by symbol_id
+  SymbolAssignment assignment;
+  if (!config.symbol_map.empty()) {
+    std::ifstream map(config.symbol_map);
+    std::string error;
+    if (!map) {
+      std::cerr << "Error: cannot open " << config.symbol_map << "\n";
+      return 1;
+    }
+    if (!parse_symbol_map(map, config.symbols, num_engines, assignment,
+                          error)) {
+      std::cerr << "Error: " << config.symbol_map << ": " << error << "\n";
+      return 1;
+    }
+  } else if (config.assign == "load") {
+    std::vector<uint64_t> load =
+        FeedHandler::symbol_load(config.input_file, config.symbols.size());
+    if (load.empty()) {
+      load.assign(config.symbols.size(), 0);
+    }
+    assignment = assign_by_load(load, num_engines);
+  } else {
+    assignment = assign_round_robin(config.symbols.size(), num_engines);
+  }
+
   // Queues
   // We allocate them on heap to avoid stack overflow or moving issues,
   // although vectors of unique_ptrs would be better, raw pointers for SPSCQueue
   // are common in low-latency code to strictly control layout. Here we use
   // vector of pointers.
   std::vector<SPSCQueue<OrderCommand, 65536> *> input_queues;
-  std::vector<SPSCQueue<AnyEvent, 65536> *> output_queues;
+  std::vector<MatchingEngine::OutputQueue *> output_queues;
+  // Wake-ups for parked stages: one per engine input, one for the publisher
+  std::vector<Doorbell *> engine_bells;
+  Doorbell publisher_bell;
 
-  // We need as many input queues as symbols
-  // The feed handler will dispatch by symbol_id (index in vector)
-  for (size_t i = 0; i < config.symbols.size(); ++i) {
+  // One pair of queues per engine, shared by the symbols it matches
+  for (size_t i = 0; i < num_engines; ++i) {
     input_queues.push_back(new SPSCQueue<OrderCommand, 65536>());
-    output_queues.push_back(new SPSCQueue<AnyEvent, 65536>());
+    output_queues.push_back(new MatchingEngine::OutputQueue());
+    engine_bells.push_back(new Doorbell());
   }
 
   // Components
   std::vector<std::unique_ptr<MatchingEngine>> engines;
 
   // Create Engines
-  // Create Engines
-  for (size_t i = 0; i < config.symbols.size(); ++i) {
+  for (size_t i = 0; i < num_engines; ++i) {
+    std::vector<SymbolId> symbols;
+    std::string names;
+    for (size_t s = 0; s < assignment.size(); ++s) {
+      if (assignment[s] == i) {
+        symbols.push_back(static_cast<SymbolId>(s));
+        names += (names.empty() ? "" : ",") + config.symbols[s];
+      }
+    }
+    std::cout << "Engine " << i << ": " << names << "\n";
+
     MatchingEngine::Config engine_config{
-        .symbol_id = static_cast<SymbolId>(i),
+        .engine_id = static_cast<uint32_t>(i),
+        .symbols = std::move(symbols),
         .price_band = PriceBand(config.min_price, config.max_price),
         .input_queue = input_queues[i],
-        .output_queue = output_queues[i]};
+        .output_queue = output_queues[i],
+        .order_events = config.order_events,
+        .depth_levels = config.depth_levels,
+        .conflate_commands = config.conflate_commands,
+        .conflate_ns = config.conflate_ns,
+        .aggregate_trades = config.aggregate_trades,
+        .wait = config.engine_wait,
+        .input_bell = engine_bells[i],
+        .output_bell = &publisher_bell};
 
     engines.push_back(std::make_unique<MatchingEngine>(engine_config));
   }
@@ -117,44 +275,61 @@ int main(int argc, char *argv[]) {
   // Create Feed Handler
   FeedHandler::Config fh_config;
   fh_config.input_file = config.input_file;
-  fh_config.param_queues = input_queues;
+  // The feed handler dispatches by symbol_id (index in these vectors)
+  for (uint32_t engine : assignment) {
+    fh_config.param_queues.push_back(input_queues[engine]);
+    fh_config.bells.push_back(engine_bells[engine]);
+  }
+  // A symbol map may leave engines without symbols; they still need their
+  // EndOfStream
+  fh_config.engine_queues = input_queues;
+  fh_config.engine_bells = engine_bells;
+  fh_config.wait = config.feed_wait;
   auto feed_handler = std::make_unique<FeedHandler>(fh_config);
 
   // Create Publisher
   Publisher::Config pub_config;
   pub_config.output_dir = config.output_dir;
-  pub_config.input_queues = output_queues;
+  // Further consumers of the events (risk, fan-out) subscribe here too,
+  // before the threads start
+  for (auto *ring : output_queues) {
+    pub_config.inputs.push_back(ring->subscribe());
+  }
+  pub_config.wait = config.publisher_wait;
+  pub_config.bell = &publisher_bell;
   auto publisher = std::make_unique<Publisher>(pub_config);
 
   std::cout << "Starting " << engines.size() << " matching engines...\n";
 
-  // Launch threads
+  // Launch threads; the run ends once the publisher has written the last
+  // engine's StreamEnd
   std::vector<std::thread> threads;
+  auto start = std::chrono::steady_clock::now();
 
-  // 1. Publisher (Core N+1)
+  // 1. Publisher
   threads.emplace_back([&]() {
-    if (config.cpu_cores.size() > config.symbols.size() + 1) {
-      pin_this_thread(config.cpu_cores.back());
+    if (config.publisher_core >= 0) {
+      pin_this_thread(config.publisher_core);
     }
     publisher->run();
   });
 
-  // 2. Engines (Cores 1..N)
+  // 2. Engines, one per engine core
   for (size_t i = 0; i < engines.size(); ++i) {
     threads.emplace_back([&, i]() {
-      if (config.cpu_cores.size() > i + 1) {
-        pin_this_thread(config.cpu_cores[i + 1]);
+      if (i < config.cpu_cores.size()) {
+        pin_this_thread(config.cpu_cores[i]);
       }
       engines[i]->run();
     });
   }
 
-  // 3. Feed Handler (Core 0)
+  // 3. Feed Handler
   // We run this in the main thread or a separate thread. Let's spawn a thread
   // to keep main clean.
   threads.emplace_back([&]() {
-    if (!config.cpu_cores.empty()) {
-      pin_this_thread(config.cpu_cores[0]);
+    if (config.feed_core >= 0) {
+      pin_this_thread(config.feed_core);
     }
     feed_handler->run();
   });
@@ -164,12 +339,48 @@ int main(int argc, char *argv[]) {
     if (t.joinable())
       t.join();
   }
+  double secs = std::chrono::duration<double>(
+                    std::chrono::steady_clock::now() - start)
+                    .count();
+
+  uint64_t commands = feed_handler->stats().items;
+  uint64_t events = publisher->stats().items;
+  std::cout << "\nPipeline finished in " << std::fixed << std::setprecision(3)
+            << secs * 1e3 << " ms\n"
+            << "  " << commands << " commands, " << std::setprecision(0)
+            << commands / secs << " commands/sec end to end\n"
+            << "  " << events << " events, " << events / secs
+            << " events/sec\n\n";
+  std::cout << std::left << std::setw(14) << "Stage" << std::right
+            << std::setw(12) << "items" << std::setw(12) << "busy ms"
+            << std::setw(12) << "idle ms" << std::setw(10) << "busy"
+            << "\n";
+  print_stage("feed", feed_handler->stats());
+  for (size_t i = 0; i < engines.size(); ++i) {
+    print_stage("engine " + std::to_string(i), engines[i]->stats());
+  }
+  print_stage("publisher", publisher->stats());
+
+  // Book updates each engine could have sent, and how many conflation or
+  // an unchanged top of book held back
+  std::cout << "\n"
+            << std::left << std::setw(14) << "Book updates" << std::right
+            << std::setw(12) << "requested" << std::setw(12) << "published"
+            << std::setw(12) << "suppressed" << "\n";
+  for (size_t i = 0; i < engines.size(); ++i) {
+    BookUpdateStats bbo = engines[i]->book_update_stats();
+    std::cout << std::left << std::setw(14) << "engine " + std::to_string(i)
+              << std::right << std::setw(12) << bbo.requested << std::setw(12)
+              << bbo.published << std::setw(12) << bbo.suppressed() << "\n";
+  }
 
   // Cleanup
   for (auto *q : input_queues)
     delete q;
   for (auto *q : output_queues)
     delete q;
+  for (auto *b : engine_bells)
+    delete b;
 
   return 0;
 }
@@ -1,74 +1,169 @@
 #include "hyperliquid/matching_engine.h"
 #include "hyperliquid/timestamp.h"
+#include <chrono>
 #include <iostream>
-#include <thread>
+#include <span>
 
 namespace hyperliquid {
 
-MatchingEngine::MatchingEngine(const Config &config) : config_(config) {
-  // Initialize price levels with the provided band
-  PriceLevelsArray bids(config.price_band);
-  PriceLevelsArray asks(config.price_band);
+MatchingEngine::MatchingEngine(const Config &config)
+    : config_(config), wait_(config.wait, config.input_bell) {
+  for (SymbolId symbol : config.symbols) {
+    // Initialize price levels with the provided band
+    // Levels are committed lazily, so wide bands only cost what is used
+    PriceLevelsLazyArray bids(config.price_band);
+    PriceLevelsLazyArray asks(config.price_band);
 
-  // Create order book
-  order_book_ = std::make_unique<OrderBook<PriceLevelsArray>>(
-      config.symbol_id, std::move(bids), std::move(asks));
+    // Create order book; events of all books are pushed straight into the
+    // one output queue, which only this thread produces to
+    auto book = std::make_unique<Book>(
+        symbol, std::move(bids), std::move(asks),
+        QueueSink<OutputQueue>(config.output_queue, config.order_events,
+                               config.wait));
+    book->enable_depth(config.depth_levels);
+    book->set_book_update_conflation(config.conflate_commands > 0 ||
+                                     config.conflate_ns > 0);
+    book->set_aggregate_trades(config.aggregate_trades);
 
-  // Bind callbacks
-  // We use raw 'this' because MatchingEngine strictly outlives OrderBook
-  order_book_->set_on_trade(
-      [this](const TradeEvent &trade) { this->process_trade(trade); });
+    if (symbol >= by_symbol_.size()) {
+      by_symbol_.resize(symbol + 1, nullptr);
+    }
+    by_symbol_[symbol] = book.get();
+    books_.push_back(std::move(book));
+  }
+}
 
-  order_book_->set_on_book_update(
-      [this](const BookUpdate &update) { this->process_book_update(update); });
+BookUpdateStats MatchingEngine::book_update_stats() const {
+  BookUpdateStats total;
+  for (const auto &book : books_) {
+    total.requested += book->book_update_stats().requested;
+    total.published += book->book_update_stats().published;
+  }
+  return total;
 }
 
 void MatchingEngine::run() {
-  // Warmup or calibration?
+  auto start = std::chrono::steady_clock::now();
+
+  OrderCommand batch[MAX_BATCH];
+  uint32_t idle_spins = 0;
+
+  // Conflation window, counted in commands and in TSC cycles
+  uint32_t since_flush = 0;
+  uint64_t slice_cycles = TimestampUtil::ns_to_cycles(config_.conflate_ns);
+  uint64_t slice_start = TimestampUtil::rdtsc();
 
-  OrderCommand cmd;
   while (true) {
-    // Spin wait for command
-    while (!config_.input_queue->pop(cmd)) {
-      std::this_thread::yield();
-      // TODO: Check for shutdown signal?
-      // For now, infinite loop until process death.
+    // Drain what is queued, up to a batch, releasing it in one step
+    size_t n = config_.input_queue->pop_n(std::span<OrderCommand>(batch));
+    // Nothing follows an EndOfStream, so it can only end the batch
+    bool ended = n > 0 && batch[n - 1].type == CommandType::EndOfStream;
+    if (ended) {
+      --n;
+    }
+    for (size_t i = 0; i < n; ++i) {
+      if (batch[i].recv_ts > now_) {
+        now_ = batch[i].recv_ts;
+      }
     }
 
-    // Process command
-    switch (cmd.type) {
-    case CommandType::NewOrder:
-      if (cmd.order_type == OrderType::Limit) {
-        order_book_->submit_limit(cmd);
-      } else {
-        order_book_->submit_market(cmd);
+    if (n == 0 && !ended) {
+      // Nothing more to conflate with, publish what is pending
+      flush_book_updates();
+      since_flush = 0;
+      for (auto &book : books_) {
+        if (book->has_expiring_orders()) {
+          book->expire_orders(clock());
+        }
       }
-      break;
-    case CommandType::CancelOrder:
-      order_book_->cancel(cmd.order_id);
-      break;
-    case CommandType::ModifyOrder:
-      // TODO: Implement modify
-      order_book_->modify(cmd.order_id, cmd.price_ticks, cmd.qty);
+      if (config_.output_bell) {
+        config_.output_bell->ring();
+      }
+      // GTD expiry needs the loop to come back, so parks time out
+      wait_.idle([this] { return !config_.input_queue->empty(); });
+      // Give back memory of long-empty price levels while idle
+      if (++idle_spins == TRIM_IDLE_SPINS) {
+        for (auto &book : books_) {
+          book->trim_idle_levels(TRIM_IDLE_EPOCHS);
+        }
+        idle_spins = 0;
+      }
+      continue;
+    }
+
+    wait_.reset();
+
+    // Each run of one symbol's commands is one batch of its book, with one
+    // book update for the run; GTD orders due by each command's recv_ts
+    // expire before it
+    for (size_t i = 0; i < n;) {
+      SymbolId symbol = batch[i].symbol_id;
+      size_t run = 1;
+      while (i + run < n && batch[i + run].symbol_id == symbol) {
+        ++run;
+      }
+      // Commands of symbols this engine does not own are dropped
+      if (Book *book = book_for(symbol)) {
+        book->submit_batch(std::span<const OrderCommand>(batch + i, run));
+        stats_.items += run;
+
+        // Expire due GTD orders; a single branch while none are resting
+        if (book->has_expiring_orders()) {
+          book->expire_orders(clock());
+        }
+      }
+      i += run;
+    }
+
+    since_flush += static_cast<uint32_t>(n);
+    if (config_.conflate_commands > 0 &&
+        since_flush >= config_.conflate_commands) {
+      flush_book_updates();
+      since_flush = 0;
+    }
+    if (slice_cycles > 0) {
+      uint64_t now = TimestampUtil::rdtsc();
+      if (now - slice_start >= slice_cycles) {
+        flush_book_updates();
+        slice_start = now;
+      }
+    }
+    if (ended) {
+      end_stream();
       break;
     }
+    if (config_.output_bell) {
+      config_.output_bell->ring();
+    }
+  }
+
+  stats_.wall_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+  // Waits on a full output queue count as idle too
+  stats_.idle_ns = wait_.idle_ns();
+  for (auto &book : books_) {
+    stats_.idle_ns += book->sink().stall_ns();
   }
 }
 
-void MatchingEngine::process_trade(const TradeEvent &trade) {
-  // Enqueue trade event
-  AnyEvent evt(trade);
-  while (!config_.output_queue->push(evt)) {
-    // Spin if output full
-    std::this_thread::yield();
+void MatchingEngine::flush_book_updates() {
+  for (auto &book : books_) {
+    book->flush_book_update();
   }
 }
 
-void MatchingEngine::process_book_update(const BookUpdate &update) {
-  // Enqueue book update
-  AnyEvent evt(update);
-  while (!config_.output_queue->push(evt)) {
-    std::this_thread::yield();
+void MatchingEngine::end_stream() {
+  flush_book_updates();
+  StreamEnd end;
+  end.ts = now_;
+  end.engine_id = config_.engine_id;
+  end.commands = stats_.items;
+  // Any sink will do, they all push to the output queue
+  QueueSink<OutputQueue> sink(config_.output_queue, false, config_.wait);
+  sink.on_stream_end(end);
+  if (config_.output_bell) {
+    config_.output_bell->ring();
   }
 }
 
@@ -1,5 +1,9 @@
 #include <hyperliquid/order_book.h>
+#include <hyperliquid/price_levels_window.h>
 #include <hyperliquid/timestamp.h>
 
 // Explicit template instantiation for array-based price levels
 template class hyperliquid::OrderBook<hyperliquid::PriceLevelsArray>;
+
+// Explicit template instantiation for sliding-window price levels
+template class hyperliquid::OrderBook<hyperliquid::PriceLevelsWindow>;
@@ -1,21 +1,26 @@
 #include "hyperliquid/publisher.h"
+#include <chrono>
 #include <filesystem>
 #include <iostream>
-#include <thread>
 
 namespace hyperliquid {
 
 Publisher::Publisher(const Config &config)
-    : queues_(config.input_queues), output_dir_(config.output_dir) {
+    : inputs_(config.inputs), output_dir_(config.output_dir),
+      wait_(config.wait, config.bell) {
 
   // Ensure output directory exists
   std::filesystem::create_directories(output_dir_);
 
   std::string trades_path = output_dir_ + "/trades.bin";
   std::string book_path = output_dir_ + "/book_updates.bin";
+  std::string orders_path = output_dir_ + "/orders.bin";
+  std::string depth_path = output_dir_ + "/depth.bin";
 
   trades_log_.open(trades_path, std::ios::binary | std::ios::out);
   book_updates_log_.open(book_path, std::ios::binary | std::ios::out);
+  orders_log_.open(orders_path, std::ios::binary | std::ios::out);
+  depth_log_.open(depth_path, std::ios::binary | std::ios::out);
 
   if (!trades_log_) {
     std::cerr << "Publisher: Failed to open " << trades_path << "\n";
@@ -23,41 +28,86 @@ Publisher::Publisher(const Config &config)
   if (!book_updates_log_) {
     std::cerr << "Publisher: Failed to open " << book_path << "\n";
   }
+  if (!orders_log_) {
+    std::cerr << "Publisher: Failed to open " << orders_path << "\n";
+  }
+  if (!depth_log_) {
+    std::cerr << "Publisher: Failed to open " << depth_path << "\n";
+  }
 }
 
 void Publisher::run() {
   std::cout << "Publisher listener started...\n";
+  auto start = std::chrono::steady_clock::now();
 
-  AnyEvent evt;
   bool work_done;
   uint64_t total_events = 0;
 
-  while (true) {
+  // Each engine ends its ring with one StreamEnd, so once all have been
+  // read every input is drained
+  while (ended_ < inputs_.size()) {
     work_done = false;
 
-    // Round-robin poll all queues
-    for (auto *queue : queues_) {
-      while (queue->pop(evt)) {
+    // Round-robin poll all inputs, reading events in place and releasing
+    // each drained run at once
+    for (auto &input : inputs_) {
+      size_t n = input.consume(
+          [this](const AnyEvent &evt) { write_event(evt); }, MAX_DRAIN);
+      if (n > 0) {
         work_done = true;
-        total_events++;
-
-        if (evt.type == EventType::Trade) {
-          trades_log_.write(reinterpret_cast<const char *>(&evt.trade),
-                            sizeof(TradeEvent));
-        } else {
-          book_updates_log_.write(
-              reinterpret_cast<const char *>(&evt.book_update),
-              sizeof(BookUpdate));
-        }
+        total_events += n;
       }
     }
 
-    if (!work_done) {
-      // If all queues empty, yield
-      std::this_thread::yield();
+    if (work_done) {
+      wait_.reset();
+    } else {
+      wait_.idle([this] {
+        for (const auto &input : inputs_) {
+          if (!input.empty()) {
+            return true;
+          }
+        }
+        return false;
+      });
     }
+  }
+
+  trades_log_.flush();
+  book_updates_log_.flush();
+  orders_log_.flush();
+  depth_log_.flush();
+
+  // The StreamEnd markers are not part of the output
+  stats_.items = total_events - ended_;
+  stats_.wall_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+  stats_.idle_ns = wait_.idle_ns();
+  std::cout << "Publisher: Finished. Total events: " << stats_.items << "\n";
+}
 
-    // TODO: Periodic flush or shutdown check
+void Publisher::write_event(const AnyEvent &evt) {
+  switch (evt.type) {
+  case EventType::Trade:
+    trades_log_.write(reinterpret_cast<const char *>(&evt.trade),
+                      sizeof(TradeEvent));
+    break;
+  case EventType::BookUpdate:
+    book_updates_log_.write(reinterpret_cast<const char *>(&evt.book_update),
+                            sizeof(BookUpdate));
+    break;
+  case EventType::Order:
+    orders_log_.write(reinterpret_cast<const char *>(&evt.order),
+                      sizeof(OrderEvent));
+    break;
+  case EventType::Depth:
+    depth_log_.write(reinterpret_cast<const char *>(&evt.depth),
+                     sizeof(DepthUpdate));
+    break;
+  case EventType::EndOfStream:
+    ++ended_;
+    break;
   }
 }
 
@@ -1,8 +1,12 @@
 /// Tests for advanced order types: GTD, Iceberg, and Stop orders
 
+#include <cstddef>
 #include <gtest/gtest.h>
 #include <hyperliquid/order_book.h>
 #include <hyperliquid/price_levels_array.h>
+#include <hyperliquid/timing_wheel.h>
+#include <utility>
+#include <vector>
 
 using namespace hyperliquid;
 
@@ -17,13 +21,27 @@ protected:
   std::unique_ptr<OrderBook<PriceLevelsArray>> book_;
 };
 
+static OrderCommand order(OrderId id, Side side, OrderType type, Tick px,
+                          Quantity qty, Tick stop_px = 0) {
+  OrderCommand cmd{};
+  cmd.order_id = id;
+  cmd.user_id = static_cast<UserId>(id);
+  cmd.price_ticks = px;
+  cmd.stop_price = stop_px;
+  cmd.qty = qty;
+  cmd.side = side;
+  cmd.order_type = type;
+  cmd.tif = TimeInForce::GTC;
+  cmd.flags = stop_px ? OrderFlags::STOP : OrderFlags::NONE;
+  return cmd;
+}
+
 // =============================================================================
 // GTD (Good-Till-Date) Tests
 // =============================================================================
 
 TEST_F(AdvancedOrdersTest, GTDOrderWithExpiry) {
-  // Note: GTD expiry checking would typically be done in matching engine loop
-  // This test verifies the fields are properly set
+  // Expiry is driven by expire_orders(), see GTDOrdersExpireOnTime
 
   OrderCommand cmd{};
   cmd.order_id = 1;
@@ -45,6 +63,121 @@ TEST_F(AdvancedOrdersTest, GTDTimeInForceEnumValue) {
   EXPECT_STREQ(to_string(TimeInForce::GTD), "GTD");
 }
 
+TEST(TimingWheelTest, FiresAtExpiryAcrossLevels) {
+  TimingWheel wheel(0); // 1 ns ticks
+  // one timer per level plus one beyond the 2^32 tick horizon
+  const Timestamp expiries[] = {5, 300, 70000, 20000000, (1ULL << 33) + 7};
+  for (size_t i = 0; i < 5; ++i)
+    wheel.schedule(i, expiries[i]);
+  EXPECT_EQ(wheel.size(), 5u);
+
+  std::vector<Timestamp> fired;
+  auto record = [&](OrderId, Timestamp expiry) { fired.push_back(expiry); };
+  for (size_t i = 0; i < 5; ++i) {
+    // nothing fires a tick early, the timer fires on its tick
+    wheel.advance(expiries[i] - 1, record);
+    EXPECT_EQ(fired.size(), i);
+    EXPECT_EQ(wheel.advance(expiries[i], record), 1u);
+    EXPECT_EQ(fired.back(), expiries[i]);
+  }
+  EXPECT_TRUE(wheel.empty());
+}
+
+TEST(TimingWheelTest, PastExpiryFiresOnNextAdvance) {
+  TimingWheel wheel(10);
+  std::vector<OrderId> fired;
+  auto record = [&](OrderId id, Timestamp) { fired.push_back(id); };
+  wheel.advance(1 << 20, record);
+  wheel.schedule(1, 1000);
+  wheel.schedule(2, (1 << 20) + 1); // rounds up to the next tick
+  EXPECT_TRUE(wheel.due(1 << 20));
+  EXPECT_EQ(wheel.advance(1 << 20, record), 1u);
+  EXPECT_EQ(fired, std::vector<OrderId>{1});
+  EXPECT_FALSE(wheel.due((1 << 20) + 1023));
+  EXPECT_EQ(wheel.advance((1 << 20) + 1024, record), 1u);
+  EXPECT_EQ(fired.back(), 2u);
+}
+
+TEST(TimingWheelTest, CancelUnlinksInConstantTime) {
+  TimingWheel wheel(0);
+  std::vector<OrderId> fired;
+  auto record = [&](OrderId id, Timestamp) { fired.push_back(id); };
+  // same slot, other levels and the due list
+  WheelTimer *a = wheel.schedule(1, 100);
+  WheelTimer *b = wheel.schedule(2, 100);
+  wheel.schedule(3, 100);
+  WheelTimer *far = wheel.schedule(4, 1 << 20);
+  WheelTimer *due = wheel.schedule(5, 0);
+  wheel.cancel(b);
+  wheel.cancel(far);
+  wheel.cancel(due);
+  wheel.cancel(a);
+  EXPECT_EQ(wheel.size(), 1u);
+  EXPECT_EQ(wheel.advance(1 << 21, record), 1u);
+  EXPECT_EQ(fired, std::vector<OrderId>{3});
+  EXPECT_TRUE(wheel.empty());
+}
+
+TEST_F(AdvancedOrdersTest, GTDTimersLeaveWithTheirOrders) {
+  // cancel-heavy flow of long-dated GTD orders leaves no timers behind
+  OrderCommand cmd = order(0, Side::Bid, OrderType::Limit, 150, 10);
+  cmd.tif = TimeInForce::GTD;
+  cmd.expiry_ts = Timestamp{1} << 50;
+  for (OrderId id = 1; id <= 1000; ++id) {
+    cmd.order_id = id;
+    book_->submit_limit(cmd);
+    if (id % 2 == 0)
+      book_->cancel(id);
+  }
+  // the other half trades away
+  book_->submit_market(order(5000, Side::Ask, OrderType::Market, 0, 5000));
+  EXPECT_FALSE(book_->has_expiring_orders());
+}
+
+TEST_F(AdvancedOrdersTest, GTDOrdersExpireOnTime) {
+  auto gtd = [&](OrderId id, Tick px, Timestamp expiry) {
+    OrderCommand cmd{};
+    cmd.order_id = id;
+    cmd.user_id = 100;
+    cmd.price_ticks = px;
+    cmd.qty = 10;
+    cmd.side = Side::Bid;
+    cmd.order_type = OrderType::Limit;
+    cmd.tif = expiry ? TimeInForce::GTD : TimeInForce::GTC;
+    cmd.expiry_ts = expiry;
+    cmd.recv_ts = 1'000'000'000;
+    book_->submit_limit(cmd);
+  };
+  gtd(1, 150, 2'000'000'000);
+  gtd(2, 149, 3'000'000'000);
+  gtd(3, 148, 2'000'000'000);
+  gtd(4, 147, 0); // GTC
+  book_->cancel(3);
+  EXPECT_TRUE(book_->has_expiring_orders());
+
+  std::vector<OrderId> deleted;
+  std::vector<Timestamp> deleted_ts;
+  book_->set_on_order([&](const OrderEvent &e) {
+    if (e.kind == OrderEventKind::Deleted) {
+      deleted.push_back(e.order_id);
+      deleted_ts.push_back(e.ts);
+    }
+  });
+
+  // expiry rounds up to the wheel's ~1 ms tick, never down
+  EXPECT_EQ(book_->expire_orders(1'999'999'999), 0u);
+  EXPECT_EQ(book_->best_bid(), 150);
+  // the cancelled order's timer left the wheel with it
+  EXPECT_EQ(book_->expire_orders(2'001'000'000), 1u);
+  EXPECT_EQ(deleted, std::vector<OrderId>{1});
+  // stamped with the order's expiry, not the wall clock
+  EXPECT_EQ(deleted_ts, std::vector<Timestamp>{2'000'000'000});
+  EXPECT_EQ(book_->best_bid(), 149);
+  EXPECT_EQ(book_->expire_orders(5'000'000'000), 1u);
+  EXPECT_EQ(book_->best_bid(), 147);
+  EXPECT_FALSE(book_->has_expiring_orders());
+}
+
 // =============================================================================
 // Iceberg Order Tests
 // =============================================================================
@@ -66,6 +199,41 @@ TEST_F(AdvancedOrdersTest, IcebergOrderFlagsAreSet) {
   EXPECT_EQ(book_->best_bid(), 150);
 }
 
+TEST_F(AdvancedOrdersTest, IcebergShowsSliceAndRefillsAtBack) {
+  OrderCommand ice = order(1, Side::Bid, OrderType::Limit, 150, 25);
+  ice.flags = OrderFlags::ICEBERG;
+  ice.display_qty = 10;
+  book_->submit_limit(ice);
+  book_->submit_limit(order(2, Side::Bid, OrderType::Limit, 150, 5));
+  book_->enable_depth(1);
+
+  auto visible = [&] {
+    DepthLevel lvl{};
+    book_->depth_snapshot(Side::Bid, &lvl, 1);
+    return lvl.qty;
+  };
+  EXPECT_EQ(visible(), 15);
+
+  std::vector<std::pair<OrderId, Quantity>> fills;
+  book_->set_on_trade(
+      [&](const TradeEvent &t) { fills.emplace_back(t.maker_id, t.qty); });
+
+  // The refilled slice queues behind order 2
+  book_->submit_market(order(3, Side::Ask, OrderType::Market, 0, 12));
+  EXPECT_EQ(fills, (std::vector<std::pair<OrderId, Quantity>>{{1, 10},
+                                                              {2, 2}}));
+  EXPECT_EQ(visible(), 13);
+  EXPECT_EQ(book_->order_extras(1)->hidden_qty, 5);
+
+  // A single taker runs through the refill when nothing else rests
+  fills.clear();
+  book_->submit_market(order(4, Side::Ask, OrderType::Market, 0, 20));
+  EXPECT_EQ(fills, (std::vector<std::pair<OrderId, Quantity>>{
+                       {2, 3}, {1, 10}, {1, 5}}));
+  EXPECT_EQ(book_->best_bid(), Sentinel::EMPTY_BID);
+  EXPECT_EQ(book_->order_extras(1), nullptr);
+}
+
 TEST_F(AdvancedOrdersTest, IcebergFlagValue) {
   EXPECT_EQ(OrderFlags::ICEBERG, 1 << 3);
   EXPECT_EQ(OrderFlags::ICEBERG, 8);
@@ -104,48 +272,271 @@ TEST_F(AdvancedOrdersTest, StopOrderCommandFields) {
   EXPECT_TRUE((cmd.flags & OrderFlags::STOP) != 0);
 }
 
+TEST_F(AdvancedOrdersTest, StopWaitsForLastTradePrice) {
+  book_->submit_limit(order(1, Side::Ask, OrderType::Limit, 150, 10));
+  book_->submit_limit(order(2, Side::Ask, OrderType::Limit, 151, 10));
+  // No trade yet, so nothing to trigger on
+  book_->submit_stop(order(3, Side::Bid, OrderType::StopMarket, 0, 5, 151));
+  EXPECT_EQ(book_->pending_stops(), 1u);
+
+  std::vector<TradeEvent> trades;
+  book_->set_on_trade([&](const TradeEvent &t) { trades.push_back(t); });
+
+  book_->submit_market(order(4, Side::Bid, OrderType::Market, 0, 10));
+  EXPECT_EQ(book_->last_trade_px(), 150);
+  EXPECT_EQ(book_->pending_stops(), 1u);
+
+  // A trade at the stop price fires it within the same command
+  book_->submit_market(order(5, Side::Bid, OrderType::Market, 0, 1));
+  ASSERT_EQ(trades.size(), 3u);
+  EXPECT_EQ(trades[2].taker_id, 3u);
+  EXPECT_EQ(trades[2].price_ticks, 151);
+  EXPECT_EQ(trades[2].qty, 5);
+  EXPECT_EQ(book_->pending_stops(), 0u);
+}
+
+TEST_F(AdvancedOrdersTest, MassCancelIncludesPendingStops) {
+  book_->submit_limit(order(1, Side::Ask, OrderType::Limit, 150, 10));
+  book_->submit_limit(order(2, Side::Ask, OrderType::Limit, 151, 10));
+  auto stop = [&](OrderId id, UserId user, Tick stop_px) {
+    OrderCommand cmd =
+        order(id, Side::Bid, OrderType::StopMarket, 0, 1, stop_px);
+    cmd.user_id = user;
+    book_->submit_stop(cmd);
+  };
+  stop(10, 7, 150);
+  stop(11, 7, 151);
+  stop(12, 8, 150);
+  ASSERT_EQ(book_->pending_stops(), 3u);
+
+  // the price filter applies to the stop price
+  OrderCommand mc{};
+  mc.type = CommandType::MassCancel;
+  mc.user_id = 7;
+  mc.flags = MassCancelFlags::BY_PRICE;
+  mc.price_ticks = 151;
+  mc.stop_price = 160;
+  EXPECT_EQ(book_->mass_cancel(mc), 1u);
+  EXPECT_FALSE(book_->cancel(11));
+  EXPECT_EQ(book_->mass_cancel(7), 1u);
+  EXPECT_EQ(book_->pending_stops(), 1u);
+
+  // only the other user's stop is left to fire
+  std::vector<OrderId> takers;
+  book_->set_on_trade(
+      [&](const TradeEvent &t) { takers.push_back(t.taker_id); });
+  book_->submit_market(order(5, Side::Bid, OrderType::Market, 0, 1));
+  EXPECT_EQ(takers, (std::vector<OrderId>{5, 12}));
+  EXPECT_EQ(book_->pending_stops(), 0u);
+}
+
+TEST_F(AdvancedOrdersTest, StopsCascadeInOnePass) {
+  for (Tick px = 150; px >= 146; --px)
+    book_->submit_limit(
+        order(static_cast<OrderId>(px), Side::Bid, OrderType::Limit, px, 10));
+  // Each sell stop sweeps the level under it, reaching the next stop
+  book_->submit_stop(order(1, Side::Ask, OrderType::StopMarket, 0, 10, 149));
+  book_->submit_stop(order(2, Side::Ask, OrderType::StopLimit, 147, 10, 148));
+  book_->submit_stop(order(3, Side::Ask, OrderType::StopMarket, 0, 10, 140));
+  // Cancelled before its trigger, never fires
+  book_->submit_stop(order(4, Side::Ask, OrderType::StopMarket, 0, 50, 147));
+  EXPECT_TRUE(book_->cancel(4));
+  EXPECT_EQ(book_->pending_stops(), 3u);
+
+  std::vector<OrderId> takers;
+  book_->set_on_trade(
+      [&](const TradeEvent &t) { takers.push_back(t.taker_id); });
+
+  book_->submit_market(order(5, Side::Ask, OrderType::Market, 0, 20));
+  EXPECT_EQ(takers, (std::vector<OrderId>{5, 5, 1, 2}));
+  EXPECT_EQ(book_->last_trade_px(), 147);
+  EXPECT_EQ(book_->best_bid(), 146);
+  EXPECT_EQ(book_->pending_stops(), 1u);
+  EXPECT_FALSE(book_->cancel(4));
+}
+
+TEST_F(AdvancedOrdersTest, StopLimitRestsAfterTrigger) {
+  book_->submit_limit(order(1, Side::Ask, OrderType::Limit, 150, 5));
+  book_->submit_stop(order(2, Side::Bid, OrderType::StopLimit, 149, 5, 150));
+  book_->submit_market(order(3, Side::Bid, OrderType::Market, 0, 5));
+  // Triggered at 150, but its 149 limit no longer crosses
+  EXPECT_EQ(book_->pending_stops(), 0u);
+  EXPECT_EQ(book_->best_bid(), 149);
+  EXPECT_EQ(book_->order_extras(2), nullptr);
+}
+
+// =============================================================================
+// Self-Trade Prevention Tests
+// =============================================================================
+
+// Asks: 1 (user 7) 5@150, 2 (user 8) 5@150, 3 (user 7) 5@151
+static void rest_self_and_other(OrderBook<PriceLevelsArray> &book) {
+  OrderCommand ask = order(1, Side::Ask, OrderType::Limit, 150, 5);
+  ask.user_id = 7;
+  book.submit_limit(ask);
+  book.submit_limit(order(2, Side::Ask, OrderType::Limit, 150, 5));
+  ask = order(3, Side::Ask, OrderType::Limit, 151, 5);
+  ask.user_id = 7;
+  book.submit_limit(ask);
+}
+
+static OrderCommand self_buy(OrderId id, Quantity qty, uint32_t mode,
+                             TimeInForce tif = TimeInForce::GTC) {
+  OrderCommand bid = order(id, Side::Bid, OrderType::Limit, 151, qty);
+  bid.user_id = 7;
+  bid.tif = tif;
+  bid.flags = OrderFlags::STP | mode;
+  return bid;
+}
+
+TEST_F(AdvancedOrdersTest, StpCancelOldestRemovesOwnOrders) {
+  rest_self_and_other(*book_);
+  auto result = book_->submit_limit(
+      self_buy(10, 12, OrderFlags::STP_CANCEL_OLDEST));
+  // Own orders 1 and 3 are cancelled, 2 trades, the rest no longer crosses
+  EXPECT_EQ(result.filled, 5);
+  EXPECT_EQ(result.remaining, 7);
+  EXPECT_EQ(book_->best_ask(), Sentinel::EMPTY_ASK);
+  EXPECT_EQ(book_->best_bid(), 151);
+  EXPECT_FALSE(book_->cancel(1));
+  EXPECT_FALSE(book_->cancel(3));
+}
+
+TEST_F(AdvancedOrdersTest, StpCancelNewestKillsTaker) {
+  rest_self_and_other(*book_);
+  auto result = book_->submit_limit(
+      self_buy(10, 12, OrderFlags::STP_CANCEL_NEWEST));
+  EXPECT_EQ(result.filled, 0);
+  EXPECT_EQ(result.remaining, 0);
+  EXPECT_EQ(book_->best_bid(), Sentinel::EMPTY_BID);
+  EXPECT_EQ(book_->sweep_cost(Side::Bid, 100).filled, 15);
+}
+
+TEST_F(AdvancedOrdersTest, StpCancelBothRemovesMakerAndTaker) {
+  rest_self_and_other(*book_);
+  auto result =
+      book_->submit_limit(self_buy(10, 12, OrderFlags::STP_CANCEL_BOTH));
+  EXPECT_EQ(result.filled, 0);
+  EXPECT_EQ(result.remaining, 0);
+  EXPECT_FALSE(book_->cancel(1));
+  EXPECT_EQ(book_->sweep_cost(Side::Bid, 100).filled, 10);
+}
+
+TEST_F(AdvancedOrdersTest, StpDecrementReducesBothSides) {
+  rest_self_and_other(*book_);
+  std::vector<OrderEvent> events;
+  book_->set_on_order([&](const OrderEvent &e) { events.push_back(e); });
+
+  // 3 of the taker meet order 1: both shrink by 3, no trade
+  auto result =
+      book_->submit_limit(self_buy(10, 3, OrderFlags::STP_DECREMENT));
+  EXPECT_EQ(result.filled, 0);
+  EXPECT_EQ(result.remaining, 0);
+  ASSERT_EQ(events.size(), 1u);
+  EXPECT_EQ(events[0].kind, OrderEventKind::Reduced);
+  EXPECT_EQ(events[0].order_id, 1u);
+  EXPECT_EQ(events[0].qty, 3);
+
+  // 2 more cancel what is left of 1, then 2 trades 5 and 3 decrements 3
+  result = book_->submit_limit(self_buy(11, 10, OrderFlags::STP_DECREMENT));
+  EXPECT_EQ(result.filled, 5);
+  EXPECT_EQ(result.remaining, 0);
+  EXPECT_EQ(book_->best_ask(), 151);
+  EXPECT_EQ(book_->sweep_cost(Side::Bid, 100).filled, 2);
+}
+
+TEST_F(AdvancedOrdersTest, FokAccountsForStp) {
+  rest_self_and_other(*book_);
+  // 15 rests on the asks but only 5 of it is tradeable for user 7
+  auto result = book_->submit_limit(
+      self_buy(10, 6, OrderFlags::STP_CANCEL_OLDEST, TimeInForce::FOK));
+  EXPECT_EQ(result.filled, 0);
+  EXPECT_EQ(result.remaining, 0);
+  EXPECT_EQ(book_->sweep_cost(Side::Bid, 100).filled, 15);
+
+  // Cancel-newest stops at order 1, before any liquidity
+  result = book_->submit_limit(
+      self_buy(11, 1, OrderFlags::STP_CANCEL_NEWEST, TimeInForce::FOK));
+  EXPECT_EQ(result.filled, 0);
+  EXPECT_EQ(book_->sweep_cost(Side::Bid, 100).filled, 15);
+
+  // Exactly the tradeable 5 fills, cancelling order 1 on the way
+  result = book_->submit_limit(
+      self_buy(12, 5, OrderFlags::STP_CANCEL_OLDEST, TimeInForce::FOK));
+  EXPECT_EQ(result.filled, 5);
+  EXPECT_FALSE(book_->cancel(1));
+  EXPECT_EQ(book_->best_ask(), 151);
+}
+
 // =============================================================================
 // Order Node Field Tests
 // =============================================================================
 
-TEST_F(AdvancedOrdersTest, OrderNodeHasIcebergFields) {
+TEST_F(AdvancedOrdersTest, OrderNodeIsCompact) {
+  // The match loop only touches the hot node, one cache line
+  EXPECT_EQ(sizeof(OrderNode), 64u);
+  EXPECT_EQ(offsetof(OrderNode, next), 0u);
+}
+
+TEST_F(AdvancedOrdersTest, OrderExtrasHoldIcebergFields) {
   OrderNode node;
   node.id = 1;
   node.user = 100;
   node.qty = 10;
-  node.display_qty = 5;
-  node.hidden_qty = 50;
   node.flags = OrderFlags::ICEBERG;
 
+  OrderExtras extras;
+  extras.display_qty = 5;
+  extras.hidden_qty = 50;
+
   EXPECT_TRUE(node.is_iceberg());
-  EXPECT_EQ(node.display_qty, 5);
-  EXPECT_EQ(node.hidden_qty, 50);
+  EXPECT_FALSE(node.has_extras());
+  EXPECT_EQ(extras.display_qty, 5);
+  EXPECT_EQ(extras.hidden_qty, 50);
 }
 
-TEST_F(AdvancedOrdersTest, OrderNodeHasExpiryField) {
-  OrderNode node;
-  node.expiry_ts = 1700000000000000000ULL;
-  EXPECT_EQ(node.expiry_ts, 1700000000000000000ULL);
-}
+TEST_F(AdvancedOrdersTest, RestingAdvancedOrdersUseSideTable) {
+  OrderCommand cmd{};
+  cmd.order_id = 1;
+  cmd.user_id = 100;
+  cmd.price_ticks = 150;
+  cmd.qty = 10;
+  cmd.side = Side::Bid;
+  cmd.order_type = OrderType::Limit;
+  cmd.tif = TimeInForce::GTD;
+  cmd.expiry_ts = 1700000000000000000ULL;
+  book_->submit_limit(cmd);
 
-TEST_F(AdvancedOrdersTest, OrderNodeHasStopPrice) {
-  OrderNode node;
-  node.stop_price = 50000;
-  EXPECT_EQ(node.stop_price, 50000);
+  OrderCommand plain = cmd;
+  plain.order_id = 2;
+  plain.tif = TimeInForce::GTC;
+  plain.expiry_ts = 0;
+  book_->submit_limit(plain);
+
+  const OrderExtras *extras = book_->order_extras(1);
+  ASSERT_NE(extras, nullptr);
+  EXPECT_EQ(extras->expiry_ts, 1700000000000000000ULL);
+  EXPECT_EQ(book_->order_extras(2), nullptr);
+
+  // Removing the order drops its side-table entry
+  EXPECT_TRUE(book_->cancel(1));
+  EXPECT_EQ(book_->order_extras(1), nullptr);
 }
 
-TEST_F(AdvancedOrdersTest, OrderNodeReplenishIceberg) {
+TEST_F(AdvancedOrdersTest, OrderExtrasReplenishIceberg) {
   OrderNode node;
   node.flags = OrderFlags::ICEBERG;
-  node.qty = 0;          // Display exhausted
-  node.display_qty = 10; // Original display size
-  node.hidden_qty = 25;  // Hidden remaining
+  node.qty = 0; // Display exhausted
+
+  OrderExtras extras;
+  extras.display_qty = 10; // Original display size
+  extras.hidden_qty = 25;  // Hidden remaining
 
-  Quantity replenished = node.replenish();
+  Quantity replenished = extras.replenish(node);
 
-  EXPECT_EQ(replenished, 10);     // Replenished display_qty amount
-  EXPECT_EQ(node.qty, 10);        // New visible quantity
-  EXPECT_EQ(node.hidden_qty, 15); // Remaining hidden
+  EXPECT_EQ(replenished, 10);       // Replenished display_qty amount
+  EXPECT_EQ(node.qty, 10);          // New visible quantity
+  EXPECT_EQ(extras.hidden_qty, 15); // Remaining hidden
 }
 
 // =============================================================================
@@ -0,0 +1,116 @@
+#include <gtest/gtest.h>
+#include <hyperliquid/broadcast_ring.h>
+#include <memory>
+#include <span>
+#include <thread>
+#include <vector>
+
+using namespace hyperliquid;
+
+TEST(BroadcastRingTest, EveryConsumerReadsEveryEvent) {
+  BroadcastRing<int, 8> ring;
+  auto a = ring.subscribe();
+  auto b = ring.subscribe();
+
+  for (int i = 0; i < 5; ++i)
+    EXPECT_TRUE(ring.push(i));
+
+  std::vector<int> seen_a, seen_b;
+  EXPECT_EQ(a.consume([&](const int &v) { seen_a.push_back(v); }, 16), 5u);
+  EXPECT_EQ(b.consume([&](const int &v) { seen_b.push_back(v); }, 2), 2u);
+  EXPECT_EQ(seen_a, (std::vector<int>{0, 1, 2, 3, 4}));
+  EXPECT_EQ(seen_b, (std::vector<int>{0, 1}));
+  EXPECT_TRUE(a.empty());
+  EXPECT_FALSE(b.empty());
+}
+
+TEST(BroadcastRingTest, SlowestRequiredConsumerGatesProducer) {
+  BroadcastRing<int, 8> ring;
+  auto fast = ring.subscribe();
+  auto slow = ring.subscribe();
+
+  std::vector<int> items{0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+  EXPECT_EQ(ring.push_n(std::span<const int>(items)), 8u);
+  EXPECT_FALSE(ring.push(8));
+
+  // the fast consumer alone frees nothing
+  int v;
+  while (fast.pop(v)) {
+  }
+  EXPECT_FALSE(ring.push(8));
+
+  ASSERT_TRUE(slow.pop(v));
+  EXPECT_EQ(v, 0);
+  EXPECT_TRUE(ring.push(8));
+  EXPECT_FALSE(ring.push(9));
+}
+
+TEST(BroadcastRingTest, LossyConsumerSkipsAhead) {
+  BroadcastRing<int, 8> ring;
+  auto ui = ring.subscribe(true);
+
+  // nothing gates the producer
+  for (int i = 0; i < 20; ++i)
+    ASSERT_TRUE(ring.push(i));
+
+  std::vector<int> seen;
+  int v;
+  while (ui.pop(v))
+    seen.push_back(v);
+  EXPECT_EQ(seen, (std::vector<int>{12, 13, 14, 15, 16, 17, 18, 19}));
+  EXPECT_EQ(ui.skipped(), 12u);
+}
+
+TEST(BroadcastRingTest, ConcurrentRequiredAndLossyConsumers) {
+  constexpr uint64_t NUM_ITEMS = 1'000'000;
+  auto ring = std::make_unique<BroadcastRing<uint64_t, 1024>>();
+  auto r1 = ring->subscribe();
+  auto r2 = ring->subscribe();
+  auto lossy = ring->subscribe(true);
+
+  auto required = [](BroadcastRing<uint64_t, 1024>::Reader &reader,
+                     bool &in_order) {
+    uint64_t expected = 0;
+    while (expected < NUM_ITEMS) {
+      size_t n = reader.consume(
+          [&](const uint64_t &v) { in_order &= (v == expected++); }, 64);
+      if (n == 0)
+        std::this_thread::yield();
+    }
+  };
+  bool ok1 = true, ok2 = true;
+  std::thread c1([&] { required(r1, ok1); });
+  std::thread c2([&] { required(r2, ok2); });
+
+  uint64_t lossy_seen = 0;
+  bool lossy_increasing = true;
+  std::thread c3([&] {
+    uint64_t last = 0, v;
+    bool first = true;
+    while (lossy.position() < NUM_ITEMS) {
+      if (!lossy.pop(v)) {
+        std::this_thread::yield();
+        continue;
+      }
+      lossy_increasing &= first || v > last;
+      first = false;
+      last = v;
+      ++lossy_seen;
+    }
+  });
+
+  for (uint64_t i = 0; i < NUM_ITEMS;) {
+    if (ring->push(i))
+      ++i;
+    else
+      std::this_thread::yield();
+  }
+  c1.join();
+  c2.join();
+  c3.join();
+
+  EXPECT_TRUE(ok1);
+  EXPECT_TRUE(ok2);
+  EXPECT_TRUE(lossy_increasing);
+  EXPECT_EQ(lossy_seen + lossy.skipped(), NUM_ITEMS);
+}
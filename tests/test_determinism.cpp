@@ -78,7 +78,12 @@ protected:
         book.cancel(cmd.order_id);
         break;
       case CommandType::ModifyOrder:
-        book.modify(cmd.order_id, cmd.price_ticks, cmd.qty);
+        book.modify(cmd);
+        break;
+      case CommandType::MassCancel:
+        book.mass_cancel(cmd);
+        break;
+      case CommandType::EndOfStream:
         break;
       }
     }
@@ -3,9 +3,15 @@
 
 #include <gtest/gtest.h>
 #include <hyperliquid/event.h>
+#include <hyperliquid/event_sink.h>
+#include <hyperliquid/feed_handler.h>
+#include <hyperliquid/matching_engine.h>
 #include <hyperliquid/order_book.h>
 #include <hyperliquid/price_levels_array.h>
 #include <hyperliquid/spsc_queue.h>
+#include <hyperliquid/symbol_assignment.h>
+#include <fstream>
+#include <sstream>
 
 using namespace hyperliquid;
 
@@ -258,3 +264,222 @@ TEST(MatchingIntegrationTest, AnyEventTypeHandling) {
   EXPECT_EQ(popped.type, EventType::Trade);
   EXPECT_EQ(popped.trade.price_ticks, 150);
 }
+
+TEST(MatchingIntegrationTest, EndOfStreamClosesEventQueue) {
+  using Queue = SPSCQueue<AnyEvent, 1024>;
+  auto output_queue = std::make_unique<Queue>();
+  PriceBand band(100, 200, 1);
+  OrderBook<PriceLevelsArray, QueueSink<Queue>> book(
+      1, PriceLevelsArray(band), PriceLevelsArray(band),
+      QueueSink<Queue>(output_queue.get()));
+
+  // The marker is for the pipeline; the book leaves it alone
+  OrderCommand end{};
+  end.type = CommandType::EndOfStream;
+  EXPECT_FALSE(book.execute(end).accepted);
+  EXPECT_TRUE(output_queue->empty());
+
+  StreamEnd marker;
+  marker.ts = 7;
+  marker.engine_id = 1;
+  marker.commands = 3;
+  book.sink().on_stream_end(marker);
+
+  AnyEvent evt;
+  ASSERT_TRUE(output_queue->pop(evt));
+  EXPECT_EQ(evt.type, EventType::EndOfStream);
+  EXPECT_EQ(evt.end.engine_id, 1u);
+  EXPECT_EQ(evt.end.commands, 3u);
+  EXPECT_TRUE(output_queue->empty());
+}
+
+TEST(MatchingIntegrationTest, AssignByLoadBalancesEngines) {
+  // One hot symbol gets an engine to itself, the rest share the other
+  std::vector<uint64_t> load = {10, 1000, 20, 30, 0};
+  SymbolAssignment assignment = assign_by_load(load, 2);
+  ASSERT_EQ(assignment.size(), 5u);
+  for (size_t s = 0; s < load.size(); ++s) {
+    if (s != 1) {
+      EXPECT_NE(assignment[s], assignment[1]) << "symbol " << s;
+    }
+  }
+
+  SymbolAssignment rr = assign_round_robin(5, 2);
+  EXPECT_EQ(rr, (SymbolAssignment{0, 1, 0, 1, 0}));
+}
+
+TEST(MatchingIntegrationTest, SymbolMapAssignsStatically) {
+  std::vector<std::string> symbols = {"BTC", "ETH", "SOL", "HYPE"};
+  std::istringstream map("# hot pair apart\n"
+                         "BTC 0\n"
+                         "ETH 1   # trailing comment\n"
+                         "\n"
+                         "SOL 1\n");
+  SymbolAssignment assignment;
+  std::string error;
+  ASSERT_TRUE(parse_symbol_map(map, symbols, 2, assignment, error)) << error;
+  // HYPE is not listed and goes to the engine with fewer symbols
+  EXPECT_EQ(assignment, (SymbolAssignment{0, 1, 1, 0}));
+
+  std::istringstream bad_engine("BTC 2\n");
+  EXPECT_FALSE(parse_symbol_map(bad_engine, symbols, 2, assignment, error));
+  std::istringstream bad_symbol("DOGE 0\n");
+  EXPECT_FALSE(parse_symbol_map(bad_symbol, symbols, 2, assignment, error));
+  EXPECT_NE(error.find("DOGE"), std::string::npos);
+}
+
+static OrderCommand limit(OrderId id, SymbolId symbol, Side side, Tick px,
+                          Quantity qty, Timestamp ts) {
+  OrderCommand cmd{};
+  cmd.type = CommandType::NewOrder;
+  cmd.recv_ts = ts;
+  cmd.order_id = id;
+  cmd.symbol_id = symbol;
+  cmd.user_id = static_cast<UserId>(id);
+  cmd.price_ticks = px;
+  cmd.qty = qty;
+  cmd.side = side;
+  cmd.order_type = OrderType::Limit;
+  cmd.tif = TimeInForce::GTC;
+  return cmd;
+}
+
+TEST(MatchingIntegrationTest, EngineRunsInterleavedSymbolsToEndOfStream) {
+  constexpr Timestamp EXPIRY = Timestamp{1} << 20;
+  std::vector<OrderCommand> cmds;
+  cmds.push_back(limit(1, 0, Side::Ask, 150, 10, 1));
+  cmds.push_back(limit(2, 1, Side::Bid, 150, 5, 2));
+  cmds.push_back(limit(3, 1, Side::Bid, 140, 5, 3));
+  cmds.back().tif = TimeInForce::GTD;
+  cmds.back().expiry_ts = EXPIRY;
+  cmds.push_back(limit(4, 2, Side::Bid, 150, 10, 4)); // not this engine's
+  cmds.push_back(limit(5, 0, Side::Bid, 150, 4, 5));
+  // order 3 expires before this one runs
+  cmds.push_back(limit(6, 1, Side::Ask, 150, 5, EXPIRY << 2));
+  OrderCommand end{};
+  end.type = CommandType::EndOfStream;
+  cmds.push_back(end);
+
+  // every update, conflated by command count and by a 1 ns time slice
+  struct Conflation {
+    uint32_t commands;
+    uint64_t ns;
+  };
+  for (Conflation conflate : {Conflation{0, 0}, Conflation{2, 0},
+                              Conflation{1000, 1}}) {
+    auto input = std::make_unique<SPSCQueue<OrderCommand, 65536>>();
+    auto output = std::make_unique<MatchingEngine::OutputQueue>();
+    auto reader = output->subscribe();
+    ASSERT_EQ(input->push_n(std::span<const OrderCommand>(cmds)),
+              cmds.size());
+
+    MatchingEngine engine(MatchingEngine::Config{
+        .engine_id = 3,
+        .symbols = {0, 1},
+        .price_band = PriceBand(100, 200),
+        .input_queue = input.get(),
+        .output_queue = output.get(),
+        .order_events = true,
+        .conflate_commands = conflate.commands,
+        .conflate_ns = conflate.ns});
+    engine.run(); // returns at the EndOfStream
+
+    std::vector<TradeEvent> trades;
+    std::vector<OrderEvent> deleted;
+    // books start empty, which conflation may never report again
+    BookUpdate last_bbo[2]{};
+    for (BookUpdate &bbo : last_bbo) {
+      bbo.best_bid = Sentinel::EMPTY_BID;
+      bbo.best_ask = Sentinel::EMPTY_ASK;
+    }
+    std::vector<AnyEvent> events;
+    AnyEvent evt;
+    while (reader.pop(evt)) {
+      events.push_back(evt);
+      if (evt.type == EventType::Trade)
+        trades.push_back(evt.trade);
+      if (evt.type == EventType::Order &&
+          evt.order.kind == OrderEventKind::Deleted)
+        deleted.push_back(evt.order);
+      if (evt.type == EventType::BookUpdate) {
+        ASSERT_LT(evt.book_update.symbol_id, 2u);
+        last_bbo[evt.book_update.symbol_id] = evt.book_update;
+      }
+    }
+
+    ASSERT_EQ(trades.size(), 2u) << "conflate " << conflate.commands;
+    EXPECT_EQ(trades[0].symbol_id, 0u);
+    EXPECT_EQ(trades[0].taker_id, 5u);
+    EXPECT_EQ(trades[0].qty, 4);
+    EXPECT_EQ(trades[1].symbol_id, 1u);
+    EXPECT_EQ(trades[1].maker_id, 2u);
+    EXPECT_EQ(trades[1].qty, 5);
+    ASSERT_EQ(deleted.size(), 1u);
+    EXPECT_EQ(deleted[0].order_id, 3u);
+    EXPECT_EQ(deleted[0].ts, EXPIRY);
+
+    // whatever was conflated, the last update shows each final book
+    EXPECT_EQ(last_bbo[0].best_ask, 150);
+    EXPECT_EQ(last_bbo[0].ask_qty, 6);
+    EXPECT_EQ(last_bbo[0].best_bid, Sentinel::EMPTY_BID);
+    EXPECT_EQ(last_bbo[1].best_bid, Sentinel::EMPTY_BID);
+    EXPECT_EQ(last_bbo[1].best_ask, Sentinel::EMPTY_ASK);
+
+    // the dropped command counts nowhere, the StreamEnd closes the output
+    EXPECT_EQ(engine.stats().items, 5u);
+    ASSERT_EQ(events.back().type, EventType::EndOfStream);
+    EXPECT_EQ(events.back().end.engine_id, 3u);
+    EXPECT_EQ(events.back().end.commands, 5u);
+    EXPECT_TRUE(input->empty());
+  }
+}
+
+TEST(MatchingIntegrationTest, EveryEngineQueueGetsEndOfStream) {
+  std::string path = ::testing::TempDir() + "feed_end_of_stream.bin";
+  {
+    std::vector<OrderCommand> cmds = {limit(1, 0, Side::Bid, 150, 1, 1),
+                                      limit(2, 1, Side::Ask, 160, 1, 2)};
+    std::ofstream out(path, std::ios::binary);
+    out.write(reinterpret_cast<const char *>(cmds.data()),
+              static_cast<std::streamsize>(cmds.size() * sizeof(cmds[0])));
+  }
+
+  // both symbols on engine 0, as a symbol map may leave engine 1 empty
+  using InputQueue = SPSCQueue<OrderCommand, 65536>;
+  std::vector<std::unique_ptr<InputQueue>> queues;
+  queues.push_back(std::make_unique<InputQueue>());
+  queues.push_back(std::make_unique<InputQueue>());
+  FeedHandler::Config config;
+  config.input_file = path;
+  config.param_queues = {queues[0].get(), queues[0].get()};
+  config.engine_queues = {queues[0].get(), queues[1].get()};
+  FeedHandler feed(config);
+  feed.run();
+  EXPECT_EQ(feed.stats().items, 2u);
+
+  std::vector<CommandType> seen;
+  OrderCommand cmd;
+  while (queues[0]->pop(cmd))
+    seen.push_back(cmd.type);
+  EXPECT_EQ(seen, (std::vector<CommandType>{CommandType::NewOrder,
+                                            CommandType::NewOrder,
+                                            CommandType::EndOfStream}));
+
+  // the engine without symbols still gets its marker and returns
+  auto output = std::make_unique<MatchingEngine::OutputQueue>();
+  auto reader = output->subscribe();
+  MatchingEngine idle(MatchingEngine::Config{
+      .engine_id = 1,
+      .symbols = {},
+      .price_band = PriceBand(100, 200),
+      .input_queue = queues[1].get(),
+      .output_queue = output.get()});
+  idle.run();
+  EXPECT_EQ(idle.stats().items, 0u);
+  EXPECT_TRUE(queues[1]->empty());
+  AnyEvent evt;
+  ASSERT_TRUE(reader.pop(evt));
+  EXPECT_EQ(evt.type, EventType::EndOfStream);
+  EXPECT_EQ(evt.end.engine_id, 1u);
+  std::remove(path.c_str());
+}
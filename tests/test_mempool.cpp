@@ -1,5 +1,8 @@
 #include <gtest/gtest.h>
+#include <hyperliquid/flat_map.h>
 #include <hyperliquid/mempool.h>
+#include <random>
+#include <unordered_map>
 
 using namespace hyperliquid;
 
@@ -35,3 +38,51 @@ TEST(MempoolTest, MultipleAllocations) {
 
   EXPECT_EQ(pool.in_use(), 0);
 }
+
+TEST(MempoolTest, FreeChainSplicesBack) {
+  struct Linked {
+    Linked *next;
+    int value;
+  };
+  SlabPool<Linked> pool(1);
+  Linked *head = nullptr, *tail = nullptr;
+  for (int i = 0; i < 100; ++i) {
+    Linked *obj = pool.alloc();
+    obj->next = head;
+    obj->value = i;
+    head = obj;
+    if (!tail)
+      tail = obj;
+  }
+  EXPECT_EQ(pool.in_use(), 100u);
+  pool.free_chain(head, tail, 100);
+  EXPECT_EQ(pool.in_use(), 0u);
+  // The spliced objects come back out first
+  EXPECT_EQ(pool.alloc(), head);
+}
+
+TEST(FlatMapTest, EraseKeepsProbeChainsIntact) {
+  // Stay below the resize load of a small table so chains are long and
+  // wrap around its end
+  FlatMap<uint64_t, uint64_t> map(16);
+  std::unordered_map<uint64_t, uint64_t> ref;
+  std::mt19937_64 rng(11);
+  for (int i = 0; i < 5000; ++i) {
+    if (ref.size() >= 10 || rng() % 3 == 0) {
+      if (!ref.empty()) {
+        uint64_t key = ref.begin()->first;
+        map.erase(key);
+        ref.erase(key);
+      }
+    } else {
+      uint64_t key = rng() % 1000 + 1;
+      map.insert(key, key * 7);
+      ref[key] = key * 7;
+    }
+    for (const auto &[key, value] : ref) {
+      uint64_t *v = map.find(key);
+      ASSERT_NE(v, nullptr) << "step " << i << " key " << key;
+      EXPECT_EQ(*v, value);
+    }
+  }
+}
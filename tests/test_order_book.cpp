@@ -1,6 +1,10 @@
 #include <gtest/gtest.h>
 #include <hyperliquid/order_book.h>
 #include <hyperliquid/price_levels_array.h>
+#include <hyperliquid/spsc_queue.h>
+#include <map>
+#include <tuple>
+#include <random>
 
 using namespace hyperliquid;
 
@@ -207,6 +211,228 @@ TEST_F(OrderBookTest, ModifyCancelReplace) {
   EXPECT_EQ(trades[0].maker_id, 2); // Order 2 matches first
 }
 
+TEST_F(OrderBookTest, ModifyRequeuesWithOneUpdate) {
+  OrderCommand cmd{};
+  cmd.order_id = 1;
+  cmd.user_id = 100;
+  cmd.price_ticks = 150;
+  cmd.qty = 10;
+  cmd.side = Side::Bid;
+  cmd.order_type = OrderType::Limit;
+  cmd.tif = TimeInForce::GTC;
+  book_->submit_limit(cmd);
+  cmd.order_id = 2;
+  cmd.price_ticks = 151;
+  book_->submit_limit(cmd);
+
+  std::vector<BookUpdate> updates;
+  std::vector<OrderEvent> events;
+  book_->set_on_book_update(
+      [&](const BookUpdate &u) { updates.push_back(u); });
+  book_->set_on_order([&](const OrderEvent &e) { events.push_back(e); });
+
+  OrderCommand amend{};
+  amend.type = CommandType::ModifyOrder;
+  amend.recv_ts = 42;
+  amend.order_id = 1;
+  amend.price_ticks = 152;
+  amend.qty = 12;
+  auto res = book_->modify(amend);
+  EXPECT_EQ(res.filled, 0);
+  EXPECT_EQ(res.remaining, 12);
+  EXPECT_EQ(book_->best_bid(), 152);
+
+  ASSERT_EQ(updates.size(), 1u);
+  EXPECT_EQ(updates[0].best_bid, 152);
+  EXPECT_EQ(updates[0].bid_qty, 12);
+  ASSERT_EQ(events.size(), 1u);
+  EXPECT_EQ(events[0].kind, OrderEventKind::Replaced);
+  EXPECT_EQ(events[0].ts, 42u);
+  EXPECT_EQ(events[0].price_ticks, 152);
+  EXPECT_EQ(events[0].qty, 12);
+
+  // The moved order still cancels through its index slot
+  EXPECT_TRUE(book_->cancel(1));
+  EXPECT_EQ(book_->best_bid(), 151);
+}
+
+TEST_F(OrderBookTest, CancelEventsCarryCommandTime) {
+  OrderCommand cmd{};
+  cmd.user_id = 7;
+  cmd.qty = 10;
+  cmd.side = Side::Bid;
+  cmd.order_type = OrderType::Limit;
+  cmd.tif = TimeInForce::GTC;
+  for (OrderId id = 1; id <= 3; ++id) {
+    cmd.order_id = id;
+    cmd.price_ticks = static_cast<Tick>(140 + id);
+    book_->submit_limit(cmd);
+  }
+
+  std::vector<OrderEvent> events;
+  book_->set_on_order([&](const OrderEvent &e) { events.push_back(e); });
+
+  OrderCommand cancel{};
+  cancel.type = CommandType::CancelOrder;
+  cancel.order_id = 1;
+  cancel.recv_ts = 50;
+  EXPECT_TRUE(book_->execute(cancel).accepted);
+
+  OrderCommand mass{};
+  mass.type = CommandType::MassCancel;
+  mass.user_id = 7;
+  mass.recv_ts = 60;
+  book_->execute(mass);
+
+  // replaying the same commands gives the same timestamps
+  ASSERT_EQ(events.size(), 3u);
+  EXPECT_EQ(events[0].ts, 50u);
+  EXPECT_EQ(events[1].ts, 60u);
+  EXPECT_EQ(events[2].ts, 60u);
+}
+
+TEST_F(OrderBookTest, ModifyAcrossSpreadTradesFirst) {
+  OrderCommand ask{};
+  ask.order_id = 1;
+  ask.user_id = 100;
+  ask.price_ticks = 150;
+  ask.qty = 4;
+  ask.side = Side::Ask;
+  ask.order_type = OrderType::Limit;
+  ask.tif = TimeInForce::GTC;
+  book_->submit_limit(ask);
+  OrderCommand bid = ask;
+  bid.order_id = 2;
+  bid.user_id = 101;
+  bid.price_ticks = 145;
+  bid.side = Side::Bid;
+  bid.qty = 10;
+  book_->submit_limit(bid);
+
+  OrderCommand amend{};
+  amend.order_id = 2;
+  amend.price_ticks = 150;
+  amend.qty = 10;
+  auto res = book_->modify(amend);
+  EXPECT_EQ(res.filled, 4);
+  EXPECT_EQ(res.remaining, 6);
+  EXPECT_EQ(book_->best_ask(), Sentinel::EMPTY_ASK);
+  EXPECT_EQ(book_->best_bid(), 150);
+}
+
+TEST_F(OrderBookTest, MassCancelWalksOnlyTheUsersOrders) {
+  auto rest = [&](OrderId id, UserId user, Side side, Tick px) {
+    OrderCommand cmd{};
+    cmd.order_id = id;
+    cmd.user_id = user;
+    cmd.price_ticks = px;
+    cmd.qty = 10;
+    cmd.side = side;
+    cmd.order_type = OrderType::Limit;
+    cmd.tif = TimeInForce::GTC;
+    book_->submit_limit(cmd);
+  };
+  OrderId id = 1;
+  for (Tick px = 140; px < 150; ++px) {
+    rest(id++, 7, Side::Bid, px);
+    rest(id++, 8, Side::Bid, px);
+    rest(id++, 7, Side::Ask, px + 15);
+  }
+  // Fill user 7's best ask; filled orders leave the user's list
+  OrderCommand buy{};
+  buy.order_id = 100;
+  buy.user_id = 9;
+  buy.price_ticks = 155;
+  buy.qty = 10;
+  buy.side = Side::Bid;
+  buy.order_type = OrderType::Limit;
+  buy.tif = TimeInForce::IOC;
+  book_->submit_limit(buy);
+
+  size_t updates = 0;
+  book_->set_on_book_update([&](const BookUpdate &) { ++updates; });
+
+  OrderCommand mc{};
+  mc.type = CommandType::MassCancel;
+  mc.user_id = 7;
+  mc.side = Side::Bid;
+  mc.price_ticks = 145;
+  mc.stop_price = 149;
+  mc.flags = MassCancelFlags::BY_SIDE | MassCancelFlags::BY_PRICE;
+  EXPECT_EQ(book_->mass_cancel(mc), 5u);
+  EXPECT_EQ(updates, 1u);
+  EXPECT_EQ(book_->best_bid(), 149); // user 8 still there
+
+  EXPECT_EQ(book_->mass_cancel(7), 14u); // 5 bids + 9 asks
+  EXPECT_EQ(updates, 2u);
+  EXPECT_EQ(book_->best_ask(), Sentinel::EMPTY_ASK);
+  EXPECT_EQ(book_->mass_cancel(7), 0u);
+  EXPECT_EQ(updates, 2u);
+
+  EXPECT_EQ(book_->mass_cancel(8), 10u);
+  EXPECT_EQ(book_->best_bid(), Sentinel::EMPTY_BID);
+}
+
+TEST_F(OrderBookTest, SweepTakesWholeLevels) {
+  auto rest = [&](OrderId id, UserId user, Tick px, Quantity qty) {
+    OrderCommand cmd{};
+    cmd.order_id = id;
+    cmd.user_id = user;
+    cmd.price_ticks = px;
+    cmd.qty = qty;
+    cmd.side = Side::Ask;
+    cmd.order_type = OrderType::Limit;
+    cmd.tif = TimeInForce::GTC;
+    book_->submit_limit(cmd);
+  };
+  rest(1, 7, 150, 3);
+  rest(2, 8, 150, 4);
+  rest(3, 7, 150, 5);
+  rest(4, 7, 151, 6);
+  rest(5, 8, 151, 6);
+
+  std::vector<TradeEvent> trades;
+  book_->set_on_trade([&](const TradeEvent &t) { trades.push_back(t); });
+
+  OrderCommand buy{};
+  buy.order_id = 10;
+  buy.user_id = 9;
+  buy.qty = 15;
+  buy.side = Side::Bid;
+  buy.order_type = OrderType::Market;
+  auto res = book_->submit_market(buy);
+  EXPECT_EQ(res.filled, 15);
+  ASSERT_EQ(trades.size(), 4u);
+  EXPECT_EQ(trades[0].maker_id, 1u);
+  EXPECT_EQ(trades[2].maker_id, 3u);
+  EXPECT_EQ(trades[3].maker_id, 4u);
+  EXPECT_EQ(trades[3].qty, 3);
+
+  // Swept orders are gone from the index and the user lists
+  EXPECT_FALSE(book_->cancel(2));
+  EXPECT_EQ(book_->mass_cancel(7), 1u); // order 4
+  EXPECT_EQ(book_->best_ask(), 151);
+
+  // Aggregated mode reports one trade per level
+  trades.clear();
+  book_->set_aggregate_trades(true);
+  rest(6, 8, 152, 2);
+  buy.qty = 100;
+  res = book_->submit_market(buy);
+  EXPECT_EQ(res.filled, 8);
+  ASSERT_EQ(trades.size(), 2u);
+  EXPECT_EQ(trades[0].maker_id, Sentinel::INVALID_ORDER);
+  EXPECT_EQ(trades[0].price_ticks, 151);
+  EXPECT_EQ(trades[0].qty, 6);
+  EXPECT_EQ(trades[1].price_ticks, 152);
+  EXPECT_EQ(trades[1].qty, 2);
+
+  // Nodes returned as a chain are reused
+  rest(11, 7, 150, 1);
+  rest(12, 7, 150, 1);
+  EXPECT_EQ(book_->mass_cancel(7), 2u);
+}
+
 TEST_F(OrderBookTest, FOK_Fail) {
   // Order book has 10 @ 150
   OrderCommand cmd1{};
@@ -268,3 +494,554 @@ TEST_F(OrderBookTest, FOK_Success) {
   // Remaining 5 in book
   EXPECT_EQ(book_->best_ask(), 150);
 }
+
+TEST_F(OrderBookTest, FOK_DeeperThanOnePlan) {
+  // 70 makers of 1 @ 150..156, more than a fill plan holds
+  for (OrderId id = 1; id <= 70; ++id) {
+    OrderCommand ask{};
+    ask.order_id = id;
+    ask.price_ticks = 150 + static_cast<Tick>(id % 7);
+    ask.qty = 1;
+    ask.side = Side::Ask;
+    ask.order_type = OrderType::Limit;
+    ask.tif = TimeInForce::GTC;
+    book_->submit_limit(ask);
+  }
+
+  OrderCommand fok{};
+  fok.order_id = 100;
+  fok.price_ticks = 156;
+  fok.qty = 71;
+  fok.side = Side::Bid;
+  fok.order_type = OrderType::Limit;
+  fok.tif = TimeInForce::FOK;
+  EXPECT_EQ(book_->submit_limit(fok).filled, 0);
+  EXPECT_EQ(book_->sweep_cost(Side::Bid, 1000).filled, 70);
+
+  fok.qty = 66;
+  auto res = book_->submit_limit(fok);
+  EXPECT_EQ(res.filled, 66);
+  EXPECT_EQ(res.remaining, 0);
+  EXPECT_EQ(book_->sweep_cost(Side::Bid, 1000).filled, 4);
+}
+
+TEST_F(OrderBookTest, PreviewMatchChangesNothing) {
+  // 10 @ 150 from user 1, 10 @ 151 from user 2
+  for (OrderId id = 1; id <= 2; ++id) {
+    OrderCommand ask{};
+    ask.order_id = id;
+    ask.user_id = static_cast<UserId>(id);
+    ask.price_ticks = 149 + static_cast<Tick>(id);
+    ask.qty = 10;
+    ask.side = Side::Ask;
+    ask.order_type = OrderType::Limit;
+    ask.tif = TimeInForce::GTC;
+    book_->submit_limit(ask);
+  }
+
+  OrderCommand bid{};
+  bid.order_id = 3;
+  bid.user_id = 2;
+  bid.price_ticks = 151;
+  bid.qty = 15;
+  bid.side = Side::Bid;
+  bid.order_type = OrderType::Limit;
+  bid.tif = TimeInForce::GTC;
+
+  MatchPreview p = book_->preview_match(bid);
+  EXPECT_EQ(p.filled, 15);
+  EXPECT_EQ(p.notional, 10 * 150 + 5 * 151);
+  EXPECT_EQ(p.last_px, 151);
+  EXPECT_EQ(p.makers, 2u);
+  EXPECT_TRUE(p.exact);
+
+  // With STP the user's own ask at 151 would stop the taker
+  bid.flags = OrderFlags::STP | OrderFlags::STP_CANCEL_NEWEST;
+  p = book_->preview_match(bid);
+  EXPECT_EQ(p.filled, 10);
+  EXPECT_EQ(p.stp_cancelled, 5);
+
+  EXPECT_EQ(book_->sweep_cost(Side::Bid, 100).filled, 20);
+  EXPECT_EQ(book_->best_bid(), Sentinel::EMPTY_BID);
+}
+
+TEST(AuctionTest, PrefixSumMatchesScalar) {
+  std::mt19937_64 rng(7);
+  for (size_t n = 0; n < 40; ++n) {
+    std::vector<Quantity> q(n);
+    for (auto &v : q)
+      v = static_cast<Quantity>(rng() % 1000);
+    std::vector<Quantity> expected(n);
+    Quantity sum = 0;
+    for (size_t i = 0; i < n; ++i)
+      expected[i] = sum += q[i];
+    prefix_sum(q.data(), n);
+    EXPECT_EQ(q, expected) << "n = " << n;
+  }
+}
+
+TEST(AuctionTest, ClearingPriceMaximisesVolume) {
+  // Bids 10@103, 20@101; asks 15@100, 10@102
+  Tick px[] = {100, 101, 102, 103};
+  Quantity bids[] = {0, 20, 0, 10};
+  Quantity asks[] = {15, 0, 10, 0};
+  AuctionResult r = find_clearing_price(px, bids, asks, 4);
+  // 100: 30 vs 15, 101: 30 vs 15, 102: 10 vs 25, 103: 10 vs 25
+  EXPECT_EQ(r.price, 100);
+  EXPECT_EQ(r.volume, 15);
+  EXPECT_EQ(r.imbalance, 15);
+}
+
+TEST_F(OrderBookTest, AuctionUncrossesInOnePass) {
+  std::vector<TradeEvent> trades;
+  book_->set_on_trade([&](const TradeEvent &t) { trades.push_back(t); });
+  book_->begin_auction();
+
+  auto limit = [](OrderId id, Side side, Tick px, Quantity qty) {
+    OrderCommand cmd{};
+    cmd.order_id = id;
+    cmd.price_ticks = px;
+    cmd.qty = qty;
+    cmd.side = side;
+    cmd.order_type = OrderType::Limit;
+    cmd.tif = TimeInForce::GTC;
+    return cmd;
+  };
+  book_->submit_limit(limit(1, Side::Bid, 103, 10));
+  book_->submit_limit(limit(2, Side::Bid, 101, 20));
+  book_->submit_limit(limit(3, Side::Ask, 100, 8));
+  book_->submit_limit(limit(4, Side::Ask, 100, 7));
+  book_->submit_limit(limit(5, Side::Ask, 102, 10));
+  book_->submit_limit(limit(6, Side::Ask, 105, 10));
+
+  // Nothing trades, the book crosses, orders that cannot rest bounce
+  EXPECT_TRUE(trades.empty());
+  EXPECT_EQ(book_->best_bid(), 103);
+  EXPECT_EQ(book_->best_ask(), 100);
+  OrderCommand ioc = limit(7, Side::Bid, 104, 5);
+  ioc.tif = TimeInForce::IOC;
+  EXPECT_FALSE(book_->submit_limit(ioc).accepted);
+  OrderCommand market = limit(8, Side::Ask, 0, 5);
+  market.order_type = OrderType::Market;
+  EXPECT_FALSE(book_->submit_market(market).accepted);
+
+  AuctionResult indicative = book_->indicative_uncross();
+  EXPECT_EQ(indicative.price, 100);
+  EXPECT_EQ(indicative.volume, 15);
+
+  AuctionResult r = book_->uncross(1000);
+  EXPECT_FALSE(book_->in_auction());
+  EXPECT_EQ(r.price, 100);
+  EXPECT_EQ(r.volume, 15);
+  // Best bid first against the asks in time order, all at 100
+  ASSERT_EQ(trades.size(), 3u);
+  EXPECT_EQ(trades[0].taker_id, 1u);
+  EXPECT_EQ(trades[0].maker_id, 3u);
+  EXPECT_EQ(trades[0].qty, 8);
+  EXPECT_EQ(trades[1].taker_id, 1u);
+  EXPECT_EQ(trades[1].maker_id, 4u);
+  EXPECT_EQ(trades[1].qty, 2);
+  EXPECT_EQ(trades[2].taker_id, 2u);
+  EXPECT_EQ(trades[2].maker_id, 4u);
+  EXPECT_EQ(trades[2].qty, 5);
+  for (const auto &t : trades)
+    EXPECT_EQ(t.price_ticks, 100);
+
+  // Uncrossed: 15 left @ 101 against 10 @ 102
+  EXPECT_EQ(book_->best_bid(), 101);
+  EXPECT_EQ(book_->best_ask(), 102);
+  EXPECT_EQ(book_->last_trade_px(), 100);
+
+  // Continuous matching is back
+  auto res = book_->submit_limit(limit(9, Side::Bid, 102, 4));
+  EXPECT_EQ(res.filled, 4);
+}
+
+TEST_F(OrderBookTest, SubmitBatchPublishesOnce) {
+  size_t updates = 0;
+  BookUpdate last{};
+  book_->set_on_book_update([&](const BookUpdate &u) {
+    ++updates;
+    last = u;
+  });
+
+  std::vector<OrderCommand> cmds(5);
+  for (size_t i = 0; i < 4; ++i) {
+    cmds[i].type = CommandType::NewOrder;
+    cmds[i].order_id = i + 1;
+    cmds[i].price_ticks = (i % 2) ? 151 : 149;
+    cmds[i].qty = 10;
+    cmds[i].side = (i % 2) ? Side::Ask : Side::Bid;
+    cmds[i].order_type = OrderType::Limit;
+    cmds[i].tif = TimeInForce::GTC;
+  }
+  cmds[3].price_ticks = 149; // crosses the bid of order 1
+  cmds[4].type = CommandType::CancelOrder;
+  cmds[4].order_id = 42; // unknown
+
+  std::vector<ExecResult> results(cmds.size());
+  EXPECT_EQ(book_->submit_batch(cmds, results), 5u);
+  EXPECT_EQ(updates, 1u);
+  EXPECT_EQ(last.best_bid, 149);
+  EXPECT_EQ(last.bid_qty, 10);
+  EXPECT_EQ(last.best_ask, 151);
+  EXPECT_EQ(results[0].remaining, 10);
+  EXPECT_EQ(results[3].filled, 10);
+  EXPECT_FALSE(results[4].accepted);
+
+  // a short results span only gets the leading results
+  std::vector<OrderCommand> cancels(3);
+  for (size_t i = 0; i < cancels.size(); ++i) {
+    cancels[i].type = CommandType::CancelOrder;
+    cancels[i].order_id = i + 2; // order 2 still rests
+  }
+  std::vector<ExecResult> first(1);
+  EXPECT_EQ(book_->submit_batch(cancels, first), 1u);
+  EXPECT_TRUE(first[0].accepted);
+  EXPECT_EQ(book_->submit_batch(cancels), 0u);
+}
+
+TEST(OrderBookSinkTest, NullSinkStillMatches) {
+  PriceBand band(100, 200, 1);
+  OrderBook<PriceLevelsArray, NullSink> book(1, PriceLevelsArray(band),
+                                             PriceLevelsArray(band));
+
+  OrderCommand sell{};
+  sell.type = CommandType::NewOrder;
+  sell.order_id = 1;
+  sell.user_id = 100;
+  sell.price_ticks = 150;
+  sell.qty = 10;
+  sell.side = Side::Ask;
+  sell.order_type = OrderType::Limit;
+  sell.tif = TimeInForce::GTC;
+  book.submit_limit(sell);
+
+  OrderCommand buy = sell;
+  buy.order_id = 2;
+  buy.user_id = 101;
+  buy.qty = 4;
+  buy.side = Side::Bid;
+  auto result = book.submit_limit(buy);
+
+  EXPECT_EQ(result.filled, 4);
+  EXPECT_EQ(book.best_ask(), 150);
+}
+
+TEST(OrderBookSinkTest, QueueSinkPushesEvents) {
+  using Queue = SPSCQueue<AnyEvent, 64>;
+  Queue queue;
+  PriceBand band(100, 200, 1);
+  OrderBook<PriceLevelsArray, QueueSink<Queue>> book(
+      1, PriceLevelsArray(band), PriceLevelsArray(band),
+      QueueSink<Queue>(&queue));
+
+  OrderCommand sell{};
+  sell.type = CommandType::NewOrder;
+  sell.order_id = 1;
+  sell.user_id = 100;
+  sell.price_ticks = 150;
+  sell.qty = 10;
+  sell.side = Side::Ask;
+  sell.order_type = OrderType::Limit;
+  sell.tif = TimeInForce::GTC;
+  book.submit_limit(sell);
+
+  OrderCommand buy = sell;
+  buy.order_id = 2;
+  buy.user_id = 101;
+  buy.qty = 4;
+  buy.side = Side::Bid;
+  book.submit_limit(buy);
+
+  // rest -> book update, cross -> trade + book update
+  AnyEvent evt;
+  ASSERT_TRUE(queue.pop(evt));
+  EXPECT_EQ(evt.type, EventType::BookUpdate);
+  EXPECT_EQ(evt.book_update.best_ask, 150);
+  ASSERT_TRUE(queue.pop(evt));
+  EXPECT_EQ(evt.type, EventType::Trade);
+  EXPECT_EQ(evt.trade.maker_id, 1u);
+  EXPECT_EQ(evt.trade.qty, 4);
+  ASSERT_TRUE(queue.pop(evt));
+  EXPECT_EQ(evt.type, EventType::BookUpdate);
+  EXPECT_EQ(evt.book_update.ask_qty, 6);
+  EXPECT_FALSE(queue.pop(evt));
+}
+
+TEST_F(OrderBookTest, OrderEventsRebuildBook) {
+  std::vector<OrderEvent> events;
+  book_->set_on_order([&](const OrderEvent &e) { events.push_back(e); });
+
+  std::mt19937_64 rng(5);
+  for (OrderId id = 1; id <= 2000; ++id) {
+    if (rng() % 5 == 0) {
+      book_->cancel(rng() % id + 1);
+      continue;
+    }
+    OrderCommand cmd{};
+    cmd.type = CommandType::NewOrder;
+    cmd.order_id = id;
+    cmd.user_id = static_cast<UserId>(rng() % 10 + 1);
+    cmd.price_ticks = 140 + static_cast<Tick>(rng() % 21);
+    cmd.qty = static_cast<Quantity>(rng() % 20 + 1);
+    cmd.side = (rng() & 1) ? Side::Bid : Side::Ask;
+    cmd.order_type = OrderType::Limit;
+    cmd.tif = TimeInForce::GTC;
+    book_->submit_limit(cmd);
+    if (id % 7 == 0)
+      book_->modify(id, cmd.price_ticks, cmd.qty / 2);
+    if (id % 11 == 0)
+      book_->modify(id, cmd.price_ticks + static_cast<Tick>(rng() % 5) - 2,
+                    cmd.qty + 3);
+  }
+
+  // Replay the L3 stream into a per-order book
+  struct Resting {
+    Side side;
+    Tick px;
+    Quantity qty;
+  };
+  std::map<OrderId, Resting> orders;
+  SeqNo seq = 0;
+  for (const auto &e : events) {
+    ASSERT_EQ(e.seq, ++seq);
+    switch (e.kind) {
+    case OrderEventKind::Added:
+      orders[e.order_id] = {e.side, e.price_ticks, e.qty};
+      break;
+    case OrderEventKind::Replaced:
+      ASSERT_TRUE(orders.count(e.order_id));
+      orders[e.order_id] = {e.side, e.price_ticks, e.qty};
+      break;
+    case OrderEventKind::Reduced:
+    case OrderEventKind::Executed:
+      ASSERT_TRUE(orders.count(e.order_id));
+      if ((orders[e.order_id].qty -= e.qty) == 0)
+        orders.erase(e.order_id);
+      break;
+    case OrderEventKind::Deleted:
+      ASSERT_TRUE(orders.count(e.order_id));
+      EXPECT_EQ(orders[e.order_id].qty, e.qty);
+      orders.erase(e.order_id);
+      break;
+    }
+  }
+
+  // Rebuilt depth matches the book on both sides
+  SweepQuote bids, asks;
+  for (const auto &[id, o] : orders) {
+    SweepQuote &q = (o.side == Side::Bid) ? bids : asks;
+    q.filled += o.qty;
+    q.notional += o.qty * o.px;
+  }
+  SweepQuote book_bids = book_->sweep_cost(Side::Ask, 1'000'000);
+  SweepQuote book_asks = book_->sweep_cost(Side::Bid, 1'000'000);
+  EXPECT_EQ(bids.filled, book_bids.filled);
+  EXPECT_EQ(bids.notional, book_bids.notional);
+  EXPECT_EQ(asks.filled, book_asks.filled);
+  EXPECT_EQ(asks.notional, book_asks.notional);
+}
+
+TEST_F(OrderBookTest, DepthViewTracksTopLevels) {
+  constexpr size_t DEPTH = 5;
+  book_->enable_depth(DEPTH);
+
+  // Ground truth from the L3 stream, depth deltas replayed separately
+  std::map<OrderId, std::tuple<Side, Tick, Quantity>> orders;
+  book_->set_on_order([&](const OrderEvent &e) {
+    if (e.kind == OrderEventKind::Added) {
+      orders[e.order_id] = {e.side, e.price_ticks, e.qty};
+    } else if ((std::get<2>(orders[e.order_id]) -= e.qty) == 0 ||
+               e.kind == OrderEventKind::Deleted) {
+      orders.erase(e.order_id);
+    }
+  });
+  std::map<Tick, DepthLevel> bid_view, ask_view;
+  book_->set_on_depth([&](const DepthUpdate &u) {
+    auto &view = (u.side == Side::Bid) ? bid_view : ask_view;
+    if (u.qty == 0)
+      view.erase(u.price_ticks);
+    else
+      view[u.price_ticks] = DepthLevel{u.price_ticks, u.qty, u.count};
+  });
+
+  std::mt19937_64 rng(17);
+  for (OrderId id = 1; id <= 3000; ++id) {
+    if (rng() % 4 == 0) {
+      book_->cancel(rng() % id + 1);
+    } else {
+      OrderCommand cmd{};
+      cmd.type = CommandType::NewOrder;
+      cmd.order_id = id;
+      cmd.user_id = static_cast<UserId>(rng() % 10 + 1);
+      cmd.price_ticks = 130 + static_cast<Tick>(rng() % 41);
+      cmd.qty = static_cast<Quantity>(rng() % 20 + 1);
+      cmd.side = (rng() & 1) ? Side::Bid : Side::Ask;
+      cmd.order_type = OrderType::Limit;
+      cmd.tif = TimeInForce::GTC;
+      book_->submit_limit(cmd);
+    }
+
+    std::map<Tick, DepthLevel> bid_levels, ask_levels;
+    for (const auto &[oid, o] : orders) {
+      auto &levels = (std::get<0>(o) == Side::Bid) ? bid_levels : ask_levels;
+      DepthLevel &lvl = levels[std::get<1>(o)];
+      lvl.price_ticks = std::get<1>(o);
+      lvl.qty += std::get<2>(o);
+      lvl.count++;
+    }
+
+    DepthLevel snap[DEPTH];
+    size_t n = book_->depth_snapshot(Side::Bid, snap, DEPTH);
+    ASSERT_EQ(n, std::min(DEPTH, bid_levels.size())) << "step " << id;
+    ASSERT_EQ(bid_view.size(), n);
+    auto bit = bid_levels.rbegin();
+    for (size_t i = 0; i < n; ++i, ++bit) {
+      ASSERT_EQ(snap[i].price_ticks, bit->first) << "step " << id;
+      ASSERT_EQ(snap[i].qty, bit->second.qty);
+      ASSERT_EQ(snap[i].count, bit->second.count);
+      ASSERT_EQ(bid_view[snap[i].price_ticks].qty, snap[i].qty);
+    }
+
+    n = book_->depth_snapshot(Side::Ask, snap, DEPTH);
+    ASSERT_EQ(n, std::min(DEPTH, ask_levels.size())) << "step " << id;
+    ASSERT_EQ(ask_view.size(), n);
+    auto ait = ask_levels.begin();
+    for (size_t i = 0; i < n; ++i, ++ait) {
+      ASSERT_EQ(snap[i].price_ticks, ait->first) << "step " << id;
+      ASSERT_EQ(snap[i].qty, ait->second.qty);
+      ASSERT_EQ(snap[i].count, ait->second.count);
+      ASSERT_EQ(ask_view[snap[i].price_ticks].qty, snap[i].qty);
+    }
+  }
+}
+
+TEST_F(OrderBookTest, DepthUnchangedBeyondViewIsSilent) {
+  book_->enable_depth(1);
+  size_t updates = 0;
+  book_->set_on_depth([&](const DepthUpdate &) { ++updates; });
+
+  OrderCommand cmd{};
+  cmd.type = CommandType::NewOrder;
+  cmd.order_id = 1;
+  cmd.user_id = 100;
+  cmd.price_ticks = 150;
+  cmd.qty = 10;
+  cmd.side = Side::Bid;
+  cmd.order_type = OrderType::Limit;
+  cmd.tif = TimeInForce::GTC;
+  book_->submit_limit(cmd);
+  EXPECT_EQ(updates, 1u);
+
+  // A worse bid is outside the top-1 view
+  cmd.order_id = 2;
+  cmd.price_ticks = 140;
+  book_->submit_limit(cmd);
+  book_->cancel(2);
+  EXPECT_EQ(updates, 1u);
+}
+
+TEST_F(OrderBookTest, DepthUpdatesCarryCommandTime) {
+  book_->enable_depth(5);
+  std::vector<DepthUpdate> updates;
+  book_->set_on_depth([&](const DepthUpdate &u) { updates.push_back(u); });
+
+  OrderCommand cmd{};
+  cmd.type = CommandType::NewOrder;
+  cmd.order_id = 1;
+  cmd.user_id = 100;
+  cmd.price_ticks = 150;
+  cmd.qty = 10;
+  cmd.side = Side::Bid;
+  cmd.order_type = OrderType::Limit;
+  cmd.tif = TimeInForce::GTC;
+  cmd.recv_ts = 10;
+  book_->execute(cmd);
+
+  cmd.order_id = 2;
+  cmd.user_id = 200;
+  cmd.qty = 4;
+  cmd.side = Side::Ask;
+  cmd.recv_ts = 20; // fills 4 of order 1
+  book_->execute(cmd);
+
+  OrderCommand cancel{};
+  cancel.type = CommandType::CancelOrder;
+  cancel.order_id = 1;
+  cancel.recv_ts = 30;
+  book_->execute(cancel);
+
+  // replaying the same commands gives the same depth stream
+  ASSERT_EQ(updates.size(), 3u);
+  EXPECT_EQ(updates[0].ts, 10u);
+  EXPECT_EQ(updates[1].ts, 20u);
+  EXPECT_EQ(updates[1].qty, 6);
+  EXPECT_EQ(updates[2].ts, 30u);
+  EXPECT_EQ(updates[2].qty, 0);
+}
+
+TEST_F(OrderBookTest, BookUpdateOnlyOnTopOfBookChange) {
+  std::vector<BookUpdate> updates;
+  book_->set_on_book_update(
+      [&](const BookUpdate &u) { updates.push_back(u); });
+
+  OrderCommand cmd{};
+  cmd.type = CommandType::NewOrder;
+  cmd.order_id = 1;
+  cmd.user_id = 100;
+  cmd.price_ticks = 150;
+  cmd.qty = 10;
+  cmd.side = Side::Bid;
+  cmd.order_type = OrderType::Limit;
+  cmd.tif = TimeInForce::GTC;
+  book_->submit_limit(cmd);
+  ASSERT_EQ(updates.size(), 1u);
+
+  // Deep in the book: top of book unchanged, nothing published
+  cmd.order_id = 2;
+  cmd.price_ticks = 140;
+  book_->submit_limit(cmd);
+  book_->cancel(2);
+  EXPECT_EQ(updates.size(), 1u);
+
+  // Size at the best changes
+  cmd.order_id = 3;
+  cmd.price_ticks = 150;
+  book_->submit_limit(cmd);
+  ASSERT_EQ(updates.size(), 2u);
+  EXPECT_EQ(updates.back().bid_qty, 20);
+
+  const BookUpdateStats &stats = book_->book_update_stats();
+  EXPECT_EQ(stats.requested, 4u);
+  EXPECT_EQ(stats.published, 2u);
+  EXPECT_EQ(stats.suppressed(), 2u);
+}
+
+TEST_F(OrderBookTest, ConflatedBookUpdatesPublishOnFlush) {
+  std::vector<BookUpdate> updates;
+  book_->set_on_book_update(
+      [&](const BookUpdate &u) { updates.push_back(u); });
+  book_->set_book_update_conflation(true);
+
+  OrderCommand cmd{};
+  cmd.type = CommandType::NewOrder;
+  cmd.user_id = 100;
+  cmd.qty = 10;
+  cmd.side = Side::Bid;
+  cmd.order_type = OrderType::Limit;
+  cmd.tif = TimeInForce::GTC;
+  for (OrderId id = 1; id <= 5; ++id) {
+    cmd.order_id = id;
+    cmd.price_ticks = 140 + static_cast<Tick>(id);
+    book_->submit_limit(cmd);
+  }
+  EXPECT_TRUE(updates.empty());
+
+  book_->flush_book_update();
+  ASSERT_EQ(updates.size(), 1u);
+  EXPECT_EQ(updates[0].best_bid, 145);
+  book_->flush_book_update(); // nothing pending
+  EXPECT_EQ(updates.size(), 1u);
+  EXPECT_EQ(book_->book_update_stats().suppressed(), 4u);
+}
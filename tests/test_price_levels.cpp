@@ -2,9 +2,13 @@
 /// Verifies both PriceLevelsArray and PriceLevelsAVL behave correctly
 
 #include <gtest/gtest.h>
+#include <hyperliquid/occupancy_bitmap.h>
 #include <hyperliquid/order_book.h>
 #include <hyperliquid/price_levels_array.h>
 #include <hyperliquid/price_levels_avl.h>
+#include <hyperliquid/price_levels_sorted.h>
+#include <hyperliquid/price_levels_window.h>
+#include <random>
 
 using namespace hyperliquid;
 
@@ -74,6 +78,301 @@ TEST_F(PriceLevelsArrayTest, WorksWithOrderBook) {
   EXPECT_EQ(book.best_bid(), 150);
 }
 
+TEST_F(PriceLevelsArrayTest, FindNextSkipsEmptyLevels) {
+  PriceLevelsArray levels(band_);
+
+  OrderNode node1{1, 1, 10, 0, 0};
+  OrderNode node2{2, 1, 10, 0, 0};
+  levels.enqueue(110, &node1);
+  levels.enqueue(190, &node2);
+
+  EXPECT_EQ(levels.find_next_bid(190), 110);
+  EXPECT_EQ(levels.find_next_bid(110), Sentinel::EMPTY_BID);
+  EXPECT_EQ(levels.find_next_ask(110), 190);
+  EXPECT_EQ(levels.find_next_ask(190), Sentinel::EMPTY_ASK);
+
+  // Sentinels search from the band edges
+  EXPECT_EQ(levels.find_next_bid(Sentinel::EMPTY_ASK), 190);
+  EXPECT_EQ(levels.find_next_ask(Sentinel::EMPTY_BID), 110);
+
+  levels.erase(110, &node1);
+  EXPECT_FALSE(levels.has_level(110));
+  EXPECT_EQ(levels.find_next_ask(100), 190);
+  EXPECT_EQ(levels.find_next_bid(190), Sentinel::EMPTY_BID);
+}
+
+TEST_F(PriceLevelsArrayTest, WideGapBestRefresh) {
+  // Gap far larger than any fixed scan window
+  PriceBand wide(1, 1'000'000, 1);
+  OrderBook<PriceLevelsArray> book(1, PriceLevelsArray(wide),
+                                   PriceLevelsArray(wide));
+
+  OrderCommand bid{};
+  bid.user_id = 100;
+  bid.qty = 10;
+  bid.side = Side::Bid;
+  bid.order_type = OrderType::Limit;
+  bid.tif = TimeInForce::GTC;
+
+  bid.order_id = 1;
+  bid.price_ticks = 10;
+  book.submit_limit(bid);
+  bid.order_id = 2;
+  bid.price_ticks = 900'000;
+  book.submit_limit(bid);
+  EXPECT_EQ(book.best_bid(), 900'000);
+
+  EXPECT_TRUE(book.cancel(2));
+  EXPECT_EQ(book.best_bid(), 10);
+}
+
+TEST_F(PriceLevelsArrayTest, CancelBelowBestKeepsBest) {
+  OrderBook<PriceLevelsArray> book(1, PriceLevelsArray(band_),
+                                   PriceLevelsArray(band_));
+
+  OrderCommand bid{};
+  bid.user_id = 100;
+  bid.qty = 10;
+  bid.side = Side::Bid;
+  bid.order_type = OrderType::Limit;
+  bid.tif = TimeInForce::GTC;
+
+  bid.order_id = 1;
+  bid.price_ticks = 150;
+  book.submit_limit(bid);
+  bid.order_id = 2;
+  bid.price_ticks = 140;
+  book.submit_limit(bid);
+
+  EXPECT_TRUE(book.cancel(2));
+  EXPECT_EQ(book.best_bid(), 150);
+}
+
+TEST_F(PriceLevelsArrayTest, DepthIndexMatchesLevelWalk) {
+  PriceLevelsArray indexed(band_, true);
+  PriceLevelsArray plain(band_);
+  ASSERT_TRUE(indexed.has_depth_index());
+  ASSERT_FALSE(plain.has_depth_index());
+
+  std::vector<OrderNode> a(200), b(200);
+  uint64_t x = 99;
+  for (size_t i = 0; i < a.size(); ++i) {
+    x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+    Tick px = 100 + static_cast<Tick>((x >> 33) % 101);
+    Quantity qty = 1 + static_cast<Quantity>((x >> 17) % 50);
+    a[i] = OrderNode(i + 1, 1, qty, 0, 0);
+    b[i] = OrderNode(i + 1, 1, qty, 0, 0);
+    indexed.enqueue(px, &a[i]);
+    plain.enqueue(px, &b[i]);
+    if (i % 3 == 0) {
+      indexed.reduce_qty(px, &a[i], qty / 2);
+      plain.reduce_qty(px, &b[i], qty / 2);
+    }
+    if (i % 7 == 0) {
+      indexed.erase(px, &a[i]);
+      plain.erase(px, &b[i]);
+    }
+  }
+
+  for (Tick px = 95; px <= 205; ++px) {
+    for (Side s : {Side::Bid, Side::Ask}) {
+      Quantity exact = plain.available_qty(s, px, 1'000'000);
+      EXPECT_EQ(indexed.available_qty(s, px, 1'000'000), exact);
+    }
+  }
+  for (Quantity q : {1, 7, 100, 999, 5'000, 1'000'000}) {
+    for (Side s : {Side::Bid, Side::Ask}) {
+      SweepQuote lhs = indexed.sweep_cost(s, q);
+      SweepQuote rhs = plain.sweep_cost(s, q);
+      EXPECT_EQ(lhs.filled, rhs.filled);
+      EXPECT_EQ(lhs.notional, rhs.notional);
+      EXPECT_EQ(lhs.last_px, rhs.last_px);
+    }
+  }
+}
+
+TEST_F(PriceLevelsArrayTest, SweepCostAcrossLevels) {
+  PriceLevelsArray asks(band_, true);
+  OrderNode n1{1, 1, 10, 0, 0};
+  OrderNode n2{2, 1, 10, 0, 0};
+  asks.enqueue(150, &n1);
+  asks.enqueue(160, &n2);
+
+  SweepQuote q = asks.sweep_cost(Side::Ask, 15);
+  EXPECT_EQ(q.filled, 15);
+  EXPECT_EQ(q.notional, 10 * 150 + 5 * 160);
+  EXPECT_EQ(q.last_px, 160);
+
+  q = asks.sweep_cost(Side::Ask, 50);
+  EXPECT_EQ(q.filled, 20);
+  EXPECT_EQ(q.last_px, 160);
+
+  EXPECT_EQ(asks.available_qty(Side::Ask, 155, 100), 10);
+  EXPECT_EQ(asks.available_qty(Side::Ask, 160, 100), 20);
+}
+
+TEST_F(PriceLevelsArrayTest, FOKSeesLiquidityBeyondScanWindow) {
+  PriceBand wide(1, 1'000'000, 1);
+  OrderBook<PriceLevelsArray> book(1, PriceLevelsArray(wide, true),
+                                   PriceLevelsArray(wide, true));
+
+  OrderCommand ask{};
+  ask.user_id = 100;
+  ask.qty = 10;
+  ask.side = Side::Ask;
+  ask.order_type = OrderType::Limit;
+  ask.tif = TimeInForce::GTC;
+  ask.order_id = 1;
+  ask.price_ticks = 100;
+  book.submit_limit(ask);
+  ask.order_id = 2;
+  ask.price_ticks = 500'000;
+  book.submit_limit(ask);
+
+  OrderCommand fok{};
+  fok.order_id = 3;
+  fok.user_id = 101;
+  fok.qty = 15;
+  fok.side = Side::Bid;
+  fok.price_ticks = 600'000;
+  fok.order_type = OrderType::Limit;
+  fok.tif = TimeInForce::FOK;
+  auto res = book.submit_limit(fok);
+  EXPECT_EQ(res.filled, 15);
+  EXPECT_EQ(book.best_ask(), 500'000);
+
+  SweepQuote q = book.sweep_cost(Side::Bid, 5);
+  EXPECT_EQ(q.filled, 5);
+  EXPECT_EQ(q.last_px, 500'000);
+}
+
+TEST_F(PriceLevelsArrayTest, LazyArrayCommitsOnlyUsedChunks) {
+  // 100M levels: only reserved, never touched up front
+  PriceBand wide(1, 100'000'000, 1);
+  PriceLevelsLazyArray levels(wide);
+  EXPECT_EQ(levels.storage().dirty_chunks(), 0u);
+  EXPECT_FALSE(levels.has_level(50'000'000));
+
+  OrderNode a{1, 1, 10, 0, 0};
+  OrderNode b{2, 1, 10, 0, 0};
+  levels.enqueue(1'000, &a);
+  levels.enqueue(90'000'000, &b);
+  EXPECT_EQ(levels.storage().dirty_chunks(), 2u);
+  EXPECT_EQ(levels.find_next_ask(1'000), 90'000'000);
+
+  // Occupied chunks are never trimmed
+  EXPECT_EQ(levels.trim_idle(0), 0u);
+
+  levels.erase(90'000'000, &b);
+  EXPECT_EQ(levels.trim_idle(2), 0u); // not idle long enough yet
+  EXPECT_EQ(levels.trim_idle(2), 1u);
+  EXPECT_EQ(levels.storage().dirty_chunks(), 1u);
+
+  // Released levels read back empty and can be reused
+  EXPECT_FALSE(levels.has_level(90'000'000));
+  EXPECT_TRUE(levels.get_level(90'000'000).empty());
+  levels.enqueue(90'000'000, &b);
+  EXPECT_EQ(levels.get_level(90'000'000).total_qty, 10);
+  EXPECT_TRUE(levels.has_level(1'000));
+
+  // A chunk refilled before its trim stays, and is trimmed once idle again
+  levels.erase(1'000, &a);
+  levels.enqueue(1'000, &a);
+  EXPECT_EQ(levels.trim_idle(0), 0u);
+  levels.erase(1'000, &a);
+  EXPECT_EQ(levels.trim_idle(1), 1u);
+  EXPECT_EQ(levels.trim_idle(0), 0u);
+  EXPECT_EQ(levels.storage().dirty_chunks(), 1u);
+}
+
+TEST_F(PriceLevelsArrayTest, LazyArrayWorksWithOrderBook) {
+  PriceBand wide(1, 100'000'000, 1);
+  OrderBook<PriceLevelsLazyArray> book(1, PriceLevelsLazyArray(wide),
+                                       PriceLevelsLazyArray(wide));
+
+  OrderCommand ask{};
+  ask.order_id = 1;
+  ask.user_id = 100;
+  ask.price_ticks = 6'000'000;
+  ask.qty = 10;
+  ask.side = Side::Ask;
+  ask.order_type = OrderType::Limit;
+  ask.tif = TimeInForce::GTC;
+  book.submit_limit(ask);
+
+  OrderCommand bid = ask;
+  bid.order_id = 2;
+  bid.user_id = 101;
+  bid.side = Side::Bid;
+  bid.qty = 10;
+  auto res = book.submit_limit(bid);
+  EXPECT_EQ(res.filled, 10);
+  EXPECT_TRUE(book.empty(Side::Ask));
+
+  EXPECT_EQ(book.trim_idle_levels(1), 1u);
+}
+
+// =============================================================================
+// OccupancyBitmap Tests
+// =============================================================================
+
+TEST(OccupancyBitmapTest, FindAcrossSummaryLevels) {
+  OccupancyBitmap bits(1'000'000);
+
+  EXPECT_FALSE(bits.any());
+  EXPECT_EQ(bits.find_next(0), OccupancyBitmap::npos);
+  EXPECT_EQ(bits.find_prev(999'999), OccupancyBitmap::npos);
+
+  bits.set(3);
+  bits.set(70'000);
+  bits.set(999'999);
+
+  EXPECT_TRUE(bits.any());
+  EXPECT_EQ(bits.find_next(0), 3u);
+  EXPECT_EQ(bits.find_next(4), 70'000u);
+  EXPECT_EQ(bits.find_next(70'001), 999'999u);
+  EXPECT_EQ(bits.find_prev(999'998), 70'000u);
+  EXPECT_EQ(bits.find_prev(69'999), 3u);
+  EXPECT_EQ(bits.find_prev(2), OccupancyBitmap::npos);
+
+  bits.clear(70'000);
+  EXPECT_FALSE(bits.test(70'000));
+  EXPECT_EQ(bits.find_next(4), 999'999u);
+  EXPECT_EQ(bits.find_prev(999'998), 3u);
+}
+
+TEST(OccupancyBitmapTest, MatchesLinearScan) {
+  constexpr size_t N = 5000;
+  OccupancyBitmap bits(N);
+  std::vector<bool> ref(N, false);
+
+  uint64_t x = 12345;
+  for (int step = 0; step < 20000; ++step) {
+    x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+    size_t i = (x >> 33) % N;
+    if (ref[i])
+      bits.clear(i);
+    else
+      bits.set(i);
+    ref[i] = !ref[i];
+
+    size_t probe = (x >> 13) % N;
+    size_t next = OccupancyBitmap::npos, prev = OccupancyBitmap::npos;
+    for (size_t j = probe; j < N; ++j)
+      if (ref[j]) {
+        next = j;
+        break;
+      }
+    for (size_t j = probe + 1; j-- > 0;)
+      if (ref[j]) {
+        prev = j;
+        break;
+      }
+    ASSERT_EQ(bits.find_next(probe), next);
+    ASSERT_EQ(bits.find_prev(probe), prev);
+  }
+}
+
 // =============================================================================
 // PriceLevelsAVL Tests
 // =============================================================================
@@ -272,3 +571,196 @@ TEST_F(PriceLevelsAVLTest, SparsePriceRange) {
 
   EXPECT_EQ(book.best_bid(), 1000000); // Higher price is best bid
 }
+
+// =============================================================================
+// PriceLevelsWindow Tests
+// =============================================================================
+
+class PriceLevelsWindowTest : public ::testing::Test {
+protected:
+  PriceBand band_{1, 100'000'000, 1};
+};
+
+TEST_F(PriceLevelsWindowTest, FarOrdersGoToOverflow) {
+  PriceLevelsWindow levels(band_, 64);
+
+  OrderNode near{1, 1, 10, 0, 0};
+  OrderNode far{2, 1, 20, 0, 0};
+  levels.enqueue(50'000, &near); // empty side: window moves here
+  levels.enqueue(90'000'000, &far);
+
+  EXPECT_EQ(levels.window_size(), 64u);
+  EXPECT_EQ(levels.num_overflow_levels(), 1u);
+  EXPECT_TRUE(levels.has_level(50'000));
+  EXPECT_TRUE(levels.has_level(90'000'000));
+  EXPECT_EQ(levels.find_next_ask(50'000), 90'000'000);
+  EXPECT_EQ(levels.find_next_bid(90'000'000), 50'000);
+
+  levels.erase(90'000'000, &far);
+  EXPECT_EQ(levels.num_overflow_levels(), 0u);
+  EXPECT_EQ(levels.find_next_ask(50'000), Sentinel::EMPTY_ASK);
+}
+
+TEST_F(PriceLevelsWindowTest, RecentersWhenBestMoves) {
+  PriceLevelsWindow levels(band_, 64);
+
+  OrderNode a{1, 1, 10, 0, 0};
+  OrderNode b{2, 1, 10, 0, 0};
+  levels.enqueue(1'000, &a);
+  levels.set_best_ask(1'000);
+  levels.enqueue(5'000, &b);
+  EXPECT_EQ(levels.num_overflow_levels(), 1u);
+
+  // Best moves far away: window follows it and swaps the levels
+  levels.erase(1'000, &a);
+  levels.set_best_ask(levels.find_next_ask(1'000));
+  EXPECT_EQ(levels.best_ask(), 5'000);
+  EXPECT_EQ(levels.num_overflow_levels(), 0u);
+  ASSERT_NE(levels.best_level_ptr(Side::Ask), nullptr);
+  EXPECT_EQ(levels.best_level_ptr(Side::Ask)->head, &b);
+  EXPECT_LE(levels.window_lo(), 5'000);
+}
+
+TEST_F(PriceLevelsWindowTest, MatchesArrayImplementation) {
+  // Small window forces frequent recentres and overflow traffic
+  PriceBand band(1, 200'000, 1);
+  OrderBook<PriceLevelsArray> ref(1, PriceLevelsArray(band),
+                                  PriceLevelsArray(band));
+  OrderBook<PriceLevelsWindow> win(1, PriceLevelsWindow(band, 64),
+                                   PriceLevelsWindow(band, 64));
+
+  std::vector<TradeEvent> ref_trades, win_trades;
+  ref.set_on_trade([&](const TradeEvent &t) { ref_trades.push_back(t); });
+  win.set_on_trade([&](const TradeEvent &t) { win_trades.push_back(t); });
+
+  std::mt19937_64 rng(7);
+  Tick mid = 100'000;
+  for (uint64_t i = 1; i <= 20'000; ++i) {
+    mid += static_cast<Tick>(rng() % 41) - 20; // random walk
+    int action = static_cast<int>(rng() % 10);
+    if (action < 8) {
+      OrderCommand cmd{};
+      cmd.order_id = i;
+      cmd.user_id = static_cast<UserId>(rng() % 50 + 1);
+      cmd.side = (rng() & 1) ? Side::Bid : Side::Ask;
+      // mostly near the mid, occasionally far away
+      Tick spread = (rng() % 20 == 0) ? 5'000 : 60;
+      cmd.price_ticks = mid + static_cast<Tick>(rng() % (2 * spread)) - spread;
+      cmd.qty = static_cast<Quantity>(rng() % 20 + 1);
+      cmd.order_type = OrderType::Limit;
+      cmd.tif = TimeInForce::GTC;
+      ref.submit_limit(cmd);
+      win.submit_limit(cmd);
+    } else {
+      OrderId victim = rng() % i + 1;
+      ASSERT_EQ(ref.cancel(victim), win.cancel(victim));
+    }
+    ASSERT_EQ(ref.best_bid(), win.best_bid()) << "step " << i;
+    ASSERT_EQ(ref.best_ask(), win.best_ask()) << "step " << i;
+  }
+
+  ASSERT_EQ(ref_trades.size(), win_trades.size());
+  for (size_t i = 0; i < ref_trades.size(); ++i) {
+    EXPECT_EQ(ref_trades[i].maker_id, win_trades[i].maker_id);
+    EXPECT_EQ(ref_trades[i].price_ticks, win_trades[i].price_ticks);
+    EXPECT_EQ(ref_trades[i].qty, win_trades[i].qty);
+  }
+}
+
+// =============================================================================
+// PriceLevelsSorted Tests
+// =============================================================================
+
+TEST(PriceLevelsSortedTest, DepletedLevelsAreRemoved) {
+  PriceLevelsSorted levels(8);
+
+  OrderNode a{1, 1, 10, 0, 0};
+  OrderNode b{2, 1, 10, 0, 0};
+  OrderNode c{3, 1, 10, 0, 0};
+  levels.enqueue(300, &a);
+  levels.enqueue(100, &b);
+  levels.enqueue(200, &c);
+  EXPECT_EQ(levels.num_levels(), 3u);
+  EXPECT_EQ(levels.find_next_ask(100), 200);
+  EXPECT_EQ(levels.find_next_bid(300), 200);
+
+  levels.erase(200, &c);
+  EXPECT_EQ(levels.num_levels(), 2u);
+  EXPECT_FALSE(levels.has_level(200));
+  EXPECT_EQ(levels.find_next_ask(100), 300);
+  EXPECT_EQ(levels.find_next_bid(300), 100);
+}
+
+TEST(PriceLevelsSortedTest, LookupOfMissingPriceAddsNoLevel) {
+  PriceLevelsSorted levels(8);
+
+  OrderNode a{1, 1, 10, 0, 0};
+  levels.enqueue(100, &a);
+  EXPECT_TRUE(levels.get_level(150).empty());
+  EXPECT_EQ(levels.get_level(150).total_qty, 0);
+  EXPECT_EQ(levels.num_levels(), 1u);
+  EXPECT_EQ(levels.find_next_ask(100), Sentinel::EMPTY_ASK);
+  EXPECT_EQ(levels.get_level(100).head, &a);
+}
+
+TEST(PriceLevelsSortedTest, BestPointerSurvivesShifts) {
+  PriceLevelsSorted levels(8);
+
+  std::vector<OrderNode> nodes(200);
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    nodes[i] = OrderNode{i + 1, 1, 1, 0, 0};
+    Tick px = 1'000 + static_cast<Tick>(i % 2 ? i : -static_cast<Tick>(i));
+    levels.enqueue(px, &nodes[i]);
+    if (i == 0) {
+      levels.set_best_bid(px);
+      levels.set_best_ask(px);
+    }
+    // inserts on both sides and regrowth move levels around in memory
+    ASSERT_NE(levels.best_level_ptr(Side::Bid), nullptr);
+    EXPECT_EQ(levels.best_level_ptr(Side::Bid)->head, &nodes[0]);
+  }
+  EXPECT_EQ(levels.num_levels(), nodes.size());
+}
+
+TEST(PriceLevelsSortedTest, MatchesArrayImplementation) {
+  PriceBand band(1, 200'000, 1);
+  OrderBook<PriceLevelsArray> ref(1, PriceLevelsArray(band),
+                                  PriceLevelsArray(band));
+  OrderBook<PriceLevelsSorted> srt(1, PriceLevelsSorted(), PriceLevelsSorted());
+
+  std::vector<TradeEvent> ref_trades, srt_trades;
+  ref.set_on_trade([&](const TradeEvent &t) { ref_trades.push_back(t); });
+  srt.set_on_trade([&](const TradeEvent &t) { srt_trades.push_back(t); });
+
+  std::mt19937_64 rng(11);
+  Tick mid = 100'000;
+  for (uint64_t i = 1; i <= 20'000; ++i) {
+    mid += static_cast<Tick>(rng() % 41) - 20;
+    int action = static_cast<int>(rng() % 10);
+    if (action < 8) {
+      OrderCommand cmd{};
+      cmd.order_id = i;
+      cmd.user_id = static_cast<UserId>(rng() % 50 + 1);
+      cmd.side = (rng() & 1) ? Side::Bid : Side::Ask;
+      Tick spread = (rng() % 20 == 0) ? 5'000 : 60;
+      cmd.price_ticks = mid + static_cast<Tick>(rng() % (2 * spread)) - spread;
+      cmd.qty = static_cast<Quantity>(rng() % 20 + 1);
+      cmd.order_type = OrderType::Limit;
+      cmd.tif = TimeInForce::GTC;
+      ref.submit_limit(cmd);
+      srt.submit_limit(cmd);
+    } else {
+      OrderId victim = rng() % i + 1;
+      ASSERT_EQ(ref.cancel(victim), srt.cancel(victim));
+    }
+    ASSERT_EQ(ref.best_bid(), srt.best_bid()) << "step " << i;
+    ASSERT_EQ(ref.best_ask(), srt.best_ask()) << "step " << i;
+  }
+
+  ASSERT_EQ(ref_trades.size(), srt_trades.size());
+  for (size_t i = 0; i < ref_trades.size(); ++i) {
+    EXPECT_EQ(ref_trades[i].maker_id, srt_trades[i].maker_id);
+    EXPECT_EQ(ref_trades[i].price_ticks, srt_trades[i].price_ticks);
+    EXPECT_EQ(ref_trades[i].qty, srt_trades[i].qty);
+  }
+}
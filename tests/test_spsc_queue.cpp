@@ -1,6 +1,12 @@
+#include <chrono>
 #include <gtest/gtest.h>
 #include <hyperliquid/spsc_queue.h>
+#include <hyperliquid/wait_strategy.h>
+#include <memory>
+#include <numeric>
+#include <span>
 #include <thread>
+#include <vector>
 
 using namespace hyperliquid;
 
@@ -63,3 +69,124 @@ TEST(SPSCQueueTest, ConcurrentProducerConsumer) {
 
   EXPECT_TRUE(queue.empty());
 }
+
+TEST(SPSCQueueTest, BulkPushPopWrapsAround) {
+  SPSCQueue<int, 16> queue;
+  std::vector<int> in(20);
+  std::iota(in.begin(), in.end(), 0);
+
+  // Only capacity fits
+  EXPECT_EQ(queue.push_n(in), 15u);
+  EXPECT_EQ(queue.push_n(std::span<const int>(in).subspan(15)), 0u);
+
+  int out[10];
+  EXPECT_EQ(queue.pop_n(out), 10u);
+  for (int i = 0; i < 10; ++i)
+    EXPECT_EQ(out[i], i);
+
+  // The next run wraps past the end of the buffer
+  EXPECT_EQ(queue.push_n(std::span<const int>(in).subspan(15)), 5u);
+  std::vector<int> seen;
+  EXPECT_EQ(queue.consume([&](int v) { seen.push_back(v); }, 100), 10u);
+  std::vector<int> expected(10);
+  std::iota(expected.begin(), expected.end(), 10);
+  EXPECT_EQ(seen, expected);
+  EXPECT_TRUE(queue.empty());
+  EXPECT_EQ(queue.pop_n(out), 0u);
+}
+
+// Moves NUM_ITEMS across two threads, one element or one batch per queue
+// call, and checks they arrive complete and in order. The rate is measured
+// in benchmarks/bench_engine.cpp.
+static void cross_thread_transfer(size_t batch) {
+  constexpr uint64_t NUM_ITEMS = 500'000;
+  auto queue = std::make_unique<SPSCQueue<uint64_t, 4096>>();
+  uint64_t sum = 0;
+  bool in_order = true;
+
+  std::thread producer([&] {
+    std::vector<uint64_t> buf(batch);
+    for (uint64_t i = 0; i < NUM_ITEMS;) {
+      if (batch == 1) {
+        while (!queue->push(i))
+          std::this_thread::yield();
+        ++i;
+        continue;
+      }
+      size_t n = std::min<uint64_t>(batch, NUM_ITEMS - i);
+      for (size_t k = 0; k < n; ++k)
+        buf[k] = i + k;
+      std::span<const uint64_t> pending(buf.data(), n);
+      while (!pending.empty()) {
+        size_t pushed = queue->push_n(pending);
+        pending = pending.subspan(pushed);
+        if (pushed == 0)
+          std::this_thread::yield();
+      }
+      i += n;
+    }
+  });
+  std::thread consumer([&] {
+    uint64_t expected = 0;
+    auto check = [&](uint64_t v) {
+      in_order &= v == expected++;
+      sum += v;
+    };
+    while (expected < NUM_ITEMS) {
+      size_t n;
+      if (batch == 1) {
+        uint64_t v;
+        n = queue->pop(v) ? 1 : 0;
+        if (n)
+          check(v);
+      } else {
+        n = queue->consume(check, batch);
+      }
+      if (n == 0)
+        std::this_thread::yield();
+    }
+  });
+  producer.join();
+  consumer.join();
+  EXPECT_TRUE(in_order) << "batch " << batch;
+  EXPECT_EQ(sum, NUM_ITEMS * (NUM_ITEMS - 1) / 2);
+  EXPECT_TRUE(queue->empty());
+}
+
+TEST(SPSCQueueTest, CrossThreadTransferInOrder) {
+  for (size_t batch : {size_t{1}, size_t{64}}) {
+    cross_thread_transfer(batch);
+  }
+}
+
+TEST(SPSCQueueTest, ParkedConsumerWakesOnRing) {
+  SPSCQueue<int, 16> queue;
+  Doorbell bell;
+  uint64_t parks = 0;
+  int got = 0;
+  // a long park timeout, so only the ring can wake the consumer in time
+  std::thread consumer([&] {
+    WaitStrategy wait(WaitMode::Park, &bell, std::chrono::seconds(10));
+    while (!queue.pop(got))
+      wait.idle([&] { return !queue.empty(); });
+    parks = wait.parks();
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  auto start = std::chrono::steady_clock::now();
+  ASSERT_TRUE(queue.push(7));
+  bell.ring();
+  consumer.join();
+  EXPECT_EQ(got, 7);
+  EXPECT_GE(parks, 1u);
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(5));
+}
+
+TEST(SPSCQueueTest, ParseWaitMode) {
+  WaitMode mode = WaitMode::Yield;
+  EXPECT_TRUE(parse_wait_mode("park", mode));
+  EXPECT_EQ(mode, WaitMode::Park);
+  EXPECT_TRUE(parse_wait_mode("backoff", mode));
+  EXPECT_EQ(mode, WaitMode::Backoff);
+  EXPECT_FALSE(parse_wait_mode("sleep", mode));
+  EXPECT_EQ(mode, WaitMode::Backoff);
+}
@@ -293,61 +293,60 @@ void render_stats(int row, const Stats &stats) {
             << pad_left("executed", box_width - 4) << ansi::RST;
 }
 
-void render_order_book(int row, int col, int width, int height, Tick best_bid,
-                       Tick best_ask, Quantity bid_qty, Quantity ask_qty) {
+void render_order_book(int row, int col, int width, int height,
+                       const DepthLevel *bids, size_t num_bids,
+                       const DepthLevel *asks, size_t num_asks) {
   draw_box(row, col, width, height, "ORDER BOOK");
 
-  Quantity max_qty = std::max(bid_qty, ask_qty);
-  if (max_qty == 0)
-    max_qty = 1;
+  // levels per side that fit around the spread line
+  constexpr size_t ROWS = 4;
+
+  Quantity max_qty = 1;
+  for (size_t i = 0; i < num_bids; ++i)
+    max_qty = std::max(max_qty, bids[i].qty);
+  for (size_t i = 0; i < num_asks; ++i)
+    max_qty = std::max(max_qty, asks[i].qty);
 
   int content_width = width - 4;
   int bar_width = 12;
 
-  // asks (top)
-  std::cout << ansi::move_to(row + 2, col + 2) << ansi::DIM << "ASK"
-            << ansi::RST;
-
-  if (best_ask != Sentinel::EMPTY_ASK && best_ask < 2000000000) {
-    std::cout << ansi::move_to(row + 3, col + 2) << ansi::BRIGHT_RED
-              << pad_left(format_price(best_ask), 10) << ansi::RST;
-    std::cout << ansi::move_to(row + 3, col + 14) << ansi::DIM
-              << pad_left(format_number(ask_qty), 8) << ansi::RST;
-    draw_bar(row + 3, col + 24, bar_width,
-             static_cast<double>(ask_qty) / max_qty, ansi::RED, true);
-  } else {
-    std::cout << ansi::move_to(row + 3, col + 2) << ansi::DIM << "    ---"
-              << ansi::RST;
-  }
+  auto draw_level = [&](int r, const DepthLevel &lvl, const char *px_color,
+                        const char *bar_color, bool right) {
+    std::cout << ansi::move_to(r, col + 2) << px_color
+              << pad_left(format_price(lvl.price_ticks), 10) << ansi::RST;
+    std::cout << ansi::move_to(r, col + 14) << ansi::DIM
+              << pad_left(format_number(lvl.qty), 8) << ansi::RST;
+    draw_bar(r, col + 24, bar_width, static_cast<double>(lvl.qty) / max_qty,
+             bar_color, right);
+  };
+
+  // asks (top), best ask nearest the spread line
+  for (size_t i = 0; i < std::min(num_asks, ROWS); ++i)
+    draw_level(row + static_cast<int>(ROWS - i), asks[i], ansi::BRIGHT_RED,
+               ansi::RED, true);
+  if (num_asks == 0)
+    std::cout << ansi::move_to(row + static_cast<int>(ROWS), col + 2)
+              << ansi::DIM << "    ---" << ansi::RST;
 
   // spread line
   Tick spread = 0;
-  if (best_ask != Sentinel::EMPTY_ASK && best_bid != Sentinel::EMPTY_BID &&
-      best_ask < 2000000000) {
-    spread = best_ask - best_bid;
-  }
-  std::cout << ansi::move_to(row + 5, col + 2) << ansi::GRAY;
+  if (num_asks > 0 && num_bids > 0)
+    spread = asks[0].price_ticks - bids[0].price_ticks;
+  int spread_row = row + static_cast<int>(ROWS) + 1;
+  std::cout << ansi::move_to(spread_row, col + 2) << ansi::GRAY;
   for (int i = 0; i < content_width; ++i)
     std::cout << "·";
   std::cout << ansi::RST;
-  std::cout << ansi::move_to(row + 5, col + content_width / 2 - 4) << ansi::DIM
-            << " spread:" << spread << " " << ansi::RST;
-
-  // bids (bottom)
-  std::cout << ansi::move_to(row + 7, col + 2) << ansi::DIM << "BID"
-            << ansi::RST;
-
-  if (best_bid != Sentinel::EMPTY_BID) {
-    std::cout << ansi::move_to(row + 8, col + 2) << ansi::BRIGHT_GREEN
-              << pad_left(format_price(best_bid), 10) << ansi::RST;
-    std::cout << ansi::move_to(row + 8, col + 14) << ansi::DIM
-              << pad_left(format_number(bid_qty), 8) << ansi::RST;
-    draw_bar(row + 8, col + 24, bar_width,
-             static_cast<double>(bid_qty) / max_qty, ansi::GREEN, false);
-  } else {
-    std::cout << ansi::move_to(row + 8, col + 2) << ansi::DIM << "    ---"
-              << ansi::RST;
-  }
+  std::cout << ansi::move_to(spread_row, col + content_width / 2 - 4)
+            << ansi::DIM << " spread:" << spread << " " << ansi::RST;
+
+  // bids (bottom), best bid nearest the spread line
+  for (size_t i = 0; i < std::min(num_bids, ROWS); ++i)
+    draw_level(spread_row + 1 + static_cast<int>(i), bids[i],
+               ansi::BRIGHT_GREEN, ansi::GREEN, false);
+  if (num_bids == 0)
+    std::cout << ansi::move_to(spread_row + 1, col + 2) << ansi::DIM
+              << "    ---" << ansi::RST;
 }
 
 void render_trades(int row, int col, int width, int height,
@@ -465,6 +464,8 @@ int main(int argc, char *argv[]) {
   PriceBand band(50000, 60000, 1);
   OrderBook<PriceLevelsArray> book(1, PriceLevelsArray(band),
                                    PriceLevelsArray(band));
+  book.enable_depth(4);
+  DepthLevel bids[4], asks[4];
 
   Stats stats;
   stats.avg_latency_ns = 207;
@@ -518,10 +519,9 @@ int main(int argc, char *argv[]) {
 
       render_header(WIDTH);
       render_stats(5, stats);
-      render_order_book(
-          11, 2, 40, 11, book.best_bid(), book.best_ask(),
-          book.best_bid() != Sentinel::EMPTY_BID ? 100 : 0, // simplified qty
-          book.best_ask() != Sentinel::EMPTY_ASK ? 100 : 0);
+      size_t num_bids = book.depth_snapshot(Side::Bid, bids, 4);
+      size_t num_asks = book.depth_snapshot(Side::Ask, asks, 4);
+      render_order_book(11, 2, 40, 11, bids, num_bids, asks, num_asks);
       render_trades(11, 44, 45, 11, stats.recent_trades);
       render_price_chart(22, 2, 87, 7, stats.price_history);
       render_progress(30, WIDTH, i + 1, NUM_ORDERS);
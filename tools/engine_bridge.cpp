@@ -14,7 +14,7 @@
 #include <hyperliquid/binary_protocol.h>
 #include <hyperliquid/cpu_affinity.h>
 #include <hyperliquid/order_book.h>
-#include <hyperliquid/price_levels_array.h>
+#include <hyperliquid/price_levels_window.h>
 #include <hyperliquid/timestamp.h>
 
 using namespace hyperliquid;
@@ -168,9 +168,10 @@ int main(int argc, char *argv[]) {
 
   // create order book with wide price band
   // prices will be scaled: actual_price * 100 to handle decimals as ticks
+  // a sliding window keeps memory proportional to the active range
   PriceBand band(1, 100000000, 1); // 0.01 to 1,000,000.00 scaled
-  OrderBook<PriceLevelsArray> book(1, PriceLevelsArray(band),
-                                   PriceLevelsArray(band));
+  OrderBook<PriceLevelsWindow> book(1, PriceLevelsWindow(band),
+                                    PriceLevelsWindow(band));
 
   EngineStats stats;
   uint64_t order_id = 1;